@@ -0,0 +1,163 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "host_mmu.h"
+#include "libk_host.h"
+#include "mmu.h"
+#include "paging.h"
+#include <kernel/frame.h>
+
+/*
+ * Native-speed benchmarks of the kernel's allocator, paging and libk code.
+ *
+ * Usage: host_bench [filter] [iterations]
+ *
+ * Only benchmarks whose name contains filter are run, which keeps perf
+ * profiles focused, e.g. perf record -g ./host_bench frame_alloc
+ */
+
+#define BUFFER_SIZE 4096
+#define SMALL_SIZE  64
+#define MAP_ADDRESS ((void *)0x40000000)
+
+struct host_benchmark {
+    const char *name;
+    void (*setup)(void);
+    void (*fn)(void);
+};
+
+static unsigned char src[BUFFER_SIZE] __attribute__((aligned(64)));
+static unsigned char dst[BUFFER_SIZE + SMALL_SIZE] __attribute__((aligned(64)));
+static char text[128];
+static uint32_t map_frame;
+
+/* Keep the compiler from dropping work on memory nobody reads */
+static inline void use(const void *p) {
+    __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+static void allocator_setup(void) {
+    frame_init();
+    frame_reserve_range(0, 0x100000);
+}
+
+/* Allocator with nine in ten frames taken at random, so scans run long */
+static void fragmented_setup(void) {
+    allocator_setup();
+    srand(1);
+    for (uint32_t frame = 0x100000 / FRAME_SIZE; frame < FRAME_COUNT; frame++) {
+        if (rand() % 10) {
+            frame_reserve_range(frame * FRAME_SIZE, (frame + 1) * FRAME_SIZE);
+        }
+    }
+}
+
+static void paging_setup(void) {
+    allocator_setup();
+    host_mmu_reset(frame_alloc());
+    paging_init_directory();
+    map_frame = frame_alloc();
+}
+
+static void bench_frame_alloc_free(void) {
+    frame_free(frame_alloc());
+}
+
+static void bench_kmalloc_physical_page(void) {
+    kfree_physical_page(kmalloc_physical_page());
+}
+
+static void bench_map_unmap(void) {
+    map_page_to_frame(MAP_ADDRESS, (void *)(uintptr_t)map_frame, PAGE_WRITE, PAGE_CACHE_WB);
+    unmap_page(MAP_ADDRESS);
+}
+
+static void bench_libk_memcpy_4k(void) { libk_memcpy(dst, src, BUFFER_SIZE); use(dst); }
+static void bench_libc_memcpy_4k(void) { memcpy(dst, src, BUFFER_SIZE); use(dst); }
+static void bench_libk_memcpy_64(void) { libk_memcpy(dst, src, SMALL_SIZE); use(dst); }
+static void bench_libc_memcpy_64(void) { memcpy(dst, src, SMALL_SIZE); use(dst); }
+static void bench_libk_memset_4k(void) { libk_memset(dst, 0x5A, BUFFER_SIZE); use(dst); }
+static void bench_libc_memset_4k(void) { memset(dst, 0x5A, BUFFER_SIZE); use(dst); }
+static void bench_libk_memmove_4k(void) { libk_memmove(dst + SMALL_SIZE, dst, BUFFER_SIZE); use(dst); }
+static void bench_libc_memmove_4k(void) { memmove(dst + SMALL_SIZE, dst, BUFFER_SIZE); use(dst); }
+
+static void memcmp_setup(void) {
+    memcpy(dst, src, BUFFER_SIZE);
+}
+
+static void bench_libk_memcmp_4k(void) {
+    volatile int r = libk_memcmp(dst, src, BUFFER_SIZE);
+    (void)r;
+}
+
+static void bench_libc_memcmp_4k(void) {
+    use(dst);
+    volatile int r = memcmp(dst, src, BUFFER_SIZE);
+    (void)r;
+}
+
+#define FORMAT_ARGS "%d %u %s 0x%08x %-8s|%5d", -12345, 4000000000u, "frame", 0xC0100000u, "pad", 42
+
+static void bench_libk_snprintf(void) { libk_snprintf(text, sizeof(text), FORMAT_ARGS); use(text); }
+static void bench_libc_snprintf(void) { snprintf(text, sizeof(text), FORMAT_ARGS); use(text); }
+
+static const struct host_benchmark benchmarks[] = {
+    { "frame_alloc_free",            allocator_setup,  bench_frame_alloc_free },
+    { "frame_alloc_free_fragmented", fragmented_setup, bench_frame_alloc_free },
+    { "kmalloc_physical_page",       paging_setup,     bench_kmalloc_physical_page },
+    { "map_unmap",                   paging_setup,     bench_map_unmap },
+    { "libk_memcpy_4k",              NULL,             bench_libk_memcpy_4k },
+    { "libc_memcpy_4k",              NULL,             bench_libc_memcpy_4k },
+    { "libk_memcpy_64",              NULL,             bench_libk_memcpy_64 },
+    { "libc_memcpy_64",              NULL,             bench_libc_memcpy_64 },
+    { "libk_memset_4k",              NULL,             bench_libk_memset_4k },
+    { "libc_memset_4k",              NULL,             bench_libc_memset_4k },
+    { "libk_memmove_4k_overlap",     NULL,             bench_libk_memmove_4k },
+    { "libc_memmove_4k_overlap",     NULL,             bench_libc_memmove_4k },
+    { "libk_memcmp_4k",              memcmp_setup,     bench_libk_memcmp_4k },
+    { "libc_memcmp_4k",              memcmp_setup,     bench_libc_memcmp_4k },
+    { "libk_snprintf",               NULL,             bench_libk_snprintf },
+    { "libc_snprintf",               NULL,             bench_libc_snprintf },
+};
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec * 1e9 + (double)ts.tv_nsec;
+}
+
+int main(int argc, char **argv) {
+    const char *filter = argc > 1 ? argv[1] : "";
+    unsigned long iterations = argc > 2 ? strtoul(argv[2], NULL, 0) : 1000000;
+
+    for (size_t i = 0; i < sizeof(src); i++) {
+        src[i] = (unsigned char)(i * 31 + 7);
+    }
+
+    printf("%-30s %12s %10s\n", "benchmark", "iterations", "ns/op");
+    for (size_t b = 0; b < sizeof(benchmarks) / sizeof(benchmarks[0]); b++) {
+        const struct host_benchmark *bench = &benchmarks[b];
+        if (!strstr(bench->name, filter)) {
+            continue;
+        }
+        if (bench->setup) {
+            bench->setup();
+        }
+
+        // Warm up caches and branch predictors first
+        for (unsigned long i = 0; i < iterations / 10; i++) {
+            bench->fn();
+        }
+
+        double start = now_ns();
+        for (unsigned long i = 0; i < iterations; i++) {
+            bench->fn();
+        }
+        double elapsed = now_ns() - start;
+
+        printf("%-30s %12lu %10.1f\n", bench->name, iterations, elapsed / (double)iterations);
+    }
+    return 0;
+}
@@ -0,0 +1,23 @@
+#ifndef HOST_MMU_H
+#define HOST_MMU_H
+
+#include <stdint.h>
+
+/*
+ * Simulated machine behind the mmu_* shim: physical memory is one buffer
+ * covering every frame the allocator manages, and the privileged
+ * operations are counted instead of executed.
+ */
+
+/* Clear physical memory and point CR3 at the given page directory frame */
+void host_mmu_reset(uint32_t page_directory);
+
+/* TLB invalidations and CR3 loads since the last reset */
+uint64_t host_mmu_invlpg_count(void);
+uint64_t host_mmu_cr3_writes(void);
+
+/* debug_error() calls since the last reset of the counter */
+uint32_t host_debug_errors(void);
+void host_debug_reset_errors(void);
+
+#endif /* HOST_MMU_H */
@@ -0,0 +1,59 @@
+#ifndef HOST_TEST_H
+#define HOST_TEST_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/*
+ * Minimal support for the host stress tests: a seeded PRNG, so a failing
+ * run can be repeated with the same seed, and a CHECK that stops the test
+ * at the first violated invariant.
+ *
+ * Usage: test_name [operations] [seed]
+ */
+
+static uint64_t test_rng_state = 0x9E3779B97F4A7C15ULL;
+
+static inline uint64_t test_random(void) {
+    // xorshift64*
+    test_rng_state ^= test_rng_state >> 12;
+    test_rng_state ^= test_rng_state << 25;
+    test_rng_state ^= test_rng_state >> 27;
+    return test_rng_state * 0x2545F4914F6CDD1DULL;
+}
+
+/* Uniform enough value in [0, limit) for limit > 0 */
+static inline uint32_t test_random_below(uint32_t limit) {
+    return (uint32_t)((test_random() >> 32) % limit);
+}
+
+#define CHECK(cond, ...)                                                    \
+    do {                                                                    \
+        if (!(cond)) {                                                      \
+            fprintf(stderr, "%s:%d: check failed: %s: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__);                                   \
+            fprintf(stderr, " (seed %llu)\n", (unsigned long long)test_seed); \
+            exit(1);                                                        \
+        }                                                                   \
+    } while (0)
+
+static uint64_t test_seed = 1;
+
+/* Read the operation count and seed from the command line */
+static inline uint64_t test_parse_args(int argc, char** argv, uint64_t default_operations) {
+    uint64_t operations = argc > 1 ? strtoull(argv[1], NULL, 0) : default_operations;
+    test_seed = argc > 2 ? strtoull(argv[2], NULL, 0) : 1;
+    test_rng_state ^= test_seed * 0xD1B54A32D192ED03ULL;
+    if (!test_rng_state) {
+        test_rng_state = 1;
+    }
+    return operations;
+}
+
+static inline int test_finish(void) {
+    printf("ok (seed %llu)\n", (unsigned long long)test_seed);
+    return 0;
+}
+
+#endif /* HOST_TEST_H */
@@ -0,0 +1,38 @@
+#ifndef LIBK_HOST_H
+#define LIBK_HOST_H
+
+/*
+ * libk built for the host under its own names, so it can be measured
+ * against the host C library in the same process. The libk_host sources
+ * are compiled with LIBK_HOST_BUILD and this header forced in, which
+ * renames their definitions; host programs include it for the prototypes.
+ */
+#ifdef LIBK_HOST_BUILD
+
+#define memcmp    libk_memcmp
+#define memcpy    libk_memcpy
+#define memmove   libk_memmove
+#define memset    libk_memset
+#define strcmp    libk_strcmp
+#define strlen    libk_strlen
+#define snprintf  libk_snprintf
+#define vsnprintf libk_vsnprintf
+#define vformat   libk_vformat
+
+#else
+
+#include <stdarg.h>
+#include <stddef.h>
+
+int libk_memcmp(const void* a, const void* b, size_t size);
+void* libk_memcpy(void* restrict dst, const void* restrict src, size_t size);
+void* libk_memmove(void* dst, const void* src, size_t size);
+void* libk_memset(void* dst, int value, size_t size);
+int libk_strcmp(const char* a, const char* b);
+size_t libk_strlen(const char* str);
+int libk_snprintf(char* str, size_t size, const char* format, ...);
+int libk_vsnprintf(char* str, size_t size, const char* format, va_list args);
+
+#endif /* LIBK_HOST_BUILD */
+
+#endif /* LIBK_HOST_H */
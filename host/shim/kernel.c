@@ -0,0 +1,94 @@
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "paging.h"
+#include "host_mmu.h"
+#include <kernel/debug.h>
+#include <kernel/frame.h>
+
+/*
+ * Host versions of the kernel services the allocator and paging code
+ * call. Logging goes to stderr; set REDOS_HOST_DEBUG to a DEBUG_LEVEL_*
+ * number to see more than errors and warnings.
+ */
+
+static int debug_level = -1;
+static uint32_t debug_errors;
+
+static void host_log(int level, const char *prefix, const char *format, va_list args) {
+    if (debug_level < 0) {
+        const char *env = getenv("REDOS_HOST_DEBUG");
+        debug_level = env ? atoi(env) : DEBUG_LEVEL_WARNING;
+    }
+    if (level > debug_level) {
+        return;
+    }
+    fputs(prefix, stderr);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+}
+
+#define HOST_LOG_FUNCTION(name, level, prefix)          \
+    void name(const char *format, ...) {                \
+        va_list args;                                   \
+        va_start(args, format);                         \
+        host_log(level, prefix, format, args);          \
+        va_end(args);                                   \
+    }
+
+HOST_LOG_FUNCTION(debug_warning, DEBUG_LEVEL_WARNING, "[WARN] ")
+HOST_LOG_FUNCTION(debug_info, DEBUG_LEVEL_INFO, "[INFO] ")
+HOST_LOG_FUNCTION(debug_debug, DEBUG_LEVEL_DEBUG, "[DEBUG] ")
+HOST_LOG_FUNCTION(debug_trace, DEBUG_LEVEL_TRACE, "[TRACE] ")
+
+void debug_error(const char *format, ...) {
+    va_list args;
+    debug_errors++;
+    va_start(args, format);
+    host_log(DEBUG_LEVEL_ERROR, "[ERROR] ", format, args);
+    va_end(args);
+}
+
+void debug_set_level(int level) {
+    debug_level = level;
+}
+
+int debug_get_level(void) {
+    return debug_level;
+}
+
+uint32_t host_debug_errors(void) {
+    return debug_errors;
+}
+
+void host_debug_reset_errors(void) {
+    debug_errors = 0;
+}
+
+/* One simulated CPU and no per-CPU data: the caches go straight through */
+uint32_t frame_cache_alloc(void) {
+    return frame_alloc();
+}
+
+void frame_cache_free(uint32_t frame_addr) {
+    frame_free(frame_addr);
+}
+
+/* The simulated CPU always has a PAT programmed like init_pat() does */
+void init_pat(void) {
+}
+
+uint32_t page_cache_flags(enum page_cache_type cache) {
+    switch (cache) {
+        case PAGE_CACHE_WC:
+            return PAGE_PWT;
+        case PAGE_CACHE_UC_MINUS:
+            return PAGE_PCD;
+        case PAGE_CACHE_UC:
+            return PAGE_PCD | PAGE_PWT;
+        case PAGE_CACHE_WB:
+        default:
+            return 0;
+    }
+}
@@ -0,0 +1,86 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "mmu.h"
+#include "host_mmu.h"
+#include <kernel/frame.h>
+
+#define HOST_PHYS_SIZE ((size_t)FRAME_COUNT * FRAME_SIZE)
+
+/* Linker symbols of the kernel image; the host has no image to reserve */
+uint32_t kernel_physical_start;
+uint32_t kernel_physical_end;
+uint32_t kernel_virtual_start;
+uint32_t kernel_virtual_end;
+
+static uint8_t *phys_memory;
+static uint32_t cr0 = CR0_PG;
+static uint32_t cr3;
+static uint64_t invlpg_count;
+static uint64_t cr3_writes;
+
+void host_mmu_reset(uint32_t page_directory) {
+    if (!phys_memory) {
+        phys_memory = aligned_alloc(FRAME_SIZE, HOST_PHYS_SIZE);
+        if (!phys_memory) {
+            perror("host_mmu_reset");
+            abort();
+        }
+    }
+    memset(phys_memory, 0, HOST_PHYS_SIZE);
+    cr0 = CR0_PG;
+    cr3 = page_directory;
+    invlpg_count = 0;
+    cr3_writes = 0;
+}
+
+uint64_t host_mmu_invlpg_count(void) {
+    return invlpg_count;
+}
+
+uint64_t host_mmu_cr3_writes(void) {
+    return cr3_writes;
+}
+
+uint32_t mmu_read_cr0(void) {
+    return cr0;
+}
+
+void mmu_write_cr0(uint32_t value) {
+    cr0 = value;
+}
+
+uint32_t mmu_read_cr3(void) {
+    return cr3;
+}
+
+void mmu_write_cr3(uint32_t value) {
+    cr3 = value;
+    cr3_writes++;
+}
+
+void mmu_invlpg(uint32_t addr) {
+    (void)addr;
+    invlpg_count++;
+}
+
+void mmu_wbinvd(void) {
+}
+
+void *mmu_phys_to_virt(uint32_t phys) {
+    if (!phys_memory || phys >= HOST_PHYS_SIZE) {
+        fprintf(stderr, "mmu_phys_to_virt: 0x%x is outside simulated memory\n", phys);
+        abort();
+    }
+    return phys_memory + phys;
+}
+
+uint32_t mmu_virt_to_phys(const void *virt) {
+    const uint8_t *ptr = virt;
+    if (!phys_memory || ptr < phys_memory || ptr >= phys_memory + HOST_PHYS_SIZE) {
+        fprintf(stderr, "mmu_virt_to_phys: %p is not simulated memory\n", virt);
+        abort();
+    }
+    return (uint32_t)(ptr - phys_memory);
+}
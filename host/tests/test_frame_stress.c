@@ -0,0 +1,158 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "host_mmu.h"
+#include "host_test.h"
+#include <kernel/frame.h>
+
+/* Frames below 1MB are reserved the way init_paging() reserves them */
+#define RESERVED_END 0x100000
+#define RESERVED_FRAMES (RESERVED_END / FRAME_SIZE)
+
+static bool shadow[FRAME_COUNT];
+static uint32_t allocated[FRAME_COUNT];
+static uint32_t allocated_count;
+
+static void reset(void) {
+    frame_init();
+    frame_reserve_range(0, RESERVED_END);
+    for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+        shadow[i] = i < RESERVED_FRAMES;
+    }
+    allocated_count = 0;
+    host_debug_reset_errors();
+}
+
+static void check_alloc(void) {
+    uint32_t frame = frame_alloc();
+    CHECK(frame != 0, "allocation failed with %u frames in use", frame_used_count());
+    CHECK((frame & (FRAME_SIZE - 1)) == 0, "frame 0x%x is not aligned", frame);
+    CHECK(frame / FRAME_SIZE < FRAME_COUNT, "frame 0x%x is out of range", frame);
+    CHECK(!shadow[frame / FRAME_SIZE], "frame 0x%x handed out twice", frame);
+    CHECK(frame_is_used(frame), "frame 0x%x not marked used", frame);
+
+    shadow[frame / FRAME_SIZE] = true;
+    allocated[allocated_count++] = frame;
+}
+
+static void check_free(uint32_t index) {
+    uint32_t frame = allocated[index];
+    allocated[index] = allocated[--allocated_count];
+
+    frame_free(frame);
+    shadow[frame / FRAME_SIZE] = false;
+    CHECK(!frame_is_used(frame), "frame 0x%x still used after free", frame);
+}
+
+static void check_bitmap(void) {
+    CHECK(frame_used_count() == RESERVED_FRAMES + allocated_count,
+          "%u frames used, expected %u", frame_used_count(), RESERVED_FRAMES + allocated_count);
+    for (uint32_t i = 0; i < FRAME_COUNT; i++) {
+        CHECK(frame_is_used(i * FRAME_SIZE) == shadow[i], "frame %u disagrees with the shadow", i);
+    }
+}
+
+/* Random mix of allocations and frees, biased to hover around a target fill */
+static void test_random_churn(uint64_t operations) {
+    reset();
+    uint32_t target = (FRAME_COUNT - RESERVED_FRAMES) / 2;
+
+    for (uint64_t op = 0; op < operations; op++) {
+        bool alloc = allocated_count == 0 ||
+                     (allocated_count < FRAME_COUNT - RESERVED_FRAMES &&
+                      test_random_below(2 * target) >= allocated_count);
+        if (alloc) {
+            check_alloc();
+        } else {
+            check_free(test_random_below(allocated_count));
+        }
+        if ((op & 0xFFFFF) == 0) {
+            check_bitmap();
+        }
+    }
+    check_bitmap();
+    CHECK(host_debug_errors() == 0, "%u allocator errors", host_debug_errors());
+    printf("random churn: %llu operations, %u frames held at the end\n",
+           (unsigned long long)operations, allocated_count);
+}
+
+/* Take every frame, check the allocator says so, then give them all back */
+static void test_exhaustion(void) {
+    reset();
+    while (allocated_count < FRAME_COUNT - RESERVED_FRAMES) {
+        check_alloc();
+    }
+    CHECK(frame_alloc() == 0, "allocation succeeded with memory exhausted");
+    CHECK(host_debug_errors() == 1, "expected one out-of-memory error, got %u", host_debug_errors());
+    check_bitmap();
+
+    while (allocated_count) {
+        check_free(test_random_below(allocated_count));
+    }
+    check_bitmap();
+    printf("exhaustion: %u frames allocated and freed\n", FRAME_COUNT - RESERVED_FRAMES);
+}
+
+/* Freed frames are reused lowest first */
+static void test_lowest_first(void) {
+    reset();
+    for (int i = 0; i < 64; i++) {
+        check_alloc();
+    }
+    uint32_t lowest = allocated[0];
+    frame_free(allocated[10]);
+    frame_free(lowest);
+    CHECK(frame_alloc() == lowest, "freed lowest frame 0x%x was not reused first", lowest);
+}
+
+/* Batches hand out distinct free frames, and a short batch means memory ran out */
+static void test_batches(uint64_t operations) {
+    uint32_t batch[64];
+
+    reset();
+    for (uint64_t op = 0; op < operations; op++) {
+        uint32_t count = 1 + test_random_below(64);
+        if (allocated_count + count <= FRAME_COUNT - RESERVED_FRAMES && test_random_below(2)) {
+            uint32_t got = frame_alloc_batch(batch, count);
+            CHECK(got == count, "batch of %u gave %u with %u frames free", count, got,
+                  FRAME_COUNT - RESERVED_FRAMES - allocated_count);
+            for (uint32_t i = 0; i < got; i++) {
+                uint32_t frame = batch[i];
+                CHECK(frame / FRAME_SIZE < FRAME_COUNT && !shadow[frame / FRAME_SIZE],
+                      "batch frame 0x%x out of range or handed out twice", frame);
+                shadow[frame / FRAME_SIZE] = true;
+                allocated[allocated_count++] = frame;
+            }
+        } else {
+            count = count < allocated_count ? count : allocated_count;
+            for (uint32_t i = 0; i < count; i++) {
+                uint32_t index = test_random_below(allocated_count);
+                batch[i] = allocated[index];
+                allocated[index] = allocated[--allocated_count];
+                shadow[batch[i] / FRAME_SIZE] = false;
+            }
+            frame_free_batch(batch, count);
+        }
+    }
+    check_bitmap();
+
+    // Run out partway through a batch
+    while (allocated_count < FRAME_COUNT - RESERVED_FRAMES - 10) {
+        check_alloc();
+    }
+    host_debug_reset_errors();
+    CHECK(frame_alloc_batch(batch, 64) == 10, "short batch did not return the last 10 frames");
+    CHECK(frame_alloc_batch(batch, 1) == 0, "batch allocation succeeded with memory exhausted");
+    printf("batches: %llu batch operations\n", (unsigned long long)operations);
+}
+
+int main(int argc, char **argv) {
+    uint64_t operations = test_parse_args(argc, argv, 5000000);
+
+    test_lowest_first();
+    test_exhaustion();
+    test_random_churn(operations);
+    test_batches(operations / 64);
+    return test_finish();
+}
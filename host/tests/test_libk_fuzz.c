@@ -0,0 +1,170 @@
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "host_test.h"
+#include "libk_host.h"
+
+/* Compare libk's string and formatting routines with the host C library */
+
+#define BUFFER_SIZE 512
+
+static unsigned char src[BUFFER_SIZE];
+static unsigned char expected[BUFFER_SIZE * 2];
+static unsigned char actual[BUFFER_SIZE * 2];
+
+static void fill_random(unsigned char *buffer, size_t size) {
+    for (size_t i = 0; i < size; i++) {
+        buffer[i] = (unsigned char)test_random();
+    }
+}
+
+static int sign(int value) {
+    return (value > 0) - (value < 0);
+}
+
+static void fuzz_memory(uint64_t round) {
+    size_t size = test_random_below(BUFFER_SIZE);
+    size_t dst_off = test_random_below(BUFFER_SIZE);
+    size_t src_off = test_random_below(BUFFER_SIZE - size + 1);
+
+    fill_random(src, sizeof(src));
+    fill_random(expected, sizeof(expected));
+    memcpy(actual, expected, sizeof(actual));
+
+    switch (round % 4) {
+        case 0:
+            memcpy(expected + dst_off, src + src_off, size);
+            CHECK(libk_memcpy(actual + dst_off, src + src_off, size) == actual + dst_off,
+                  "memcpy returned the wrong pointer");
+            break;
+        case 1: {
+            int value = (int)test_random_below(256);
+            memset(expected + dst_off, value, size);
+            CHECK(libk_memset(actual + dst_off, value, size) == actual + dst_off,
+                  "memset returned the wrong pointer");
+            break;
+        }
+        case 2: {
+            // Overlapping moves in both directions within one buffer
+            size_t from = test_random_below(BUFFER_SIZE);
+            memmove(expected + dst_off, expected + from, size);
+            CHECK(libk_memmove(actual + dst_off, actual + from, size) == actual + dst_off,
+                  "memmove returned the wrong pointer");
+            break;
+        }
+        case 3: {
+            memcpy(actual, src, size);
+            memcpy(expected, src, size);
+            if (size && test_random_below(2)) {
+                actual[test_random_below(size)] ^= (unsigned char)(1 + test_random_below(255));
+            }
+            CHECK(sign(libk_memcmp(actual, expected, size)) == sign(memcmp(actual, expected, size)),
+                  "memcmp disagrees on %zu bytes", size);
+            return;
+        }
+    }
+    CHECK(memcmp(expected, actual, sizeof(actual)) == 0,
+          "operation %llu differs (size %zu, dst %zu, src %zu)",
+          (unsigned long long)(round % 4), size, dst_off, src_off);
+}
+
+static void fuzz_strings(void) {
+    char a[64], b[64];
+    size_t len = test_random_below(sizeof(a) - 1);
+
+    for (size_t i = 0; i < len; i++) {
+        a[i] = b[i] = (char)(1 + test_random_below(255));
+    }
+    a[len] = b[len] = '\0';
+    if (len && test_random_below(2)) {
+        b[test_random_below(len)] = (char)(1 + test_random_below(255));
+    }
+
+    CHECK(libk_strlen(a) == strlen(a), "strlen disagrees");
+    CHECK(sign(libk_strcmp(a, b)) == sign(strcmp(a, b)), "strcmp disagrees on \"%s\" \"%s\"", a, b);
+}
+
+static int check_format(size_t size, const char *format, ...) {
+    char want[BUFFER_SIZE], got[BUFFER_SIZE];
+    va_list args, copy;
+
+    memset(want, 0x7F, sizeof(want));
+    memset(got, 0x7F, sizeof(got));
+    va_start(args, format);
+    va_copy(copy, args);
+    int want_len = vsnprintf(want, size, format, args);
+    int got_len = libk_vsnprintf(got, size, format, copy);
+    va_end(copy);
+    va_end(args);
+
+    CHECK(want_len == got_len, "\"%s\" returned %d, expected %d", format, got_len, want_len);
+    CHECK(memcmp(want, got, sizeof(want)) == 0, "\"%s\" produced \"%s\", expected \"%s\"",
+          format, got, want);
+    return got_len;
+}
+
+/* Build a random conversion with only the flag combinations C defines */
+static void fuzz_format(void) {
+    static const char conversions[] = "diuoxXcs%";
+    static const char *const lengths[] = { "", "hh", "h", "l", "ll", "z", "j" };
+    static const char *const strings[] = { "", "a", "frame", "a longer string argument" };
+    char format[64];
+    char conversion = conversions[test_random_below(sizeof(conversions) - 1)];
+    bool integer = strchr("diuoxX", conversion) != NULL;
+    size_t pos = 0;
+
+    format[pos++] = '[';
+    format[pos++] = '%';
+    if (conversion != '%') {
+        if (test_random_below(2)) format[pos++] = '-';
+        if (integer && test_random_below(3) == 0) format[pos++] = '0';
+        if (strchr("di", conversion) && test_random_below(3) == 0) {
+            format[pos++] = test_random_below(2) ? '+' : ' ';
+        }
+        if (strchr("oxX", conversion) && test_random_below(3) == 0) format[pos++] = '#';
+        if (test_random_below(2)) {
+            pos += (size_t)sprintf(format + pos, "%u", test_random_below(24));
+        }
+        if (conversion != 'c' && test_random_below(2)) {
+            pos += (size_t)sprintf(format + pos, ".%u", test_random_below(12));
+        }
+    }
+    const char *length = integer ? lengths[test_random_below(7)] : "";
+    pos += (size_t)sprintf(format + pos, "%s%c]", length, conversion);
+    format[pos] = '\0';
+
+    size_t size = test_random_below(4) == 0 ? test_random_below(16) : BUFFER_SIZE;
+    uint64_t value = test_random() >> test_random_below(64);
+
+    if (conversion == 'c') {
+        check_format(size, format, (int)(32 + test_random_below(95)));
+    } else if (conversion == 's') {
+        check_format(size, format, strings[test_random_below(4)]);
+    } else if (conversion == '%') {
+        check_format(size, format);
+    } else if (!strcmp(length, "ll")) {
+        check_format(size, format, (long long)value);
+    } else if (!strcmp(length, "l")) {
+        check_format(size, format, (long)value);
+    } else if (!strcmp(length, "z")) {
+        check_format(size, format, (size_t)value);
+    } else if (!strcmp(length, "j")) {
+        check_format(size, format, (intmax_t)value);
+    } else {
+        check_format(size, format, (int)value);
+    }
+}
+
+int main(int argc, char **argv) {
+    uint64_t rounds = test_parse_args(argc, argv, 1000000);
+
+    for (uint64_t round = 0; round < rounds; round++) {
+        fuzz_memory(round);
+        fuzz_strings();
+        fuzz_format();
+    }
+    printf("libk fuzz: %llu rounds\n", (unsigned long long)rounds);
+    return test_finish();
+}
@@ -0,0 +1,156 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "host_mmu.h"
+#include "host_test.h"
+#include "mmu.h"
+#include "paging.h"
+#include <kernel/frame.h>
+
+/* Virtual window the test maps into: 16 page tables worth of pages */
+#define WINDOW_BASE  0x40000000u
+#define WINDOW_PAGES (16 * 1024)
+
+/* Frames the test maps pages to */
+#define POOL_FRAMES 1024
+
+static uint32_t shadow[WINDOW_PAGES];   /* Physical frame, 0 if unmapped */
+static uint32_t pool[POOL_FRAMES];
+static uint32_t frames_before_tables;
+
+static void *page_address(uint32_t page) {
+    return (void *)(uintptr_t)(WINDOW_BASE + page * PAGE_SIZE);
+}
+
+static uint32_t *page_table_entry(uint32_t virt) {
+    uint32_t *directory = mmu_phys_to_virt(mmu_read_cr3());
+    uint32_t pde = directory[virt >> 22];
+    if (!(pde & PAGE_PRESENT)) {
+        return NULL;
+    }
+    uint32_t *table = mmu_phys_to_virt(pde & PAGE_FRAME);
+    return &table[(virt >> 12) & 0x3FF];
+}
+
+static void setup(void) {
+    frame_init();
+    frame_reserve_range(0, 0x100000);
+
+    uint32_t directory = frame_alloc();
+    host_mmu_reset(directory);
+    paging_init_directory();
+
+    for (uint32_t i = 0; i < POOL_FRAMES; i++) {
+        pool[i] = frame_alloc();
+        CHECK(pool[i] != 0, "cannot allocate pool frame %u", i);
+    }
+    memset(shadow, 0, sizeof(shadow));
+    frames_before_tables = frame_used_count();
+    host_debug_reset_errors();
+}
+
+static void check_translation(uint32_t page) {
+    uint32_t offset = test_random_below(PAGE_SIZE);
+    void *phys = get_physical_address((uint8_t *)page_address(page) + offset);
+
+    if (shadow[page]) {
+        CHECK(phys == (void *)(uintptr_t)(shadow[page] + offset),
+              "page %u translates to %p, expected 0x%x", page, phys, shadow[page] + offset);
+    } else {
+        CHECK(phys == NULL, "unmapped page %u translates to %p", page, phys);
+    }
+}
+
+/* Random map, remap and unmap operations over the window */
+static void test_random_mappings(uint64_t operations) {
+    setup();
+
+    for (uint64_t op = 0; op < operations; op++) {
+        uint32_t page = test_random_below(WINDOW_PAGES);
+        uint64_t invlpg_before = host_mmu_invlpg_count();
+
+        if (shadow[page] && test_random_below(2)) {
+            unmap_page(page_address(page));
+            shadow[page] = 0;
+        } else {
+            uint32_t frame = pool[test_random_below(POOL_FRAMES)];
+            map_page_to_frame(page_address(page), (void *)(uintptr_t)frame,
+                              PAGE_WRITE, PAGE_CACHE_WB);
+            shadow[page] = frame;
+        }
+        CHECK(host_mmu_invlpg_count() == invlpg_before + 1,
+              "operation %llu did not invalidate exactly one TLB entry", (unsigned long long)op);
+
+        check_translation(page);
+        check_translation(test_random_below(WINDOW_PAGES));
+    }
+
+    // Every page table of the window was created exactly once
+    uint32_t tables = frame_used_count() - frames_before_tables;
+    CHECK(tables <= WINDOW_PAGES / 1024, "%u page tables for a %u table window",
+          tables, WINDOW_PAGES / 1024);
+    for (uint32_t page = 0; page < WINDOW_PAGES; page++) {
+        check_translation(page);
+    }
+    CHECK(host_debug_errors() == 0, "%u paging errors", host_debug_errors());
+    printf("random mappings: %llu operations, %u page tables\n",
+           (unsigned long long)operations, tables);
+}
+
+/* Device mappings land in the MMIO window with the requested memory type */
+static void test_physical_regions(void) {
+    setup();
+
+    uint32_t phys = 0xFD000123;
+    uint32_t size = 3 * PAGE_SIZE;
+    uint8_t *virt = map_physical_region(phys, size, PAGE_WRITE, PAGE_CACHE_WC);
+    uint32_t base = (uint32_t)(uintptr_t)virt;
+
+    CHECK(base >= MMIO_VIRTUAL_BASE && base < MMIO_VIRTUAL_END, "region mapped at 0x%x", base);
+    CHECK((base & (PAGE_SIZE - 1)) == (phys & (PAGE_SIZE - 1)), "region lost its page offset");
+    for (uint32_t off = 0; off < size; off += 512) {
+        void *expected = (void *)(uintptr_t)(phys + off);
+        CHECK(get_physical_address(virt + off) == expected, "offset 0x%x translates wrongly", off);
+    }
+
+    uint32_t *pte = page_table_entry(base);
+    CHECK(pte && (*pte & PAGE_CACHE_MASK) == page_cache_flags(PAGE_CACHE_WC),
+          "region is not mapped write-combining");
+
+    set_region_cache_type(virt, size, PAGE_CACHE_UC);
+    for (uint32_t off = 0; off < 4 * PAGE_SIZE; off += PAGE_SIZE) {
+        pte = page_table_entry((base & PAGE_FRAME) + off);
+        CHECK(pte && (*pte & PAGE_CACHE_MASK) == page_cache_flags(PAGE_CACHE_UC),
+              "page at offset 0x%x was not switched to UC", off);
+        CHECK((*pte & PAGE_FRAME) == (phys & PAGE_FRAME) + off, "memory type change moved the page");
+    }
+    CHECK(host_debug_errors() == 0, "%u paging errors", host_debug_errors());
+    printf("physical regions: ok\n");
+}
+
+/* Pages from kmalloc_physical_page() come back zeroed */
+static void test_zeroed_pages(void) {
+    setup();
+
+    for (int i = 0; i < 1000; i++) {
+        void *page = kmalloc_physical_page();
+        CHECK(page != NULL, "kmalloc_physical_page failed");
+        uint8_t *bytes = mmu_phys_to_virt((uint32_t)(uintptr_t)page);
+        for (uint32_t b = 0; b < PAGE_SIZE; b++) {
+            CHECK(bytes[b] == 0, "page %p byte %u is not zero", page, b);
+        }
+        memset(bytes, 0xA5, PAGE_SIZE);
+        kfree_physical_page(page);
+    }
+    printf("zeroed pages: ok\n");
+}
+
+int main(int argc, char **argv) {
+    uint64_t operations = test_parse_args(argc, argv, 2000000);
+
+    test_zeroed_pages();
+    test_physical_regions();
+    test_random_mappings(operations);
+    return test_finish();
+}
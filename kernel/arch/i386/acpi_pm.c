@@ -0,0 +1,31 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/acpi.h>
+#include "io.h"
+#include "timer.h"
+
+static uint16_t pm_timer_port;
+static uint32_t pm_timer_mask;
+
+static uint64_t acpi_pm_read(void) {
+    return inl(pm_timer_port) & pm_timer_mask;
+}
+
+static struct clocksource acpi_pm_clocksource = {
+    .name = "acpi_pm",
+    .rating = 200,
+    .read = acpi_pm_read,
+};
+
+struct clocksource *acpi_pm_clocksource_init(void) {
+    const struct acpi_fadt *fadt = (const struct acpi_fadt*)acpi_find_table("FACP");
+    if (!fadt || fadt->header.length < sizeof(*fadt) || fadt->pm_tmr_blk == 0) {
+        return NULL;
+    }
+
+    pm_timer_port = (uint16_t)fadt->pm_tmr_blk;
+    pm_timer_mask = (fadt->flags & ACPI_FADT_TMR_VAL_EXT) ? 0xFFFFFFFF : 0xFFFFFF;
+    acpi_pm_clocksource.mask = pm_timer_mask;
+    acpi_pm_clocksource.freq_hz = ACPI_PM_FREQUENCY;
+    return &acpi_pm_clocksource;
+}
@@ -0,0 +1,78 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/backtrace.h>
+#include <kernel/debug.h>
+#include <kernel/ksyms.h>
+#include <kernel/percpu.h>
+#include <kernel/sched.h>
+
+extern uint32_t kernel_virtual_start;
+extern uint32_t kernel_virtual_end;
+
+/**
+ * Follow the saved frame pointers
+ * @param ebp Frame pointer to start from
+ * @param callers Where the return addresses are stored
+ * @param max Room in callers
+ * @return Number of return addresses stored
+ */
+size_t backtrace_walk(uint32_t ebp, uint32_t *callers, size_t max) {
+    const uint32_t low = (uint32_t)&kernel_virtual_start;
+    const uint32_t high = (uint32_t)&kernel_virtual_end;
+    // Frames live on the current thread's stack, return addresses in the
+    // image. Application processors run no threads, only their boot stack.
+    const struct cpu *cpu = this_cpu_ptr();
+    uint32_t stack_low = cpu->stack_base;
+    uint32_t stack_high = cpu->stack_top;
+    if (this_cpu_read(current) || !stack_high) {
+        const struct thread *thread = kthread_current();
+        stack_low = thread->stack_base;
+        stack_high = thread->stack_top;
+    }
+    size_t depth = 0;
+
+    while (depth < max) {
+        if ((ebp & 3) || ebp < stack_low || ebp > stack_high - 2 * sizeof(uint32_t)) {
+            break;
+        }
+        const uint32_t *frame = (const uint32_t*)ebp;
+        uint32_t ret = frame[1];
+        if (ret < low || ret >= high) {
+            break;
+        }
+        callers[depth++] = ret;
+        if (frame[0] <= ebp) {
+            break;
+        }
+        ebp = frame[0];
+    }
+    return depth;
+}
+
+static void print_frame(size_t index, uint32_t addr, uint32_t lookup_addr) {
+    uint32_t offset;
+    const char *name = ksym_lookup(lookup_addr, &offset);
+
+    if (name) {
+        debug_error("  #%u 0x%08x %s+0x%x", (unsigned)index, addr, name, offset + (addr - lookup_addr));
+    } else {
+        debug_error("  #%u 0x%08x ?", (unsigned)index, addr);
+    }
+}
+
+/**
+ * Print a backtrace through the debug subsystem
+ * @param eip Address the backtrace starts at
+ * @param ebp Frame pointer of the code running at eip
+ */
+void backtrace_print(uint32_t eip, uint32_t ebp) {
+    uint32_t callers[BACKTRACE_MAX_FRAMES];
+    size_t depth = backtrace_walk(ebp, callers, BACKTRACE_MAX_FRAMES);
+
+    debug_error("Backtrace:");
+    print_frame(0, eip, eip);
+    for (size_t i = 0; i < depth; i++) {
+        // A return address follows its call, which may end the function
+        print_frame(i + 1, callers[i], callers[i] - 1);
+    }
+}
@@ -0,0 +1,204 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/bench.h>
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/math64.h>
+#include <kernel/smp.h>
+#include "cpu.h"
+#include "io.h"
+
+/* Port of QEMU's isa-debug-exit device; QEMU exits with (value << 1) | 1 */
+#define BENCH_EXIT_PORT    0xF4
+#define BENCH_EXIT_SUCCESS 0
+#define BENCH_EXIT_FAILURE 1
+
+/* Untimed calls before measuring: at least this many, or a tenth of the run */
+#define BENCH_MIN_WARMUP 16
+
+/* Iterations used to measure the cost of the timing itself */
+#define BENCH_OVERHEAD_ITERATIONS 256
+
+extern const struct benchmark __benchmarks_start[];
+extern const struct benchmark __benchmarks_end[];
+
+static uint32_t samples[BENCH_MAX_ITERATIONS];
+
+/* Fewest CPUs any bench_run_on_cpus() of the running benchmark got */
+static uint32_t fewest_cpus;
+
+struct bench_result {
+    uint32_t min;
+    uint32_t median;
+    uint32_t p99;
+    uint32_t max;
+    uint32_t mean;
+};
+
+static void bench_nop(void) {
+    __asm__ volatile("" ::: "memory");
+}
+
+/* Time count calls of fn, one sample per call */
+static void bench_sample(bench_fn_t fn, uint32_t count, uint32_t overhead) {
+    for (uint32_t i = 0; i < count; i++) {
+        uint64_t start = rdtsc();
+        fn();
+        uint64_t cycles = rdtsc() - start;
+
+        cycles = cycles > overhead ? cycles - overhead : 0;
+        samples[i] = cycles > UINT32_MAX ? UINT32_MAX : (uint32_t)cycles;
+    }
+}
+
+/* Shell sort, samples are few enough and this needs no memory */
+static void sort_samples(uint32_t count) {
+    static const uint32_t gaps[] = { 1750, 701, 301, 132, 57, 23, 10, 4, 1 };
+
+    for (size_t g = 0; g < sizeof(gaps) / sizeof(gaps[0]); g++) {
+        uint32_t gap = gaps[g];
+        for (uint32_t i = gap; i < count; i++) {
+            uint32_t value = samples[i];
+            uint32_t j = i;
+            while (j >= gap && samples[j - gap] > value) {
+                samples[j] = samples[j - gap];
+                j -= gap;
+            }
+            samples[j] = value;
+        }
+    }
+}
+
+static void summarize(uint32_t count, struct bench_result *result) {
+    uint64_t sum = 0;
+
+    sort_samples(count);
+    for (uint32_t i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+
+    result->min = samples[0];
+    result->median = samples[count / 2];
+    result->p99 = samples[(count * 99) / 100];
+    result->max = samples[count - 1];
+    result->mean = (uint32_t)div_u64_u32(sum, count);
+}
+
+/* Cheapest empty call, subtracted from every sample */
+static uint32_t measure_overhead(void) {
+    struct bench_result result;
+
+    bench_sample(bench_nop, BENCH_OVERHEAD_ITERATIONS, 0);
+    summarize(BENCH_OVERHEAD_ITERATIONS, &result);
+    return result.min;
+}
+
+/**
+ * Run one benchmark
+ * @param bench Benchmark to run
+ * @param overhead Cycles the timing adds to every sample
+ * @return false if the benchmark asks for an impossible iteration count or
+ *         could not get all the CPUs it needs
+ */
+static bool run_benchmark(const struct benchmark *bench, uint32_t overhead) {
+    uint32_t iterations = bench->iterations ? bench->iterations : BENCH_ITERATIONS;
+    if (iterations == 0 || iterations > BENCH_MAX_ITERATIONS) {
+        debug_error("bench: %s wants %u iterations, at most %u are supported",
+                    bench->name, iterations, BENCH_MAX_ITERATIONS);
+        return false;
+    }
+
+    if (bench->cpus > smp_online_count()) {
+        debug_warning("bench: skipping %s, it needs %u CPUs and %u are online",
+                      bench->name, bench->cpus, smp_online_count());
+        return true;
+    }
+
+    uint32_t warmup = iterations / 10;
+    if (warmup < BENCH_MIN_WARMUP) {
+        warmup = BENCH_MIN_WARMUP;
+    }
+
+    fewest_cpus = UINT32_MAX;
+    if (bench->setup) {
+        bench->setup();
+    }
+    for (uint32_t i = 0; i < warmup; i++) {
+        bench->fn();
+    }
+    bench_sample(bench->fn, iterations, overhead);
+    if (bench->teardown) {
+        bench->teardown();
+    }
+
+    if (bench->cpus && fewest_cpus < bench->cpus) {
+        debug_error("bench: %s ran on %u of its %u CPUs, dropping the result",
+                    bench->name, fewest_cpus, bench->cpus);
+        return false;
+    }
+
+    struct bench_result result;
+    summarize(iterations, &result);
+
+    debug_info("bench-result: {\"name\":\"%s\",\"iterations\":%u,\"warmup\":%u,"
+               "\"min\":%u,\"median\":%u,\"p99\":%u,\"max\":%u,\"mean\":%u}",
+               bench->name, iterations, warmup, result.min, result.median,
+               result.p99, result.max, result.mean);
+    return true;
+}
+
+/**
+ * Run fn(arg) on this CPU and on up to cpus - 1 application processors at
+ * once, returning when every copy has finished
+ * @param cpus CPUs wanted, including this one
+ * @return CPUs that ran it; fewer than asked if not enough are online
+ */
+uint32_t bench_run_on_cpus(uint32_t cpus, void (*fn)(void*), void *arg) {
+    uint32_t helpers[SMP_MAX_CPUS];
+    uint32_t started = 0;
+
+    for (uint32_t index = 1; index < smp_cpu_count() && started + 1 < cpus; index++) {
+        if (smp_call(index, fn, arg)) {
+            helpers[started++] = index;
+        }
+    }
+    fn(arg);
+    for (uint32_t i = 0; i < started; i++) {
+        smp_call_wait(helpers[i]);
+    }
+    if (started + 1 < fewest_cpus) {
+        fewest_cpus = started + 1;
+    }
+    return started + 1;
+}
+
+static void __attribute__((noreturn)) bench_exit(uint8_t status) {
+    outb(BENCH_EXIT_PORT, status);
+
+    // Not running under QEMU with isa-debug-exit, just stop here
+    debug_warning("bench: no isa-debug-exit device, halting");
+    for (;;) {
+        __asm__ volatile("cli; hlt");
+    }
+}
+
+void bench_run_all(void) {
+    const struct clocksource *tsc = clocksource_get("tsc");
+    size_t count = (size_t)(__benchmarks_end - __benchmarks_start);
+    bool ok = true;
+
+    // Keep per-call logging from the code under test out of the numbers
+    debug_set_level(DEBUG_LEVEL_INFO);
+
+    uint32_t overhead = measure_overhead();
+    debug_info("bench-meta: {\"benchmarks\":%u,\"tsc_hz\":%llu,\"overhead\":%u}",
+               (unsigned)count, tsc ? tsc->freq_hz : 0, overhead);
+
+    for (const struct benchmark *bench = __benchmarks_start; bench < __benchmarks_end; bench++) {
+        ok = run_benchmark(bench, overhead) && ok;
+    }
+
+    debug_info("bench-done: %s", ok ? "ok" : "failed");
+    bench_exit(ok ? BENCH_EXIT_SUCCESS : BENCH_EXIT_FAILURE);
+}
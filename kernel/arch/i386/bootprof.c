@@ -0,0 +1,111 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/bootprof.h>
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/math64.h>
+#include "cpu.h"
+
+/* Phases started by the marks boot.S stores, indexed by BOOT_MARK_* */
+static const char *const early_phase_names[BOOT_EARLY_MARKS] = {
+    [BOOT_MARK_ENTRY] = "bootstrap page tables",
+    [BOOT_MARK_PAGING] = "enable paging",
+    [BOOT_MARK_HIGHER_HALF] = "setup_gdt",
+    [BOOT_MARK_BOOT_INFO] = "validate_boot",
+    [BOOT_MARK_IDT] = "setup_idt",
+    [BOOT_MARK_CONSTRUCTORS] = "_init",
+    [BOOT_MARK_TERMINAL] = "terminal_initialize",
+    [BOOT_MARK_KERNEL_MAIN] = "kernel_main",
+};
+
+struct boot_mark {
+    const char *name;
+    uint64_t tsc;
+};
+
+static struct boot_mark marks[BOOTPROF_MAX_MARKS];
+static size_t mark_count;
+
+/* When bootprof_report() closed the last phase, 0 while booting */
+static uint64_t end_tsc;
+
+/**
+ * Start a new boot phase
+ * @param name Name of the phase, printed by bootprof_report()
+ */
+void bootprof_mark(const char *name) {
+    uint64_t now = rdtsc();
+
+    if (mark_count < BOOTPROF_MAX_MARKS) {
+        marks[mark_count].name = name;
+        marks[mark_count].tsc = now;
+        mark_count++;
+    }
+}
+
+static void add_phase(struct bootprof_phase *phases, size_t max, size_t *count,
+                      const char *name, uint64_t cycles) {
+    if (*count < max) {
+        phases[*count].name = name;
+        phases[*count].cycles = cycles;
+        (*count)++;
+    }
+}
+
+/**
+ * Get the length of every phase so far, or up to bootprof_report() once
+ * boot has finished
+ * @param phases Where the phases are stored
+ * @param max Room in phases
+ * @return Number of phases stored
+ */
+size_t bootprof_get_phases(struct bootprof_phase *phases, size_t max) {
+    uint64_t end = end_tsc ? end_tsc : rdtsc();
+    size_t count = 0;
+
+    // The TSC counts from reset, so the first stamp is what came before us
+    add_phase(phases, max, &count, "firmware and bootloader", boot_tsc_marks[BOOT_MARK_ENTRY]);
+
+    for (size_t i = 0; i < BOOT_EARLY_MARKS; i++) {
+        uint64_t next = (i + 1 < BOOT_EARLY_MARKS) ? boot_tsc_marks[i + 1] :
+                        (mark_count > 0 ? marks[0].tsc : end);
+        add_phase(phases, max, &count, early_phase_names[i], next - boot_tsc_marks[i]);
+    }
+    for (size_t i = 0; i < mark_count; i++) {
+        uint64_t next = (i + 1 < mark_count) ? marks[i + 1].tsc : end;
+        add_phase(phases, max, &count, marks[i].name, next - marks[i].tsc);
+    }
+
+    add_phase(phases, max, &count, "total", end - boot_tsc_marks[BOOT_MARK_ENTRY]);
+
+    return count;
+}
+
+static void report_phase(const struct clocksource *tsc, const char *name, uint64_t cycles) {
+    if (tsc) {
+        uint64_t us = div_u64_u32(clocksource_cycles_to_ns(tsc, cycles), 1000);
+        debug_info("bootprof: %-24s %12llu cycles %10llu us", name, cycles, us);
+    } else {
+        debug_info("bootprof: %-24s %12llu cycles          - us", name, cycles);
+    }
+}
+
+/**
+ * Print how long each boot phase took, from the first instruction of
+ * multiboot_entry up to this call
+ */
+void bootprof_report(void) {
+    end_tsc = rdtsc();
+
+    struct bootprof_phase phases[BOOTPROF_MAX_PHASES];
+    size_t count = bootprof_get_phases(phases, BOOTPROF_MAX_PHASES);
+    const struct clocksource *tsc = clocksource_get("tsc");
+
+    debug_info("Boot profile (phase, TSC cycles, microseconds):");
+    for (size_t i = 0; i < count; i++) {
+        report_phase(tsc, phases[i].name, phases[i].cycles);
+    }
+    if (!tsc) {
+        debug_warning("bootprof: TSC not calibrated, times are in cycles only");
+    }
+}
@@ -0,0 +1,13 @@
+#ifndef ARCH_I386_CPU_H
+#define ARCH_I386_CPU_H
+
+#include <stdint.h>
+
+/* Read the time-stamp counter */
+static inline uint64_t rdtsc(void) {
+    uint32_t low, high;
+    __asm__ volatile("rdtsc" : "=a"(low), "=d"(high));
+    return ((uint64_t)high << 32) | low;
+}
+
+#endif /* ARCH_I386_CPU_H */
@@ -0,0 +1,289 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <multiboot2.h>
+#include <paging.h>
+#include <kernel/debug.h>
+#include "cpu.h"
+#include "fbcon.h"
+#include "font.h"
+
+/* Number of expanded glyphs kept ready for blitting (power of two) */
+#define GLYPH_CACHE_SIZE 256
+
+/* Pixel rows of the cell covered by the underline cursor */
+#define CURSOR_HEIGHT 2
+
+/* Standard VGA text palette as 0xRRGGBB */
+static const uint32_t vga_palette[16] = {
+    0x000000, 0x0000AA, 0x00AA00, 0x00AAAA,
+    0xAA0000, 0xAA00AA, 0xAA5500, 0xAAAAAA,
+    0x555555, 0x5555FF, 0x55FF55, 0x55FFFF,
+    0xFF5555, 0xFF55FF, 0xFFFF55, 0xFFFFFF,
+};
+
+/*
+ * A glyph expanded to framebuffer pixels for one character/attribute pair,
+ * so drawing a cell is just FONT_HEIGHT copies of FONT_WIDTH 32-bit words.
+ */
+struct glyph_entry {
+    bool valid;
+    uint16_t cell;
+    uint32_t pixels[FONT_HEIGHT][FONT_WIDTH];
+};
+
+static struct glyph_entry glyph_cache[GLYPH_CACHE_SIZE];
+
+static uint32_t *framebuffer;
+static size_t fb_size;              /* Bytes mapped */
+static size_t fb_width;             /* Visible pixels per scanline */
+static size_t fb_height;
+static size_t fb_stride;            /* Pixels (32-bit words) per scanline */
+static size_t fb_columns;
+static size_t fb_rows;
+static uint32_t palette[16];        /* vga_palette in the framebuffer's format */
+
+/* What each character cell of the framebuffer currently shows */
+static uint16_t front[FBCON_MAX_ROWS][FBCON_MAX_COLUMNS];
+
+static size_t cursor_x;
+static size_t cursor_y;
+static bool cursor_visible;
+
+/* Scale an 8-bit colour component into a framebuffer colour field */
+static inline uint32_t pack_component(uint32_t value, uint8_t position, uint8_t size) {
+    return (size >= 8 ? value : value >> (8 - size)) << position;
+}
+
+static inline size_t glyph_slot(uint16_t cell) {
+    return ((cell & 0xFF) ^ ((cell >> 8) * 0x25u)) & (GLYPH_CACHE_SIZE - 1);
+}
+
+/* Get the expanded pixels for a cell, rendering them on a cache miss */
+static const struct glyph_entry *glyph_lookup(uint16_t cell) {
+    struct glyph_entry *entry = &glyph_cache[glyph_slot(cell)];
+    if (entry->valid && entry->cell == cell) {
+        return entry;
+    }
+
+    const uint8_t *bitmap = font_glyph((unsigned char)cell);
+    uint32_t fg = palette[(cell >> 8) & 0x0F];
+    uint32_t bg = palette[(cell >> 12) & 0x0F];
+
+    for (size_t row = 0; row < FONT_HEIGHT; row++) {
+        uint8_t bits = bitmap[row];
+        for (size_t x = 0; x < FONT_WIDTH; x++) {
+            entry->pixels[row][x] = (bits & (0x80 >> x)) ? fg : bg;
+        }
+    }
+    entry->cell = cell;
+    entry->valid = true;
+    return entry;
+}
+
+static inline uint32_t *cell_pixels(size_t x, size_t y) {
+    return framebuffer + y * FONT_HEIGHT * fb_stride + x * FONT_WIDTH;
+}
+
+/* Blit a run of cells on one character row, a scanline at a time */
+static void blit_cells(size_t x, size_t y, const uint16_t *cells, size_t count) {
+    const struct glyph_entry *glyphs[FBCON_MAX_COLUMNS];
+    for (size_t i = 0; i < count; i++) {
+        glyphs[i] = glyph_lookup(cells[i]);
+    }
+
+    uint32_t *line = cell_pixels(x, y);
+    for (size_t row = 0; row < FONT_HEIGHT; row++) {
+        uint32_t *dst = line;
+        for (size_t i = 0; i < count; i++) {
+            const uint32_t *src = glyphs[i]->pixels[row];
+            for (size_t px = 0; px < FONT_WIDTH; px++) {
+                dst[px] = src[px];
+            }
+            dst += FONT_WIDTH;
+        }
+        line += fb_stride;
+    }
+}
+
+static void draw_cursor(void) {
+    uint32_t color = palette[(front[cursor_y][cursor_x] >> 8) & 0x0F];
+    uint32_t *line = cell_pixels(cursor_x, cursor_y) + (FONT_HEIGHT - CURSOR_HEIGHT) * fb_stride;
+
+    for (size_t row = 0; row < CURSOR_HEIGHT; row++) {
+        for (size_t px = 0; px < FONT_WIDTH; px++) {
+            line[px] = color;
+        }
+        line += fb_stride;
+    }
+}
+
+bool fbcon_init(const struct boot_framebuffer *fb, size_t *columns, size_t *rows) {
+    if (!fb->present || fb->type != MULTIBOOT_FRAMEBUFFER_TYPE_RGB || fb->bpp != 32) {
+        debug_warning("Framebuffer console needs a 32bpp RGB mode");
+        return false;
+    }
+    if (fb->address + (uint64_t)fb->pitch * fb->height > 0x100000000ULL) {
+        debug_warning("Framebuffer at 0x%llx is above 4GB", fb->address);
+        return false;
+    }
+
+    /* Scanout memory is only written, so let the CPU combine the stores */
+    size_t size = (size_t)fb->pitch * fb->height;
+    framebuffer = map_physical_region((uint32_t)fb->address, size, PAGE_WRITE, PAGE_CACHE_WC);
+    if (!framebuffer) {
+        return false;
+    }
+
+    fb_size = size;
+    fb_width = fb->width;
+    fb_height = fb->height;
+    fb_stride = fb->pitch / sizeof(uint32_t);
+    fb_columns = fb->width / FONT_WIDTH;
+    fb_rows = fb->height / FONT_HEIGHT;
+    if (fb_columns > FBCON_MAX_COLUMNS) {
+        fb_columns = FBCON_MAX_COLUMNS;
+    }
+    if (fb_rows > FBCON_MAX_ROWS) {
+        fb_rows = FBCON_MAX_ROWS;
+    }
+
+    for (size_t i = 0; i < 16; i++) {
+        uint32_t rgb = vga_palette[i];
+        palette[i] = pack_component((rgb >> 16) & 0xFF, fb->red_position, fb->red_size)
+                   | pack_component((rgb >> 8) & 0xFF, fb->green_position, fb->green_size)
+                   | pack_component(rgb & 0xFF, fb->blue_position, fb->blue_size);
+    }
+
+    /* Black screen; a zero cell renders as a space drawn black on black */
+    memset(framebuffer, 0, size);
+    memset(front, 0, sizeof(front));
+    memset(glyph_cache, 0, sizeof(glyph_cache));
+    cursor_visible = false;
+
+    debug_info("Framebuffer console: %ux%u pixels, %zux%zu cells",
+               fb->width, fb->height, fb_columns, fb_rows);
+
+    *columns = fb_columns;
+    *rows = fb_rows;
+    return true;
+}
+
+void fbcon_draw_row(size_t y, const uint16_t *cells, size_t columns) {
+    uint16_t *shown = front[y];
+    bool cursor_hit = false;
+    size_t x = 0;
+
+    if (columns > fb_columns) {
+        columns = fb_columns;
+    }
+
+    while (x < columns) {
+        if (shown[x] == cells[x]) {
+            x++;
+            continue;
+        }
+
+        /* Extend the dirty rectangle over the run of changed cells */
+        size_t start = x;
+        while (x < columns && shown[x] != cells[x]) {
+            shown[x] = cells[x];
+            x++;
+        }
+        blit_cells(start, y, cells + start, x - start);
+
+        if (y == cursor_y && cursor_x >= start && cursor_x < x) {
+            cursor_hit = true;
+        }
+    }
+
+    if (cursor_hit && cursor_visible) {
+        draw_cursor();
+    }
+}
+
+void fbcon_set_cursor(size_t x, size_t y, bool visible) {
+    if (x >= fb_columns || y >= fb_rows) {
+        visible = false;
+    }
+    if (x == cursor_x && y == cursor_y && visible == cursor_visible) {
+        return;
+    }
+
+    if (cursor_visible) {
+        blit_cells(cursor_x, cursor_y, &front[cursor_y][cursor_x], 1);
+    }
+
+    cursor_x = visible ? x : 0;
+    cursor_y = visible ? y : 0;
+    cursor_visible = visible;
+    if (visible) {
+        draw_cursor();
+    }
+}
+
+/* Store one colour to every visible pixel */
+static void fill_screen(uint32_t color) {
+    uint32_t *line = framebuffer;
+    for (size_t y = 0; y < fb_height; y++) {
+        for (size_t x = 0; x < fb_width; x++) {
+            line[x] = color;
+        }
+        line += fb_stride;
+    }
+}
+
+/* Blit every cell again, which is what a scroll costs on this backend */
+static void redraw_screen(void) {
+    for (size_t y = 0; y < fb_rows; y++) {
+        blit_cells(0, y, front[y], fb_columns);
+    }
+}
+
+uint64_t fbcon_benchmark_direct(const char *line, uint8_t color, size_t lines) {
+    const size_t row_pixels = FONT_HEIGHT * fb_stride;
+    size_t row = fb_rows - 1;
+
+    uint64_t start = rdtsc();
+    for (size_t i = 0; i < lines; i++) {
+        for (size_t x = 0; line[x] != '\n' && x < fb_columns; x++) {
+            const uint16_t cell = (uint16_t)(unsigned char)line[x] | (uint16_t)color << 8;
+            blit_cells(x, row, &cell, 1);
+        }
+        memmove(framebuffer, framebuffer + row_pixels,
+                sizeof(uint32_t) * row_pixels * (fb_rows - 1));
+        memset(framebuffer + row_pixels * (fb_rows - 1), 0, sizeof(uint32_t) * row_pixels);
+    }
+    uint64_t cycles = rdtsc() - start;
+
+    /* front[] was bypassed, so it still holds what the screen should show */
+    redraw_screen();
+    if (cursor_visible) {
+        draw_cursor();
+    }
+    return cycles;
+}
+
+void fbcon_set_cache_type(enum page_cache_type type) {
+    set_region_cache_type(framebuffer, fb_size, type);
+}
+
+void fbcon_benchmark_pass(size_t passes, uint64_t *fill, uint64_t *scroll) {
+    uint64_t start = rdtsc();
+    for (size_t i = 0; i < passes; i++) {
+        fill_screen(palette[i & 1 ? 1 : 0]);
+    }
+    *fill = rdtsc() - start;
+
+    start = rdtsc();
+    for (size_t i = 0; i < passes; i++) {
+        redraw_screen();
+    }
+    *scroll = rdtsc() - start;
+
+    redraw_screen();
+    if (cursor_visible) {
+        draw_cursor();
+    }
+}
@@ -0,0 +1,49 @@
+#ifndef ARCH_I386_FBCON_H
+#define ARCH_I386_FBCON_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <paging.h>
+#include <kernel/bootinfo.h>
+
+/* Largest character grid the framebuffer console will drive */
+#define FBCON_MAX_COLUMNS 128
+#define FBCON_MAX_ROWS    64
+
+/*
+ * Map the linear framebuffer and clear it. Only 32 bits per pixel direct
+ * colour modes are supported. On success the size of the character grid is
+ * stored in columns and rows.
+ */
+bool fbcon_init(const struct boot_framebuffer* fb, size_t* columns, size_t* rows);
+
+/*
+ * Draw one row of VGA-style cells (character | attribute << 8). Cells that
+ * already show the same value are skipped, so only the changed runs of the
+ * row reach the framebuffer.
+ */
+void fbcon_draw_row(size_t y, const uint16_t* cells, size_t columns);
+
+/* Move the underline cursor; a hidden cursor is not drawn at all */
+void fbcon_set_cursor(size_t x, size_t y, bool visible);
+
+/*
+ * Time the naive way to print lines on a framebuffer, the reference for the
+ * console's scroll benchmark: each character is blitted straight away and
+ * each new line moves the whole screen up a row in framebuffer memory. The
+ * screen is redrawn afterwards.
+ * @return TSC cycles for all the lines
+ */
+uint64_t fbcon_benchmark_direct(const char* line, uint8_t color, size_t lines);
+
+/* Remap the framebuffer with another memory type, for the cache benchmark */
+void fbcon_set_cache_type(enum page_cache_type type);
+
+/*
+ * Time full-screen fills and full-screen redraws with the framebuffer's
+ * current memory type. The screen is redrawn afterwards.
+ */
+void fbcon_benchmark_pass(size_t passes, uint64_t* fill, uint64_t* scroll);
+
+#endif
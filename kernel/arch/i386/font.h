@@ -0,0 +1,31 @@
+#ifndef ARCH_I386_FONT_H
+#define ARCH_I386_FONT_H
+
+#include <stdint.h>
+
+/* Glyph cell size of the built-in console font */
+#define FONT_WIDTH  8
+#define FONT_HEIGHT 16
+
+/* First and last character with a glyph of its own */
+#define FONT_FIRST_CHAR 0x20
+#define FONT_LAST_CHAR  0x7E
+
+/*
+ * Bitmaps for FONT_FIRST_CHAR..FONT_LAST_CHAR followed by a replacement box
+ * used for everything else. One byte per pixel row, MSB is the left pixel.
+ */
+extern const uint8_t font_glyphs[FONT_LAST_CHAR - FONT_FIRST_CHAR + 2][FONT_HEIGHT];
+
+/* Get the bitmap for a character, falling back to the replacement box */
+static inline const uint8_t *font_glyph(unsigned char c) {
+    if (c == 0) {
+        c = ' ';
+    }
+    if (c < FONT_FIRST_CHAR || c > FONT_LAST_CHAR) {
+        return font_glyphs[FONT_LAST_CHAR - FONT_FIRST_CHAR + 1];
+    }
+    return font_glyphs[c - FONT_FIRST_CHAR];
+}
+
+#endif /* ARCH_I386_FONT_H */
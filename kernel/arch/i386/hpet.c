@@ -0,0 +1,68 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <paging.h>
+#include <kernel/acpi.h>
+#include <kernel/debug.h>
+#include <kernel/math64.h>
+#include "timer.h"
+
+/* HPET register offsets */
+#define HPET_CAPABILITIES  0x000
+#define HPET_CONFIG        0x010
+#define HPET_MAIN_COUNTER  0x0F0
+#define HPET_REGISTER_SIZE 0x400
+
+#define HPET_CONFIG_ENABLE 0x1
+
+#define FEMTOSECONDS_PER_SECOND 1000000000000000ULL
+
+static volatile uint8_t *hpet_base;
+
+static inline uint32_t hpet_read32(uint32_t offset) {
+    return *(volatile uint32_t*)(hpet_base + offset);
+}
+
+static inline void hpet_write32(uint32_t offset, uint32_t value) {
+    *(volatile uint32_t*)(hpet_base + offset) = value;
+}
+
+/* Only the low half is read, so a read is one access with no tearing */
+static uint64_t hpet_read(void) {
+    return hpet_read32(HPET_MAIN_COUNTER);
+}
+
+static struct clocksource hpet_clocksource = {
+    .name = "hpet",
+    .rating = 250,
+    .read = hpet_read,
+    .mask = 0xFFFFFFFF,
+};
+
+struct clocksource *hpet_clocksource_init(void) {
+    const struct acpi_hpet *table = (const struct acpi_hpet*)acpi_find_table("HPET");
+    if (!table) {
+        return NULL;
+    }
+    if (table->base_address.address_space != ACPI_GAS_MEMORY ||
+        table->base_address.address >= 0x100000000ULL) {
+        debug_warning("HPET registers at an unsupported address");
+        return NULL;
+    }
+
+    hpet_base = map_physical_region((uint32_t)table->base_address.address, HPET_REGISTER_SIZE,
+                                    PAGE_WRITE, PAGE_CACHE_UC);
+    if (!hpet_base) {
+        return NULL;
+    }
+
+    // The tick period in femtoseconds is in the upper half of the capabilities
+    uint32_t period_fs = hpet_read32(HPET_CAPABILITIES + 4);
+    if (period_fs == 0 || period_fs > 100000000) {
+        debug_warning("HPET reports a bogus period of %u fs", period_fs);
+        return NULL;
+    }
+
+    hpet_write32(HPET_CONFIG, hpet_read32(HPET_CONFIG) | HPET_CONFIG_ENABLE);
+    hpet_clocksource.freq_hz = (uint32_t)div_u64_u32(FEMTOSECONDS_PER_SECOND, period_fs);
+    return &hpet_clocksource;
+}
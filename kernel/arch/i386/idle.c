@@ -0,0 +1,133 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <interrupts.h>
+#include <msr.h>
+#include <kernel/debug.h>
+#include <kernel/idle.h>
+#include <kernel/math64.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+#include "cpu.h"
+
+/* Whether every CPU can wait with MONITOR/MWAIT; they are assumed alike */
+static bool use_mwait = false;
+
+/**
+ * Pick MWAIT over HLT if the CPU has it
+ */
+void idle_init(void) {
+    use_mwait = cpu_has_feature_ecx(CPUID_FEAT_ECX_MONITOR);
+    debug_info("Idle: CPUs wait with %s", use_mwait ? "MONITOR/MWAIT" : "HLT");
+}
+
+bool cpu_idle_mwait(void) {
+    return use_mwait;
+}
+
+/*
+ * idle_start and idle_cycles are read by other CPUs, which cannot read
+ * 64 bits at once. The sequence is odd while they change, as with the
+ * telemetry page, so a reader can retry a torn copy.
+ */
+static void idle_update(struct cpu *cpu, uint64_t start, uint64_t cycles) {
+    __atomic_store_n(&cpu->idle_seq, cpu->idle_seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    cpu->idle_start = start;
+    cpu->idle_cycles = cycles;
+    __atomic_store_n(&cpu->idle_seq, cpu->idle_seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Add the halt that just ended to the idle time; interrupts disabled
+ */
+void idle_account_end(void) {
+    struct cpu *cpu = this_cpu_ptr();
+    uint64_t now = rdtsc();
+    idle_update(cpu, 0, cpu->idle_cycles + (now - cpu->idle_start));
+}
+
+/**
+ * Halt until an interrupt or, with MWAIT, a store to the watched word
+ * @param watch 32-bit word to watch, or NULL
+ */
+void cpu_idle(const volatile void *watch) {
+    struct cpu *cpu = this_cpu_ptr();
+    idle_update(cpu, rdtsc(), cpu->idle_cycles);
+
+    // sti holds interrupts off for one more instruction, so an interrupt
+    // that comes after the caller's check still ends the wait
+    if (use_mwait) {
+        const volatile void *line = watch ? watch : &cpu->idle_start;
+        if (watch) {
+            __atomic_store_n(&cpu->idle_watching, true, __ATOMIC_RELAXED);
+            __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        }
+        __asm__ volatile("monitor" : : "a"(line), "c"(0), "d"(0));
+        if (!watch || *(const volatile uint32_t*)watch == 0) {
+            __asm__ volatile("sti; mwait" : : "a"(0), "c"(0) : "memory");
+        } else {
+            interrupts_enable();
+        }
+        __atomic_store_n(&cpu->idle_watching, false, __ATOMIC_RELAXED);
+    } else {
+        __asm__ volatile("sti; hlt" ::: "memory");
+    }
+
+    // Woken by a store rather than an interrupt, or the handler already
+    // closed the period
+    interrupts_disable();
+    idle_account();
+    interrupts_enable();
+}
+
+/**
+ * Split a CPU's time online into busy and idle
+ * @param index CPU to report
+ * @param busy Set to the TSC cycles it was not halted
+ * @param idle Set to the TSC cycles it was halted
+ * @return false if there is no such CPU or it is offline
+ */
+bool cpu_times(uint32_t index, uint64_t *busy, uint64_t *idle) {
+    struct cpu *cpu = smp_cpu(index);
+    if (!cpu || !__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    uint32_t seq;
+    uint64_t start, cycles, now;
+    do {
+        seq = __atomic_load_n(&cpu->idle_seq, __ATOMIC_ACQUIRE);
+        start = cpu->idle_start;
+        cycles = cpu->idle_cycles;
+        now = rdtsc();
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || __atomic_load_n(&cpu->idle_seq, __ATOMIC_RELAXED) != seq);
+
+    if (start && now > start) {
+        cycles += now - start;
+    }
+    // TSCs of different CPUs can disagree by a little
+    uint64_t total = now > cpu->online_tsc ? now - cpu->online_tsc : 0;
+    if (cycles > total) {
+        cycles = total;
+    }
+    *idle = cycles;
+    *busy = total - cycles;
+    return true;
+}
+
+/**
+ * Busy share of a period
+ * @param busy Busy cycles
+ * @param idle Idle cycles
+ * @return Percentage busy, 0 with no time at all
+ */
+uint32_t cpu_busy_percent(uint64_t busy, uint64_t idle) {
+    // Scale busy first, so the product cannot overflow either
+    while (busy > UINT64_MAX / 100) {
+        busy >>= 1;
+        idle >>= 1;
+    }
+    return (uint32_t)div_u64_u64_approx(busy * 100, busy + idle);
+}
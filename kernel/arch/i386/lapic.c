@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <paging.h>
+#include <idt.h>
+#include <msr.h>
+#include <kernel/debug.h>
+#include "lapic.h"
+
+/* Reads of the ICR before giving up on a delivery */
+#define LAPIC_ICR_POLLS 1000000
+
+static volatile uint8_t *lapic_base;
+
+static inline uint32_t lapic_read(uint32_t offset) {
+    return *(volatile uint32_t*)(lapic_base + offset);
+}
+
+static inline void lapic_write(uint32_t offset, uint32_t value) {
+    *(volatile uint32_t*)(lapic_base + offset) = value;
+}
+
+/**
+ * Map the local APIC registers and enable the calling CPU's APIC
+ * @param physical_addr Register base from the MADT
+ * @return true if the CPU has a local APIC
+ */
+bool lapic_init(uint32_t physical_addr) {
+    if (!cpu_has_feature_edx(CPUID_FEAT_EDX_APIC) || !cpu_has_feature_edx(CPUID_FEAT_EDX_MSR)) {
+        debug_warning("CPU has no local APIC");
+        return false;
+    }
+
+    // The MSR is authoritative if firmware relocated the APIC
+    uint64_t apic_base = rdmsr(MSR_IA32_APIC_BASE);
+    if ((apic_base & APIC_BASE_ADDR) != physical_addr) {
+        debug_warning("Local APIC at 0x%x, MADT says 0x%x",
+                      (uint32_t)apic_base & APIC_BASE_ADDR, physical_addr);
+        physical_addr = (uint32_t)apic_base & APIC_BASE_ADDR;
+    }
+    if (!(apic_base & APIC_BASE_ENABLE)) {
+        wrmsr(MSR_IA32_APIC_BASE, apic_base | APIC_BASE_ENABLE);
+    }
+
+    lapic_base = map_physical_region(physical_addr, LAPIC_REGISTER_SIZE, PAGE_WRITE, PAGE_CACHE_UC);
+    if (!lapic_base) {
+        return false;
+    }
+
+    lapic_enable();
+    debug_info("Local APIC at 0x%x, ID %u, version 0x%x", physical_addr,
+               (unsigned)lapic_id(), lapic_read(LAPIC_VERSION) & 0xFF);
+    return true;
+}
+
+/**
+ * Software-enable the local APIC, leaving its LVT entries as firmware set
+ * them so the PICs keep reaching the bootstrap processor through LINT0
+ */
+void lapic_enable(void) {
+    lapic_write(LAPIC_SVR, LAPIC_SVR_ENABLE | IDT_LAPIC_SPURIOUS);
+    lapic_write(LAPIC_TPR, 0);
+}
+
+uint8_t lapic_id(void) {
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+/**
+ * Send an inter-processor interrupt and wait for the APIC to accept it
+ * @param apic_id Destination APIC ID
+ * @param command Low word of the ICR
+ * @return true if the IPI was delivered
+ */
+static bool lapic_send_ipi(uint8_t apic_id, uint32_t command) {
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ICR_HIGH, (uint32_t)apic_id << 24);
+    lapic_write(LAPIC_ICR_LOW, command);
+
+    for (uint32_t i = 0; i < LAPIC_ICR_POLLS; i++) {
+        if (!(lapic_read(LAPIC_ICR_LOW) & LAPIC_ICR_PENDING)) {
+            return true;
+        }
+        __asm__ volatile("pause");
+    }
+    debug_error("IPI 0x%x to APIC %u not delivered", command, (unsigned)apic_id);
+    return false;
+}
+
+/**
+ * Reset another CPU into its wait-for-SIPI state
+ * @param apic_id Destination APIC ID
+ * @return true if both halves of the INIT were delivered
+ */
+bool lapic_send_init(uint8_t apic_id) {
+    // Assert, then deassert as the MP specification asks for older APICs
+    if (!lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL | LAPIC_ICR_ASSERT)) {
+        return false;
+    }
+    return lapic_send_ipi(apic_id, LAPIC_ICR_INIT | LAPIC_ICR_LEVEL);
+}
+
+/**
+ * Start a CPU waiting for SIPI in real mode at page * 4096
+ * @param apic_id Destination APIC ID
+ * @param page Physical page of the entry point, below 1 MB
+ * @return true if the IPI was delivered
+ */
+bool lapic_send_startup(uint8_t apic_id, uint8_t page) {
+    return lapic_send_ipi(apic_id, LAPIC_ICR_STARTUP | page);
+}
+
+/**
+ * Interrupt another CPU through its IDT
+ * @param apic_id Destination APIC ID
+ * @param vector Vector to raise, 32 to 255
+ * @return true if the IPI was delivered
+ */
+bool lapic_send_vector(uint8_t apic_id, uint8_t vector) {
+    return lapic_send_ipi(apic_id, LAPIC_ICR_FIXED | vector);
+}
+
+void lapic_eoi(void) {
+    lapic_write(LAPIC_EOI, 0);
+}
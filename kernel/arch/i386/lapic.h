@@ -0,0 +1,54 @@
+#ifndef ARCH_I386_LAPIC_H
+#define ARCH_I386_LAPIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Local APIC register offsets */
+#define LAPIC_ID          0x020
+#define LAPIC_VERSION     0x030
+#define LAPIC_TPR         0x080
+#define LAPIC_EOI         0x0B0
+#define LAPIC_SVR         0x0F0
+#define LAPIC_ESR         0x280
+#define LAPIC_ICR_LOW     0x300
+#define LAPIC_ICR_HIGH    0x310
+#define LAPIC_REGISTER_SIZE 0x400
+
+/* Spurious vector register: software enable */
+#define LAPIC_SVR_ENABLE  (1u << 8)
+
+/* Interrupt command register fields */
+#define LAPIC_ICR_FIXED         (0u << 8)
+#define LAPIC_ICR_INIT          (5u << 8)
+#define LAPIC_ICR_STARTUP       (6u << 8)
+#define LAPIC_ICR_PENDING       (1u << 12)
+#define LAPIC_ICR_ASSERT        (1u << 14)
+#define LAPIC_ICR_LEVEL         (1u << 15)
+
+/*
+ * Map the local APICs at physical_addr, enable the one of the calling CPU
+ * and return false if the CPU has none
+ */
+bool lapic_init(uint32_t physical_addr);
+
+/* Software-enable the calling CPU's local APIC; lapic_init() must have run */
+void lapic_enable(void);
+
+/* APIC ID of the calling CPU */
+uint8_t lapic_id(void);
+
+/*
+ * Send INIT, then STARTUP with the real-mode page of the entry point, to
+ * another CPU. Each returns false if the IPI was not accepted in time.
+ */
+bool lapic_send_init(uint8_t apic_id);
+bool lapic_send_startup(uint8_t apic_id, uint8_t page);
+
+/* Raise interrupt vector on another CPU; false if it was not accepted */
+bool lapic_send_vector(uint8_t apic_id, uint8_t vector);
+
+/* Acknowledge the interrupt being handled on the calling CPU */
+void lapic_eoi(void);
+
+#endif /* ARCH_I386_LAPIC_H */
@@ -0,0 +1,84 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include "paging.h"
+#include "mmu.h"
+#include "msr.h"
+#include <kernel/debug.h>
+
+/* PAT memory type encodings */
+#define PAT_TYPE_UC       0x00
+#define PAT_TYPE_WC       0x01
+#define PAT_TYPE_WT       0x04
+#define PAT_TYPE_WP       0x05
+#define PAT_TYPE_WB       0x06
+#define PAT_TYPE_UC_MINUS 0x07
+
+#define PAT_ENTRY(index, type) ((uint64_t)(type) << ((index) * 8))
+
+/*
+ * PAT layout used by the kernel. Entries 0, 2 and 3 keep their power-on
+ * types, entry 1 (PWT only) becomes WC instead of WT. Entries 4-7 are only
+ * reachable with the PTE PAT bit, which the kernel never sets.
+ */
+#define KERNEL_PAT (PAT_ENTRY(0, PAT_TYPE_WB) | PAT_ENTRY(1, PAT_TYPE_WC) | \
+                    PAT_ENTRY(2, PAT_TYPE_UC_MINUS) | PAT_ENTRY(3, PAT_TYPE_UC) | \
+                    PAT_ENTRY(4, PAT_TYPE_WB) | PAT_ENTRY(5, PAT_TYPE_WT) | \
+                    PAT_ENTRY(6, PAT_TYPE_UC_MINUS) | PAT_ENTRY(7, PAT_TYPE_UC))
+
+/* Whether KERNEL_PAT is loaded; without it WC mappings fall back to UC- */
+static bool pat_enabled = false;
+
+/**
+ * Program the page attribute table so PWT selects write-combining
+ */
+void init_pat(void) {
+    if (!cpu_has_feature_edx(CPUID_FEAT_EDX_MSR) || !cpu_has_feature_edx(CPUID_FEAT_EDX_PAT)) {
+        debug_warning("CPU has no PAT, write-combining mappings will be uncached");
+        return;
+    }
+
+    uint64_t old_pat = rdmsr(MSR_IA32_PAT);
+
+    // Nothing is mapped with PWT alone yet, so no entry changes meaning under
+    // a live mapping; still flush caches and TLB as the SDM asks.
+    mmu_wbinvd();
+    wrmsr(MSR_IA32_PAT, KERNEL_PAT);
+    mmu_write_cr3(mmu_read_cr3());
+    mmu_wbinvd();
+
+    pat_enabled = true;
+    debug_info("PAT programmed: 0x%016llx (was 0x%016llx)", KERNEL_PAT, old_pat);
+}
+
+/**
+ * Load the kernel's PAT on another CPU, which must agree with the first
+ */
+void init_pat_ap(void) {
+    if (!pat_enabled) {
+        return;
+    }
+
+    mmu_wbinvd();
+    wrmsr(MSR_IA32_PAT, KERNEL_PAT);
+    mmu_write_cr3(mmu_read_cr3());
+    mmu_wbinvd();
+}
+
+/**
+ * Get the PTE bits selecting a memory type
+ * @param cache Requested memory type
+ * @return PWT/PCD bits to OR into a page table entry
+ */
+uint32_t page_cache_flags(enum page_cache_type cache) {
+    switch (cache) {
+        case PAGE_CACHE_WC:
+            return pat_enabled ? PAGE_PWT : PAGE_PCD;
+        case PAGE_CACHE_UC_MINUS:
+            return PAGE_PCD;
+        case PAGE_CACHE_UC:
+            return PAGE_PCD | PAGE_PWT;
+        case PAGE_CACHE_WB:
+        default:
+            return 0;
+    }
+}
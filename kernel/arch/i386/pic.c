@@ -0,0 +1,83 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <pic.h>
+#include "io.h"
+
+/* 8259A ports */
+#define PIC1_COMMAND 0x20
+#define PIC1_DATA    0x21
+#define PIC2_COMMAND 0xA0
+#define PIC2_DATA    0xA1
+
+/* Initialization and operation command words */
+#define ICW1_INIT    0x10
+#define ICW1_ICW4    0x01
+#define ICW4_8086    0x01
+#define OCW2_EOI     0x20
+#define OCW3_READ_ISR 0x0B
+
+/* Line on the master the slave PIC is cascaded through */
+#define PIC_CASCADE_IRQ 2
+
+/* Write to an unused port to give the PIC time to settle */
+static inline void io_wait(void) {
+    outb(0x80, 0);
+}
+
+void pic_init(uint8_t vector_base) {
+    outb(PIC1_COMMAND, ICW1_INIT | ICW1_ICW4);
+    io_wait();
+    outb(PIC2_COMMAND, ICW1_INIT | ICW1_ICW4);
+    io_wait();
+    outb(PIC1_DATA, vector_base);
+    io_wait();
+    outb(PIC2_DATA, vector_base + 8);
+    io_wait();
+    outb(PIC1_DATA, 1 << PIC_CASCADE_IRQ);
+    io_wait();
+    outb(PIC2_DATA, PIC_CASCADE_IRQ);
+    io_wait();
+    outb(PIC1_DATA, ICW4_8086);
+    io_wait();
+    outb(PIC2_DATA, ICW4_8086);
+    io_wait();
+
+    // Everything masked except the cascade line, drivers unmask what they use
+    outb(PIC1_DATA, (uint8_t)~(1 << PIC_CASCADE_IRQ));
+    outb(PIC2_DATA, 0xFF);
+}
+
+void pic_mask(uint8_t irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) | (1 << (irq & 7)));
+}
+
+void pic_unmask(uint8_t irq) {
+    uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+    outb(port, inb(port) & ~(1 << (irq & 7)));
+}
+
+void pic_send_eoi(uint8_t irq) {
+    if (irq >= 8) {
+        outb(PIC2_COMMAND, OCW2_EOI);
+    }
+    outb(PIC1_COMMAND, OCW2_EOI);
+}
+
+bool pic_is_spurious(uint8_t irq) {
+    if (irq != 7 && irq != 15) {
+        return false;
+    }
+
+    uint16_t command = irq == 7 ? PIC1_COMMAND : PIC2_COMMAND;
+    outb(command, OCW3_READ_ISR);
+    if (inb(command) & 0x80) {
+        return false;
+    }
+
+    // The master did see a real request on the cascade line
+    if (irq == 15) {
+        outb(PIC1_COMMAND, OCW2_EOI);
+    }
+    return true;
+}
@@ -0,0 +1,87 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <interrupts.h>
+#include "io.h"
+#include "timer.h"
+
+/* 8253/8254 programmable interval timer */
+#define PIT_CHANNEL0     0x40
+#define PIT_CHANNEL2     0x42
+#define PIT_COMMAND      0x43
+
+/* Keyboard controller port B: bit 0 gates channel 2, bit 1 drives the speaker */
+#define PIT_PORT_B       0x61
+#define PORT_B_GATE2     0x01
+#define PORT_B_SPEAKER   0x02
+
+/* Command bytes */
+#define PIT_CMD_CH0_ONESHOT 0x30 /* Channel 0, low then high byte, mode 0, binary */
+#define PIT_CMD_CH2_RATE    0xB4 /* Channel 2, low then high byte, mode 2, binary */
+#define PIT_CMD_CH2_LATCH   0x80 /* Channel 2, latch count */
+
+#define PIT_IRQ 0
+
+/*
+ * Channel 2 runs as a free-running 16-bit down counter with the speaker
+ * disconnected, leaving channel 0 free to generate interrupts.
+ */
+static uint64_t pit_read(void) {
+    outb(PIT_COMMAND, PIT_CMD_CH2_LATCH);
+    uint8_t low = inb(PIT_CHANNEL2);
+    uint8_t high = inb(PIT_CHANNEL2);
+
+    // Count down from 65536, so negate to get an increasing count
+    return (uint16_t)(0 - (low | (high << 8)));
+}
+
+static struct clocksource pit_clocksource = {
+    .name = "pit",
+    .rating = 110,
+    .read = pit_read,
+    .mask = 0xFFFF,
+    .freq_hz = PIT_FREQUENCY,
+};
+
+struct clocksource *pit_clocksource_init(void) {
+    uint8_t port_b = inb(PIT_PORT_B);
+    outb(PIT_PORT_B, (port_b & ~PORT_B_SPEAKER) | PORT_B_GATE2);
+
+    // A reload value of 0 means 65536 ticks per wrap
+    outb(PIT_COMMAND, PIT_CMD_CH2_RATE);
+    outb(PIT_CHANNEL2, 0);
+    outb(PIT_CHANNEL2, 0);
+
+    return &pit_clocksource;
+}
+
+/*
+ * Channel 0 in mode 0 counts down once and raises IRQ 0 at zero, then stays
+ * quiet until it is given a new count.
+ */
+static void pit_set_next_event(uint32_t ticks) {
+    outb(PIT_COMMAND, PIT_CMD_CH0_ONESHOT);
+    outb(PIT_CHANNEL0, ticks & 0xFF);
+    outb(PIT_CHANNEL0, (ticks >> 8) & 0xFF);
+}
+
+static void pit_irq(struct interrupt_frame *frame) {
+    (void)frame;
+    clockevent_interrupt();
+}
+
+static struct clock_event_device pit_clockevent = {
+    .name = "pit",
+    .freq_hz = PIT_FREQUENCY,
+    .min_delta_ticks = 2,
+    .max_delta_ticks = 0xFFFF,
+    .set_next_event = pit_set_next_event,
+};
+
+struct clock_event_device *pit_clockevent_init(void) {
+    // Stop the BIOS's periodic 18.2 Hz tick: in mode 0 the counter does not
+    // start until a count is written
+    outb(PIT_COMMAND, PIT_CMD_CH0_ONESHOT);
+
+    irq_register_handler(PIT_IRQ, pit_irq);
+    return &pit_clockevent;
+}
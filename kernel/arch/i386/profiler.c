@@ -0,0 +1,165 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <interrupts.h>
+#include <kernel/backtrace.h>
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/math64.h>
+#include <kernel/profiler.h>
+#include "cpu.h"
+#include "serial.h"
+#include "timer.h"
+
+/* Length of the busy loop profiler_measure_overhead() times */
+#define OVERHEAD_LOOP_NS 50000000ULL
+
+struct profiler_sample {
+    uint32_t eip;
+    uint32_t depth;
+    uint32_t callers[PROFILER_MAX_DEPTH];
+};
+
+/* Preallocated so the interrupt handler never has to allocate */
+static struct profiler_sample samples[PROFILER_MAX_SAMPLES];
+static volatile uint32_t sample_count;
+static volatile uint32_t dropped;
+static volatile uint64_t handler_cycles;
+static uint32_t sample_hz;
+static bool sample_backtrace;
+static volatile bool running;
+
+static void profiler_tick(struct interrupt_frame *frame) {
+    uint64_t start = rdtsc();
+
+    rtc_periodic_ack();
+
+    uint32_t n = sample_count;
+    if (n < PROFILER_MAX_SAMPLES) {
+        struct profiler_sample *sample = &samples[n];
+        sample->eip = frame->eip;
+        sample->depth = sample_backtrace ? backtrace_walk(frame->ebp, sample->callers, PROFILER_MAX_DEPTH) : 0;
+        sample_count = n + 1;
+    } else {
+        dropped++;
+    }
+
+    handler_cycles += rdtsc() - start;
+}
+
+/**
+ * Start sampling the interrupted code
+ * @param hz Samples per second, rounded up to a power of two
+ * @param backtrace Also record return addresses from the frame pointer chain
+ * @return false if the profiler is already running
+ */
+bool profiler_start(uint32_t hz, bool backtrace) {
+    if (running) {
+        return false;
+    }
+
+    sample_count = 0;
+    dropped = 0;
+    handler_cycles = 0;
+    sample_backtrace = backtrace;
+    running = true;
+    sample_hz = rtc_periodic_start(hz, profiler_tick);
+    return true;
+}
+
+/**
+ * Stop sampling, keeping the samples taken so far
+ */
+void profiler_stop(void) {
+    if (running) {
+        rtc_periodic_stop();
+        running = false;
+    }
+}
+
+/**
+ * Write every sample to COM1, one "profile-sample" line each with the
+ * interrupted EIP first and the return addresses after it, innermost first
+ */
+void profiler_dump(void) {
+    char line[32 + 9 * (PROFILER_MAX_DEPTH + 1)];
+    uint32_t count = sample_count;
+    uint64_t cycles = handler_cycles;
+
+    int length = snprintf(line, sizeof(line), "profile-begin hz=%u samples=%u dropped=%u backtrace=%u\n",
+                          sample_hz, count, dropped, sample_backtrace ? 1u : 0u);
+    serial_com1_write(line, (size_t)length);
+
+    for (uint32_t i = 0; i < count; i++) {
+        const struct profiler_sample *sample = &samples[i];
+        length = snprintf(line, sizeof(line), "profile-sample %08x", sample->eip);
+        for (uint32_t d = 0; d < sample->depth; d++) {
+            length += snprintf(line + length, sizeof(line) - length, " %08x", sample->callers[d]);
+        }
+        line[length++] = '\n';
+        serial_com1_write(line, (size_t)length);
+    }
+
+    uint64_t per_sample = count ? div_u64_u32(cycles, count) : 0;
+    length = snprintf(line, sizeof(line), "profile-end handler_cycles=%llu\n", per_sample);
+    serial_com1_write(line, (size_t)length);
+
+    debug_info("profiler: %u samples at %u Hz, %u dropped, %llu cycles per sample",
+               count, sample_hz, dropped, per_sample);
+}
+
+static uint64_t busy_loop(uint32_t iterations) {
+    volatile uint32_t sink = 0;
+    uint64_t start = rdtsc();
+
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink += i;
+    }
+    return rdtsc() - start;
+}
+
+/**
+ * Measure what sampling costs the code being profiled
+ * @param hz Sampling rate to measure
+ * @param backtrace Whether backtraces are recorded
+ * @param result Filled in with the measurement
+ */
+void profiler_measure_overhead(uint32_t hz, bool backtrace, struct profiler_overhead *result) {
+    const struct clocksource *tsc = clocksource_get("tsc");
+    uint32_t iterations = 1u << 16;
+
+    // Grow the loop until it runs long enough to see many samples
+    while (iterations < (1u << 30)) {
+        uint64_t cycles = busy_loop(iterations);
+        if (!tsc || clocksource_cycles_to_ns(tsc, cycles) >= OVERHEAD_LOOP_NS) {
+            break;
+        }
+        iterations <<= 1;
+    }
+
+    uint64_t off = busy_loop(iterations);
+    profiler_start(hz, backtrace);
+    uint64_t on = busy_loop(iterations);
+    profiler_stop();
+
+    result->hz = sample_hz;
+    result->samples = sample_count;
+    result->cycles_per_sample = sample_count ? div_u64_u32(handler_cycles, sample_count) : 0;
+    result->slowdown_permille = 0;
+    if (on > off) {
+        uint64_t delta = on - off;
+        uint64_t base = off;
+        // Scale delta first, so the product cannot overflow either
+        while (delta > UINT64_MAX / 1000) {
+            delta >>= 1;
+            base >>= 1;
+        }
+        result->slowdown_permille = (uint32_t)div_u64_u64_approx(delta * 1000, base);
+    }
+
+    debug_info("profiler: overhead at %u Hz%s: %u samples, %llu cycles each in the handler",
+               result->hz, backtrace ? " with backtraces" : "", result->samples,
+               result->cycles_per_sample);
+    debug_info("  busy loop %llu cycles unprofiled, %llu profiled, %u.%u%% slower",
+               off, on, result->slowdown_permille / 10, result->slowdown_permille % 10);
+}
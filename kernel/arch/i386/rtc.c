@@ -0,0 +1,65 @@
+#include <stdint.h>
+#include <interrupts.h>
+#include <pic.h>
+#include "io.h"
+#include "timer.h"
+
+/* CMOS/RTC ports; bit 7 of the index port masks NMIs while it is set */
+#define CMOS_INDEX       0x70
+#define CMOS_DATA        0x71
+#define CMOS_NMI_DISABLE 0x80
+
+#define RTC_REG_A 0x0A   /* Divider and rate select */
+#define RTC_REG_B 0x0B   /* Interrupt enables */
+#define RTC_REG_C 0x0C   /* Interrupt flags, cleared by reading */
+
+#define RTC_A_RATE_MASK 0x0F
+#define RTC_B_PIE       0x40
+
+/* Rate select values; rate r fires at 32768 >> (r - 1) Hz */
+#define RTC_RATE_FASTEST 3   /* 8192 Hz */
+#define RTC_RATE_SLOWEST 15  /* 2 Hz */
+
+#define RTC_IRQ 8
+
+static uint8_t cmos_read(uint8_t reg) {
+    outb(CMOS_INDEX, CMOS_NMI_DISABLE | reg);
+    return inb(CMOS_DATA);
+}
+
+static void cmos_write(uint8_t reg, uint8_t value) {
+    outb(CMOS_INDEX, CMOS_NMI_DISABLE | reg);
+    outb(CMOS_DATA, value);
+}
+
+uint32_t rtc_periodic_start(uint32_t hz, irq_handler_t handler) {
+    // Slowest rate that is still at least hz, within what the RTC can do
+    uint8_t rate = RTC_RATE_SLOWEST;
+    while (rate > RTC_RATE_FASTEST && (RTC_PERIODIC_BASE_HZ >> (rate - 1)) < hz) {
+        rate--;
+    }
+
+    uint32_t flags = irq_save();
+    cmos_write(RTC_REG_A, (cmos_read(RTC_REG_A) & ~RTC_A_RATE_MASK) | rate);
+    cmos_write(RTC_REG_B, cmos_read(RTC_REG_B) | RTC_B_PIE);
+    rtc_periodic_ack();
+    irq_register_handler(RTC_IRQ, handler);
+    outb(CMOS_INDEX, 0);    // Unmask NMIs again
+    irq_restore(flags);
+
+    return RTC_PERIODIC_BASE_HZ >> (rate - 1);
+}
+
+void rtc_periodic_stop(void) {
+    uint32_t flags = irq_save();
+    pic_mask(RTC_IRQ);
+    cmos_write(RTC_REG_B, cmos_read(RTC_REG_B) & ~RTC_B_PIE);
+    rtc_periodic_ack();
+    outb(CMOS_INDEX, 0);
+    irq_restore(flags);
+}
+
+void rtc_periodic_ack(void) {
+    // The RTC raises no further interrupts until register C has been read
+    cmos_read(RTC_REG_C);
+}
@@ -1,9 +1,18 @@
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <string.h>
+#include <interrupts.h>
+#include <pic.h>
+#include <kernel/clocksource.h>
+#include <kernel/kstat.h>
+#include <kernel/wait.h>
+#include "io.h"
 #include "serial.h"
 
 /* I/O port addresses for COM1 */
 #define COM1_PORT 0x3F8
+#define COM1_IRQ  4
 
 /* COM port registers (offset from base port) */
 #define REG_DATA        0 /* Data register (R/W) */
@@ -15,19 +24,42 @@
 #define REG_MODEM_STATUS 6 /* Modem status register (R) */
 #define REG_SCRATCH     7 /* Scratch register (R/W) */
 
+/* Interrupt enable register bits */
+#define IER_RX_AVAILABLE 0x01 /* Received data, or the FIFO timed out */
+
+/* Interrupt identification register bits */
+#define IIR_FIFO_ENABLED 0xC0 /* Both set when a working 16-byte FIFO is on */
+
+/* Bytes that fit in the transmit FIFO of a 16550A */
+#define UART_FIFO_SIZE 16
+
 /* Line status register bits */
 #define LSR_DATA_READY  0x01 /* Data ready */
 #define LSR_TX_EMPTY    0x20 /* Transmitter holding register empty */
 
-/* CPU I/O functions */
-static inline void outb(uint16_t port, uint8_t value) {
-    __asm__ volatile ("outb %0, %1" : : "a"(value), "Nd"(port));
-}
+/* Bytes that can be written per transmitter-empty poll, per COM port */
+static uint8_t tx_burst[4] = { 1, 1, 1, 1 };
+
+KSTAT_DEFINE(serial, tx_bytes);
+KSTAT_DEFINE(serial, rx_bytes);
+KSTAT_DEFINE(serial, lsr_spins);    /* Line status reads that found the port busy */
+KSTAT_DEFINE(serial, rx_irqs);
+KSTAT_DEFINE(serial, rx_dropped);   /* Received with the buffer full */
 
-static inline uint8_t inb(uint16_t port) {
-    uint8_t value;
-    __asm__ volatile ("inb %1, %0" : "=a"(value) : "Nd"(port));
-    return value;
+/* COM1 input taken by the receive interrupt, oldest at rx_head */
+static uint8_t rx_buffer[SERIAL_RX_BUFFER_SIZE];
+static uint32_t rx_head;
+static uint32_t rx_tail;
+static bool rx_interrupts;
+static struct wait_queue rx_wait = WAIT_QUEUE_INIT;
+
+static inline unsigned port_slot(uint16_t port) {
+    switch (port) {
+        case SERIAL_COM2_PORT: return 1;
+        case SERIAL_COM3_PORT: return 2;
+        case SERIAL_COM4_PORT: return 3;
+        default:               return 0;
+    }
 }
 
 bool serial_init(uint16_t port) {
@@ -44,6 +76,8 @@ bool serial_init(uint16_t port) {
 
     /* Enable FIFO, clear them, with 14-byte threshold */
     outb(port + REG_INT_ID, 0xC7);
+    tx_burst[port_slot(port)] = (inb(port + REG_INT_ID) & IIR_FIFO_ENABLED) == IIR_FIFO_ENABLED
+        ? UART_FIFO_SIZE : 1;
 
     /* Enable IRQs, set RTS/DSR, DISABLE echo */
     outb(port + REG_MODEM_CTRL, 0x0B);
@@ -77,11 +111,12 @@ bool serial_is_transmit_ready(uint16_t port) {
 void serial_write_byte(uint16_t port, uint8_t byte) {
     /* Wait until transmit is ready */
     while (!serial_is_transmit_ready(port)) {
-        /* Busy wait */
+        kstat_inc(serial, lsr_spins);
     }
 
     /* Send the byte */
     outb(port + REG_DATA, byte);
+    kstat_inc(serial, tx_bytes);
 }
 
 /* Send a byte to COM1 */
@@ -89,11 +124,36 @@ void serial_com1_write_byte(uint8_t byte) {
     serial_write_byte(COM1_PORT, byte);
 }
 
+/*
+ * Send a buffer to the specified serial port. Once the transmitter reports
+ * empty, a whole FIFO's worth of bytes is written before polling again.
+ */
+void serial_write(uint16_t port, const char* data, size_t length) {
+    const size_t burst = tx_burst[port_slot(port)];
+
+    kstat_add(serial, tx_bytes, length);
+    while (length > 0) {
+        while (!serial_is_transmit_ready(port)) {
+            kstat_inc(serial, lsr_spins);
+        }
+
+        size_t count = length < burst ? length : burst;
+        for (size_t i = 0; i < count; i++) {
+            outb(port + REG_DATA, (uint8_t)data[i]);
+        }
+        data += count;
+        length -= count;
+    }
+}
+
+/* Send a buffer to COM1 */
+void serial_com1_write(const char* data, size_t length) {
+    serial_write(COM1_PORT, data, length);
+}
+
 /* Write a string to COM1 */
 void serial_com1_write_string(const char* str) {
-    while (*str != '\0') {
-        serial_com1_write_byte(*str++);
-    }
+    serial_com1_write(str, strlen(str));
 }
 
 /* Check if receive contains data */
@@ -101,15 +161,109 @@ bool serial_is_received(uint16_t port) {
     return (inb(port + REG_LINE_STATUS) & LSR_DATA_READY) != 0;
 }
 
+/* Move everything the UART has received into the buffer and wake readers */
+static void com1_interrupt(struct interrupt_frame* frame) {
+    (void)frame;
+    kstat_inc(serial, rx_irqs);
+    while (serial_is_received(COM1_PORT)) {
+        uint8_t byte = inb(COM1_PORT + REG_DATA);
+        if (rx_tail - rx_head < SERIAL_RX_BUFFER_SIZE) {
+            rx_buffer[rx_tail++ % SERIAL_RX_BUFFER_SIZE] = byte;
+        } else {
+            kstat_inc(serial, rx_dropped);
+        }
+    }
+    wake_up_all(&rx_wait);
+}
+
+void serial_set_rx_interrupts(bool enable) {
+    uint32_t flags = irq_save();
+    rx_interrupts = enable;
+    if (enable) {
+        irq_register_handler(COM1_IRQ, com1_interrupt);
+        outb(COM1_PORT + REG_INT_ENABLE, IER_RX_AVAILABLE);
+    } else {
+        outb(COM1_PORT + REG_INT_ENABLE, 0x00);
+        pic_mask(COM1_IRQ);
+    }
+    irq_restore(flags);
+}
+
+/* Take a buffered byte; interrupts are disabled */
+static bool rx_take(uint8_t* byte) {
+    if (rx_head == rx_tail) {
+        return false;
+    }
+    *byte = rx_buffer[rx_head++ % SERIAL_RX_BUFFER_SIZE];
+    return true;
+}
+
+/* Deadline of a read that waits for as long as it takes */
+#define READ_FOREVER UINT64_MAX
+
+static inline bool past(uint64_t deadline_ns) {
+    return deadline_ns != READ_FOREVER && ktime_get_ns() >= deadline_ns;
+}
+
+/*
+ * Read a byte from the specified serial port, waiting until deadline_ns.
+ * A thread reading COM1 with the receive interrupt on sleeps; anything
+ * else, such as a read with interrupts disabled, polls.
+ */
+static bool read_byte_until(uint16_t port, uint8_t* byte, uint64_t deadline_ns) {
+    bool received = false;
+
+    if (port == COM1_PORT && rx_interrupts && interrupts_enabled()) {
+        uint32_t flags = irq_save();
+        while (!(received = rx_take(byte))) {
+            if (deadline_ns == READ_FOREVER) {
+                wait_queue_sleep(&rx_wait);
+                continue;
+            }
+            uint64_t now = ktime_get_ns();
+            if (now >= deadline_ns) {
+                break;
+            }
+            wait_queue_sleep_timeout(&rx_wait, deadline_ns - now);
+        }
+        irq_restore(flags);
+    } else {
+        // Bytes the interrupt already took come first
+        if (port == COM1_PORT) {
+            uint32_t flags = irq_save();
+            received = rx_take(byte);
+            irq_restore(flags);
+        }
+        while (!received && !serial_is_received(port)) {
+            kstat_inc(serial, lsr_spins);
+            if (past(deadline_ns)) {
+                return false;
+            }
+        }
+        if (!received) {
+            *byte = inb(port + REG_DATA);
+            received = true;
+        }
+    }
+
+    if (received) {
+        kstat_inc(serial, rx_bytes);
+    }
+    return received;
+}
+
 /* Read a byte from the specified serial port */
 uint8_t serial_read_byte(uint16_t port) {
-    /* Wait until data is available */
-    while (!serial_is_received(port)) {
-        /* Busy wait */
-    }
+    uint8_t byte = 0;
+    read_byte_until(port, &byte, READ_FOREVER);
+    return byte;
+}
 
-    /* Read the byte */
-    return inb(port + REG_DATA);
+/* Read a byte from the specified serial port, giving up after timeout_ns */
+bool serial_read_byte_timeout(uint16_t port, uint8_t* byte, uint64_t timeout_ns) {
+    uint64_t now = ktime_get_ns();
+    uint64_t deadline_ns = timeout_ns < READ_FOREVER - now ? now + timeout_ns : READ_FOREVER;
+    return read_byte_until(port, byte, deadline_ns);
 }
 
 /* Read a byte from COM1 */
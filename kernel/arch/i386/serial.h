@@ -1,6 +1,7 @@
 #ifndef ARCH_I386_SERIAL_H
 #define ARCH_I386_SERIAL_H
 
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
@@ -10,6 +11,9 @@
 #define SERIAL_COM3_PORT 0x3E8
 #define SERIAL_COM4_PORT 0x2E8
 
+/* COM1 input the receive interrupt holds for readers, a power of two */
+#define SERIAL_RX_BUFFER_SIZE 256
+
 /* Initialize a serial port with specific settings */
 bool serial_init(uint16_t port);
 
@@ -25,15 +29,30 @@ void serial_write_byte(uint16_t port, uint8_t byte);
 /* Write a byte to COM1 */
 void serial_com1_write_byte(uint8_t byte);
 
+/* Write a buffer to a serial port, filling the transmit FIFO per poll */
+void serial_write(uint16_t port, const char* data, size_t length);
+
+/* Write a buffer to COM1 */
+void serial_com1_write(const char* data, size_t length);
+
 /* Write a string to COM1 */
 void serial_com1_write_string(const char* str);
 
 /* Check if receive buffer contains data */
 bool serial_is_received(uint16_t port);
 
-/* Read a byte from a serial port */
+/*
+ * Take COM1 input on IRQ 4 into a buffer, so that threads reading it sleep
+ * instead of polling the line status register. Needs the scheduler.
+ */
+void serial_set_rx_interrupts(bool enable);
+
+/* Read a byte from a serial port, waiting for as long as it takes */
 uint8_t serial_read_byte(uint16_t port);
 
+/* Read a byte from a serial port; false if none came within timeout_ns */
+bool serial_read_byte_timeout(uint16_t port, uint8_t* byte, uint64_t timeout_ns);
+
 /* Read a byte from COM1 */
 uint8_t serial_com1_read_byte(void);
 
@@ -0,0 +1,308 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <gdt.h>
+#include <idt.h>
+#include <interrupts.h>
+#include <mmu.h>
+#include <paging.h>
+#include <kernel/acpi.h>
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/idle.h>
+#include <kernel/kstat.h>
+#include <kernel/math64.h>
+#include <kernel/rcu.h>
+#include <kernel/sched.h>
+#include <kernel/smp.h>
+#include "cpu.h"
+#include "lapic.h"
+
+/* Where the trampoline is copied; must match trampoline.S */
+#define TRAMPOLINE_ADDR 0x8000
+
+/* Waits of the INIT-SIPI-SIPI sequence */
+#define SMP_INIT_DELAY_NS    10000000ULL
+#define SMP_SIPI_DELAY_NS    200000ULL
+#define SMP_ONLINE_TIMEOUT_NS 100000000ULL
+
+/* Filled in before each STARTUP IPI; layout must match trampoline.S */
+struct trampoline_params {
+    uint32_t cr3;
+    uint32_t stack;
+    uint32_t entry;
+    uint32_t cpu;
+};
+
+extern const char trampoline_start[];
+extern const char trampoline_end[];
+extern const char trampoline_params[];
+
+/* setup_gdt() points the boot processor's GS at cpus[0] before smp_init() */
+static struct cpu cpus[SMP_MAX_CPUS] = {
+    [0] = { .self = &cpus[0], .online = true },
+};
+static uint32_t cpu_count = 1;
+static uint32_t online_count = 1;
+
+KSTAT_DEFINE(smp, ipis_saved);
+
+/* Busy-wait, for the IPI sequence before the scheduler can sleep */
+static void delay_ns(uint64_t ns) {
+    uint64_t end = ktime_get_ns() + ns;
+    while (ktime_get_ns() < end) {
+        __asm__ volatile("pause");
+    }
+}
+
+/**
+ * Record the enabled processors listed in the MADT
+ * @param lapic_addr Set to the physical address of the local APICs
+ * @return Number of processors found, 0 without a MADT
+ */
+static uint32_t parse_madt(uint32_t *lapic_addr) {
+    const struct acpi_madt *madt = (const struct acpi_madt*)acpi_find_table("APIC");
+    if (!madt) {
+        return 0;
+    }
+
+    *lapic_addr = madt->local_apic_address;
+
+    uint32_t count = 0;
+    const uint8_t *entry = (const uint8_t*)(madt + 1);
+    const uint8_t *end = (const uint8_t*)madt + madt->header.length;
+    while (entry + sizeof(struct acpi_madt_entry) <= end) {
+        const struct acpi_madt_entry *header = (const struct acpi_madt_entry*)entry;
+        if (header->length < sizeof(*header) || entry + header->length > end) {
+            break;
+        }
+
+        if (header->type == ACPI_MADT_LOCAL_APIC) {
+            const struct acpi_madt_local_apic *lapic = (const struct acpi_madt_local_apic*)entry;
+            if (!(lapic->flags & ACPI_MADT_LAPIC_ENABLED)) {
+                // Online-capable processors are for hotplug, which we lack
+            } else if (count < SMP_MAX_CPUS) {
+                cpus[count].self = &cpus[count];
+                cpus[count].index = count;
+                cpus[count].apic_id = lapic->apic_id;
+                count++;
+            } else {
+                debug_warning("SMP: ignoring CPU with APIC ID %u, only %u supported",
+                              (unsigned)lapic->apic_id, SMP_MAX_CPUS);
+            }
+        } else if (header->type == ACPI_MADT_LOCAL_APIC_OVERRIDE) {
+            const struct acpi_madt_local_apic_override *override =
+                (const struct acpi_madt_local_apic_override*)entry;
+            if (override->address < 0x100000000ULL) {
+                *lapic_addr = (uint32_t)override->address;
+            }
+        }
+
+        entry += header->length;
+    }
+    return count;
+}
+
+/**
+ * First C code of an application processor, on its own stack with paging on
+ * @param cpu This CPU
+ */
+__attribute__((noreturn))
+static void ap_entry(struct cpu *cpu) {
+    gdt_init_table(cpu->gdt, cpu, sizeof(*cpu));
+    gdt_load(cpu->gdt, &cpu->gdt_ptr);
+    idt_load();
+    init_pat_ap();
+    lapic_enable();
+
+    cpu->online_tsc = rdtsc();
+    __atomic_store_n(&cpu->online, true, __ATOMIC_RELEASE);
+
+    // Nothing schedules here yet. Only the IPI of smp_call() reaches us:
+    // the PICs deliver to the bootstrap processor alone.
+    for (;;) {
+        interrupts_disable();
+        void (*fn)(void*) = __atomic_load_n(&cpu->call_fn, __ATOMIC_ACQUIRE);
+        if (fn) {
+            rcu_idle_exit();
+            fn(cpu->call_arg);
+            __atomic_store_n(&cpu->call_fn, NULL, __ATOMIC_RELEASE);
+            continue;
+        }
+        // This loop is the CPU's idle task. With MWAIT, smp_call() only
+        // has to store call_fn to wake us.
+        rcu_idle_enter();
+        cpu_idle(&cpu->call_fn);
+    }
+}
+
+/**
+ * Start one application processor and wait for it to reach ap_entry()
+ * @param cpu CPU to start
+ * @param params Parameter block of the copied trampoline
+ * @return true if it came online
+ */
+static bool start_ap(struct cpu *cpu, volatile struct trampoline_params *params) {
+    uint32_t stack = kstack_alloc();
+    if (!stack) {
+        debug_error("SMP: no stack for CPU %u", cpu->index);
+        return false;
+    }
+    cpu->stack_base = stack;
+    cpu->stack_top = stack + KTHREAD_STACK_SIZE;
+
+    params->cr3 = mmu_read_cr3();
+    params->stack = cpu->stack_top;
+    params->entry = (uint32_t)ap_entry;
+    params->cpu = (uint32_t)cpu;
+
+    uint64_t start = ktime_get_ns();
+    if (!lapic_send_init(cpu->apic_id)) {
+        return false;
+    }
+    delay_ns(SMP_INIT_DELAY_NS);
+
+    // A second STARTUP is only needed if the first one was missed
+    for (int attempt = 0; attempt < 2 && !__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE); attempt++) {
+        if (!lapic_send_startup(cpu->apic_id, TRAMPOLINE_ADDR >> 12)) {
+            return false;
+        }
+        delay_ns(SMP_SIPI_DELAY_NS);
+    }
+
+    while (!__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE)) {
+        if (ktime_get_ns() - start > SMP_ONLINE_TIMEOUT_NS) {
+            debug_error("SMP: CPU %u (APIC ID %u) did not start", cpu->index,
+                        (unsigned)cpu->apic_id);
+            kstack_free(stack);
+            return false;
+        }
+        __asm__ volatile("pause");
+    }
+
+    debug_info("SMP: CPU %u (APIC ID %u) online after %llu us", cpu->index,
+               (unsigned)cpu->apic_id, div_u64_u32(ktime_get_ns() - start, 1000));
+    return true;
+}
+
+/**
+ * Bring up every application processor the firmware lists
+ */
+void smp_init(void) {
+    extern char boot_stack_bottom[];
+    extern char boot_stack[];
+    uint32_t lapic_addr = 0;
+
+    // Until told otherwise there is just us
+    cpus[0].stack_base = (uint32_t)boot_stack_bottom + KERNEL_VIRTUAL_BASE;
+    cpus[0].stack_top = (uint32_t)boot_stack + KERNEL_VIRTUAL_BASE;
+    cpus[0].online_tsc = rdtsc();
+
+    uint32_t found = parse_madt(&lapic_addr);
+    if (found == 0) {
+        debug_warning("SMP: no MADT, running on the bootstrap processor only");
+        return;
+    }
+    if (!lapic_init(lapic_addr)) {
+        return;
+    }
+
+    // Put the bootstrap processor first, wherever the MADT lists it
+    uint8_t bsp_id = lapic_id();
+    for (uint32_t i = 0; i < found; i++) {
+        if (cpus[i].apic_id == bsp_id) {
+            cpus[i].apic_id = cpus[0].apic_id;
+            cpus[0].apic_id = bsp_id;
+            break;
+        }
+    }
+    cpu_count = found;
+
+    size_t size = (size_t)(trampoline_end - trampoline_start);
+    if (size > PAGE_SIZE) {
+        debug_error("SMP: trampoline is %u bytes, more than a page", (unsigned)size);
+        return;
+    }
+    uint8_t *trampoline = P2V((void*)TRAMPOLINE_ADDR);
+    memcpy(trampoline, trampoline_start, size);
+    volatile struct trampoline_params *params =
+        (volatile struct trampoline_params*)(trampoline + (trampoline_params - trampoline_start));
+
+    for (uint32_t i = 1; i < cpu_count; i++) {
+        if (start_ap(&cpus[i], params)) {
+            online_count++;
+        }
+    }
+
+    debug_info("SMP: %u of %u CPUs online", online_count, cpu_count);
+}
+
+uint32_t smp_cpu_count(void) {
+    return cpu_count;
+}
+
+uint32_t smp_online_count(void) {
+    return online_count;
+}
+
+struct cpu *smp_cpu(uint32_t index) {
+    return index < cpu_count ? &cpus[index] : NULL;
+}
+
+/**
+ * Hand work to an idle application processor and wake it, with an IPI
+ * unless it is in MWAIT watching for the work
+ * @param index CPU to run on, not the bootstrap processor
+ * @param fn Work, run with interrupts disabled
+ * @param arg Passed to fn
+ * @return true if the CPU accepted the work
+ */
+bool smp_call(uint32_t index, void (*fn)(void*), void *arg) {
+    if (index == 0 || index >= cpu_count || !__atomic_load_n(&cpus[index].online, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    struct cpu *cpu = &cpus[index];
+    if (__atomic_load_n(&cpu->call_fn, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+    cpu->call_arg = arg;
+    __atomic_store_n(&cpu->call_fn, fn, __ATOMIC_RELEASE);
+    // Pairs with the fence in cpu_idle(): either it sees call_fn before
+    // waiting or we see it watching, and the store wakes it
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&cpu->idle_watching, __ATOMIC_RELAXED)) {
+        kstat_inc(smp, ipis_saved);
+        return true;
+    }
+    return lapic_send_vector(cpu->apic_id, IDT_LAPIC_CALL);
+}
+
+/**
+ * Spin until a CPU has finished the work of its last smp_call()
+ * @param index CPU passed to smp_call()
+ */
+void smp_call_wait(uint32_t index) {
+    if (index >= cpu_count) {
+        return;
+    }
+    while (__atomic_load_n(&cpus[index].call_fn, __ATOMIC_ACQUIRE)) {
+        __asm__ volatile("pause");
+    }
+}
+
+/**
+ * Print every CPU with its per-CPU counters
+ */
+void smp_dump(void) {
+    debug_info("CPUs (index, APIC ID, state, interrupts, context switches, busy):");
+    for (uint32_t i = 0; i < cpu_count; i++) {
+        const struct cpu *cpu = &cpus[i];
+        uint64_t busy = 0, idle = 0;
+        cpu_times(i, &busy, &idle);
+        debug_info("  cpu%u apic %2u %-7s %10llu %10llu %3u%%", cpu->index, (unsigned)cpu->apic_id,
+                   cpu->online ? "online" : "offline", cpu->irqs, cpu->context_switches,
+                   cpu_busy_percent(busy, idle));
+    }
+}
@@ -0,0 +1,145 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <interrupts.h>
+#include <paging.h>
+#include <kernel/bootprof.h>
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/frame.h>
+#include <kernel/idle.h>
+#include <kernel/kstat.h>
+#include <kernel/smp.h>
+#include <kernel/telemetry.h>
+#include <kernel/timer.h>
+#include "cpu.h"
+
+KSTAT_DECLARE(debug, messages);
+
+/* Below 1 MB, so it is reserved from the frame allocator and always mapped */
+static struct telemetry_header *const page =
+    (struct telemetry_header*)(KERNEL_VIRTUAL_BASE + TELEMETRY_PHYS_ADDR);
+
+static struct timer refresh_timer;
+
+/* Each CPU's busy and idle cycles at the last snapshot, for busy_pct */
+static uint64_t last_busy[SMP_MAX_CPUS];
+static uint64_t last_idle[SMP_MAX_CPUS];
+
+static struct telemetry_entry *entries(void) {
+    return (struct telemetry_entry*)((uint8_t*)page + sizeof(struct telemetry_header));
+}
+
+/**
+ * Append an entry, truncating names that do not fit
+ * @param count Entries written so far, advanced if there was room
+ */
+static void add_entry(uint16_t *count, const char *prefix, const char *name,
+                      uint32_t unit, uint64_t value) {
+    if (*count >= TELEMETRY_MAX_ENTRIES) {
+        return;
+    }
+
+    struct telemetry_entry *entry = &entries()[*count];
+    size_t prefix_length = strlen(prefix);
+    size_t name_length = strlen(name);
+    if (prefix_length + name_length > TELEMETRY_NAME_SIZE) {
+        name_length = TELEMETRY_NAME_SIZE - prefix_length;
+    }
+    memset(entry->name, 0, TELEMETRY_NAME_SIZE);
+    memcpy(entry->name, prefix, prefix_length);
+    memcpy(entry->name + prefix_length, name, name_length);
+    entry->unit = unit;
+    entry->value = value;
+    (*count)++;
+}
+
+/**
+ * Append the busy and idle cycles of every online CPU, and how busy it was
+ * since the last snapshot
+ */
+static void add_cpu_entries(uint16_t *count) {
+    for (uint32_t index = 0; index < smp_cpu_count() && index < SMP_MAX_CPUS; index++) {
+        uint64_t busy, idle;
+        if (!cpu_times(index, &busy, &idle)) {
+            continue;
+        }
+
+        char prefix[8];
+        snprintf(prefix, sizeof(prefix), "cpu%u.", (unsigned)index);
+        add_entry(count, prefix, "busy", TELEMETRY_UNIT_CYCLES, busy);
+        add_entry(count, prefix, "idle", TELEMETRY_UNIT_CYCLES, idle);
+        // Clamping to the online time can move a few cycles between the two
+        uint64_t busy_delta = busy > last_busy[index] ? busy - last_busy[index] : 0;
+        uint64_t idle_delta = idle > last_idle[index] ? idle - last_idle[index] : 0;
+        add_entry(count, prefix, "busy_pct", TELEMETRY_UNIT_PERCENT,
+                  cpu_busy_percent(busy_delta, idle_delta));
+        last_busy[index] = busy;
+        last_idle[index] = idle;
+    }
+}
+
+/**
+ * Write a fresh snapshot into the telemetry page. The sequence number is
+ * odd while the page is being written, so a reader can tell a torn copy.
+ */
+void telemetry_update(void) {
+    struct bootprof_phase phases[BOOTPROF_MAX_PHASES];
+    size_t phase_count = bootprof_get_phases(phases, BOOTPROF_MAX_PHASES);
+    uint16_t count = 0;
+
+    uint32_t flags = irq_save();
+    page->sequence++;
+    __asm__ volatile("" ::: "memory");
+
+    add_entry(&count, "frame.", "total", TELEMETRY_UNIT_FRAMES, FRAME_COUNT);
+    add_entry(&count, "frame.", "used", TELEMETRY_UNIT_FRAMES, frame_used_count());
+    add_cpu_entries(&count);
+    for (size_t i = 0; i < kstat_count(); i++) {
+        const struct kstat *stat = kstat_at(i);
+        add_entry(&count, "", stat->name, TELEMETRY_UNIT_COUNT, kstat_read(stat));
+    }
+    for (size_t i = 0; i < phase_count; i++) {
+        add_entry(&count, "boot.", phases[i].name, TELEMETRY_UNIT_CYCLES, phases[i].cycles);
+    }
+
+    page->entry_count = count;
+    page->updated_tsc = rdtsc();
+    page->uptime_ns = ktime_get_ns();
+    page->log_sequence = kstat_read(&kstat_debug_messages);
+    page->updates++;
+
+    __asm__ volatile("" ::: "memory");
+    page->sequence++;
+    irq_restore(flags);
+}
+
+static void telemetry_refresh(void *data) {
+    (void)data;
+    telemetry_update();
+    timer_add(&refresh_timer, refresh_timer.expires_ns + TELEMETRY_PERIOD_MS * 1000000ULL);
+}
+
+/**
+ * Publish the telemetry page and keep it current. Needs the clocksources,
+ * so it runs after time_init().
+ */
+void telemetry_init(void) {
+    const struct clocksource *tsc = clocksource_get("tsc");
+
+    memset(page, 0, TELEMETRY_SIZE);
+    page->magic = TELEMETRY_MAGIC;
+    page->version = TELEMETRY_VERSION;
+    page->header_size = sizeof(struct telemetry_header);
+    page->entry_size = sizeof(struct telemetry_entry);
+    page->tsc_hz = tsc ? tsc->freq_hz : 0;
+
+    telemetry_update();
+
+    timer_init(&refresh_timer, telemetry_refresh, NULL);
+    timer_add_after(&refresh_timer, TELEMETRY_PERIOD_MS * 1000000ULL);
+
+    debug_info("Telemetry page at physical 0x%x, %u entries, refreshed every %u ms",
+               TELEMETRY_PHYS_ADDR, (unsigned)page->entry_count, TELEMETRY_PERIOD_MS);
+}
@@ -0,0 +1,34 @@
+#ifndef ARCH_I386_TIMER_H
+#define ARCH_I386_TIMER_H
+
+#include <stdint.h>
+#include <interrupts.h>
+#include <kernel/clockevent.h>
+#include <kernel/clocksource.h>
+
+/*
+ * Platform counters. Each probe returns a clocksource ready to register,
+ * or NULL if the hardware is missing.
+ */
+struct clocksource* pit_clocksource_init(void);
+struct clocksource* hpet_clocksource_init(void);
+struct clocksource* acpi_pm_clocksource_init(void);
+
+/* PIT channel 0 in one-shot mode, driving IRQ 0 */
+struct clock_event_device* pit_clockevent_init(void);
+
+/*
+ * RTC periodic interrupt on IRQ 8, independent of the PIT. The rate is
+ * rounded up to a power of two between 2 and 8192 Hz; the rate in use is
+ * returned. Handlers must call rtc_periodic_ack() on every interrupt.
+ */
+uint32_t rtc_periodic_start(uint32_t hz, irq_handler_t handler);
+void rtc_periodic_stop(void);
+void rtc_periodic_ack(void);
+
+/* Frequencies of the fixed-rate timers */
+#define PIT_FREQUENCY     1193182
+#define ACPI_PM_FREQUENCY 3579545
+#define RTC_PERIODIC_BASE_HZ 32768u
+
+#endif /* ARCH_I386_TIMER_H */
@@ -0,0 +1,123 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <msr.h>
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/math64.h>
+#include "cpu.h"
+#include "timer.h"
+
+/* Length of each TSC calibration run */
+#define CALIBRATE_MS 20
+
+static uint64_t tsc_read(void) {
+    return rdtsc();
+}
+
+static struct clocksource tsc_clocksource = {
+    .name = "tsc",
+    .rating = 300,
+    .read = tsc_read,
+    .mask = ~0ULL,
+};
+
+static bool tsc_is_invariant(void) {
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(0x80000000, &eax, &ebx, &ecx, &edx);
+    if (eax < CPUID_EXT_LEAF_POWER) {
+        return false;
+    }
+    cpuid(CPUID_EXT_LEAF_POWER, &eax, &ebx, &ecx, &edx);
+    return (edx & CPUID_POWER_EDX_INVARIANT_TSC) != 0;
+}
+
+/**
+ * Measure the TSC frequency by counting TSC ticks while a reference
+ * counter advances by CALIBRATE_MS
+ * @param ref Reference clocksource with a known frequency
+ * @return TSC frequency in Hz
+ */
+static uint64_t calibrate_tsc(const struct clocksource *ref) {
+    uint32_t target = (uint32_t)div_u64_u32(ref->freq_hz, 1000 / CALIBRATE_MS);
+    uint64_t last = ref->read();
+    uint64_t now;
+
+    // Start on a tick edge so a partial first tick is not counted
+    do {
+        now = ref->read();
+    } while (now == last);
+    last = now;
+
+    uint64_t tsc_start = rdtsc();
+    uint32_t elapsed = 0;
+    while (elapsed < target) {
+        now = ref->read();
+        elapsed += (uint32_t)((now - last) & ref->mask);
+        last = now;
+    }
+    uint64_t tsc_end = rdtsc();
+
+    return div_u64_u32((tsc_end - tsc_start) * ref->freq_hz, elapsed);
+}
+
+/**
+ * Probe the platform timers, calibrate the TSC against the best of them and
+ * switch ktime to the best rated clocksource
+ */
+void time_init(void) {
+    // In order of preference as a calibration reference
+    struct clocksource *candidates[] = {
+        hpet_clocksource_init(),
+        acpi_pm_clocksource_init(),
+        pit_clocksource_init(),
+    };
+    const size_t count = sizeof(candidates) / sizeof(candidates[0]);
+    const struct clocksource *reference = NULL;
+
+    for (size_t i = 0; i < count; i++) {
+        if (candidates[i]) {
+            clocksource_register(candidates[i]);
+            if (!reference) {
+                reference = candidates[i];
+            }
+        }
+    }
+
+    if (!cpu_has_feature_edx(CPUID_FEAT_EDX_TSC)) {
+        debug_warning("CPU has no TSC");
+    } else {
+        uint64_t freq = calibrate_tsc(reference);
+        debug_info("TSC calibrated against %s: %llu Hz", reference->name, freq);
+
+        // Calibrate against the other timers too, as a measure of the error
+        for (size_t i = 0; i < count; i++) {
+            if (!candidates[i] || candidates[i] == reference || freq == 0) {
+                continue;
+            }
+            uint64_t check = calibrate_tsc(candidates[i]);
+            uint64_t diff = check > freq ? check - freq : freq - check;
+            debug_info("  against %s: %llu Hz, %c%llu ppm", candidates[i]->name, check,
+                       check >= freq ? '+' : '-',
+                       div_u64_u64_approx(diff * 1000000, freq));
+        }
+
+        if (freq == 0) {
+            debug_warning("TSC calibration failed, not using it");
+        } else {
+            if (!tsc_is_invariant()) {
+                debug_warning("TSC is not marked invariant, it may drift with power states");
+            }
+            tsc_clocksource.freq_hz = freq;
+            clocksource_register(&tsc_clocksource);
+        }
+    }
+
+    clocksource_select();
+    const struct clocksource *cs = clocksource_current();
+    debug_info("Using clocksource %s, %llu ns per 1000 ticks", cs->name,
+               clocksource_cycles_to_ns(cs, 1000));
+
+    clockevent_register(pit_clockevent_init());
+}
@@ -2,17 +2,82 @@
 #include <stddef.h>
 #include <stdint.h>
 #include <string.h>
+#include <paging.h>
+#include <kernel/debug.h>
+#include <kernel/kstat.h>
+#include <kernel/spinlock.h>
 #include <kernel/tty.h>
+#include "cpu.h"
+#include "fbcon.h"
+#include "io.h"
 #include "serial.h"
 #include "vga.h"
 
-static const size_t VGA_WIDTH = 80;
-static const size_t VGA_HEIGHT = 25;
+#define VGA_WIDTH 80
+#define VGA_HEIGHT 25
+
+/* Number of whole rows that fit in the VGA text window */
+#define VGA_RING_ROWS (VGA_BUFFER_CELLS / VGA_WIDTH)
+
+/* Largest screen any backend can have */
+#define TTY_MAX_COLUMNS FBCON_MAX_COLUMNS
+#define TTY_MAX_ROWS    FBCON_MAX_ROWS
+
+/* Lines of scrollback kept in RAM (power of two) */
+#define HISTORY_LINES 4096
+
 static size_t terminal_row;
 static size_t terminal_column;
 static uint8_t terminal_color;
 static uint16_t *terminal_buffer;
 
+/* Screen size of the active backend */
+static size_t terminal_width = VGA_WIDTH;
+static size_t terminal_height = VGA_HEIGHT;
+
+/* Draw through the framebuffer console instead of VGA text memory */
+static bool terminal_framebuffer;
+
+/*
+ * The console contents live in a RAM history ring of HISTORY_LINES rows,
+ * indexed by absolute line number. The live screen shows the lines starting
+ * at screen_top; rows changed since the last flush have their bit set in
+ * dirty_rows and only those are written out. Display memory is never read
+ * back. Rows are TTY_MAX_COLUMNS cells apart so the ring can hold a screen
+ * of either backend.
+ *
+ * The VGA text window holds VGA_RING_ROWS rows, so the visible screen is a
+ * window into it starting at vga_top, selected with the CRTC start-address
+ * registers. Scrolling advances vga_top and writes only the new bottom row;
+ * the whole screen is rewritten only when the window reaches the end of VGA
+ * memory and wraps back to row 0.
+ *
+ * The framebuffer has no such window, so there every scroll marks the whole
+ * screen dirty and fbcon_draw_row() blits only the cells whose contents
+ * actually changed.
+ */
+static uint16_t terminal_history[HISTORY_LINES * TTY_MAX_COLUMNS];
+static uint32_t screen_top;     /* Absolute line shown on screen row 0 */
+static uint32_t history_start;  /* Oldest absolute line still in the ring */
+static size_t view_offset;      /* Lines scrolled back from the live screen */
+static size_t vga_top;          /* VGA row at the display start address */
+static size_t crtc_start = (size_t)-1;
+static uint64_t dirty_rows;
+
+KSTAT_DEFINE(tty, chars);
+KSTAT_DEFINE(tty, scrolls);
+
+/*
+ * Guards the cursor, the history ring and the display. The public entry
+ * points take it; everything static below runs with it held. Innermost
+ * lock: only the serial port is touched under it.
+ */
+DEFINE_SPINLOCK(tty_lock);
+
+static inline uint64_t all_rows_dirty(void) {
+    return terminal_height >= 64 ? ~0ULL : (1ULL << terminal_height) - 1;
+}
+
 static bool terminal_serial_output = false;
 
 void terminal_enable_serial(bool enable) {
@@ -23,6 +88,146 @@ bool terminal_is_serial_enabled(void) {
     return terminal_serial_output;
 }
 
+/* Index of the lowest set bit, without pulling in libgcc's 64-bit helper */
+static inline size_t lowest_row(uint64_t rows) {
+    uint32_t low = (uint32_t)rows;
+    return low ? (size_t)__builtin_ctz(low) : 32 + (size_t)__builtin_ctz((uint32_t)(rows >> 32));
+}
+
+/* Get the history row holding an absolute line */
+static inline uint16_t *history_row(uint32_t line) {
+    return &terminal_history[(line & (HISTORY_LINES - 1)) * TTY_MAX_COLUMNS];
+}
+
+/* Get the history row backing live screen row y */
+static inline uint16_t *screen_row(size_t y) {
+    return history_row(screen_top + y);
+}
+
+static void clear_row(uint16_t *row) {
+    const uint16_t blank = vga_entry(' ', terminal_color);
+    for (size_t x = 0; x < terminal_width; x++) {
+        row[x] = blank;
+    }
+}
+
+static void set_display_start(size_t cell) {
+    outb(VGA_CRTC_INDEX, VGA_CRTC_START_HIGH);
+    outb(VGA_CRTC_DATA, (uint8_t)(cell >> 8));
+    outb(VGA_CRTC_INDEX, VGA_CRTC_START_LOW);
+    outb(VGA_CRTC_DATA, (uint8_t)cell);
+    crtc_start = cell;
+}
+
+/* Copy every dirty row from the history ring to the display */
+static void flush_rows(void) {
+    uint64_t pending = dirty_rows;
+    uint32_t first_line = screen_top - view_offset;
+
+    if (terminal_framebuffer) {
+        dirty_rows = 0;
+        while (pending) {
+            size_t y = lowest_row(pending);
+            pending &= pending - 1;
+            fbcon_draw_row(y, history_row(first_line + y), terminal_width);
+        }
+        return;
+    }
+
+    /* Output before terminal_initialize() only goes to the history */
+    if (!terminal_buffer) {
+        return;
+    }
+
+    uint16_t *window = terminal_buffer + vga_top * VGA_WIDTH;
+    dirty_rows = 0;
+
+    while (pending) {
+        size_t y = lowest_row(pending);
+        pending &= pending - 1;
+        memcpy(window + y * VGA_WIDTH, history_row(first_line + y), sizeof(uint16_t) * VGA_WIDTH);
+    }
+
+    if (crtc_start != vga_top * VGA_WIDTH) {
+        set_display_start(vga_top * VGA_WIDTH);
+    }
+}
+
+/* Place the blinking hardware cursor, hiding it while in the scrollback */
+static void update_cursor(void) {
+    static size_t cursor_cell = (size_t)-1;
+
+    if (terminal_framebuffer) {
+        fbcon_set_cursor(terminal_column, terminal_row, view_offset == 0);
+        return;
+    }
+    if (!terminal_buffer) {
+        return;
+    }
+
+    size_t cell = view_offset
+        ? (vga_top + VGA_HEIGHT) * VGA_WIDTH
+        : (vga_top + terminal_row) * VGA_WIDTH + terminal_column;
+
+    if (cell != cursor_cell) {
+        outb(VGA_CRTC_INDEX, VGA_CRTC_CURSOR_HIGH);
+        outb(VGA_CRTC_DATA, (uint8_t)(cell >> 8));
+        outb(VGA_CRTC_INDEX, VGA_CRTC_CURSOR_LOW);
+        outb(VGA_CRTC_DATA, (uint8_t)cell);
+        cursor_cell = cell;
+    }
+}
+
+/* Return to the live screen if the user was looking at the scrollback */
+static inline void terminal_snap_to_live(void) {
+    if (view_offset) {
+        view_offset = 0;
+        dirty_rows = all_rows_dirty();
+    }
+}
+
+void terminal_flush(void) {
+    uint32_t flags = spin_lock_irqsave(&tty_lock);
+    flush_rows();
+    spin_unlock_irqrestore(&tty_lock, flags);
+}
+
+void terminal_scroll_view(int lines) {
+    uint32_t flags = spin_lock_irqsave(&tty_lock);
+    size_t max_offset = screen_top - history_start;
+    long offset = (long)view_offset + lines;
+
+    if (offset < 0) {
+        offset = 0;
+    } else if ((size_t)offset > max_offset) {
+        offset = (long)max_offset;
+    }
+
+    if ((size_t)offset != view_offset) {
+        view_offset = (size_t)offset;
+        dirty_rows = all_rows_dirty();
+        flush_rows();
+        update_cursor();
+    }
+    spin_unlock_irqrestore(&tty_lock, flags);
+}
+
+void terminal_view_live(void) {
+    uint32_t flags = spin_lock_irqsave(&tty_lock);
+    terminal_snap_to_live();
+    flush_rows();
+    update_cursor();
+    spin_unlock_irqrestore(&tty_lock, flags);
+}
+
+void terminal_break_lock(void) {
+    spin_lock_break(&tty_lock);
+}
+
+size_t terminal_history_lines(void) {
+    return screen_top - history_start + terminal_height;
+}
+
 void terminal_initialize(void) {
     terminal_row = 0;
     terminal_column = 0;
@@ -34,12 +239,15 @@ void terminal_initialize(void) {
     // Print initialization message to debug
     const char* paging_status = is_paging_enabled() ? "ENABLED" : "DISABLED";
 
-    for (size_t y = 0; y < VGA_HEIGHT; y++) {
-        for (size_t x = 0; x < VGA_WIDTH; x++) {
-            const size_t index = y * VGA_WIDTH + x;
-            terminal_buffer[index] = vga_entry(' ', terminal_color);
-        }
+    screen_top = 0;
+    history_start = 0;
+    view_offset = 0;
+    vga_top = 0;
+    for (size_t y = 0; y < terminal_height; y++) {
+        clear_row(screen_row(y));
     }
+    dirty_rows = all_rows_dirty();
+    flush_rows();
 
     // Output some debug info about our terminal initialization
     terminal_writestring("Terminal initialized with paging ");
@@ -60,40 +268,108 @@ void terminal_initialize(void) {
     terminal_writestring("\n");
 }
 
+bool terminal_use_framebuffer(const struct boot_framebuffer *fb) {
+    size_t columns;
+    size_t rows;
+
+    if (!fbcon_init(fb, &columns, &rows)) {
+        return false;
+    }
+    if (columns < VGA_WIDTH || rows < VGA_HEIGHT) {
+        debug_warning("Framebuffer console smaller than text mode, not using it");
+        return false;
+    }
+
+    uint32_t flags = spin_lock_irqsave(&tty_lock);
+    size_t old_width = terminal_width;
+    size_t old_height = terminal_height;
+    const uint16_t blank = vga_entry(' ', terminal_color);
+
+    terminal_framebuffer = true;
+    terminal_width = columns;
+    terminal_height = rows;
+
+    /* Keep the lines already on screen and blank the area that was added */
+    while (screen_top + terminal_height - history_start > HISTORY_LINES) {
+        history_start++;
+    }
+    for (size_t y = 0; y < terminal_height; y++) {
+        uint16_t *row = screen_row(y);
+        for (size_t x = y < old_height ? old_width : 0; x < terminal_width; x++) {
+            row[x] = blank;
+        }
+    }
+
+    view_offset = 0;
+    vga_top = 0;
+    dirty_rows = all_rows_dirty();
+    flush_rows();
+    update_cursor();
+    spin_unlock_irqrestore(&tty_lock, flags);
+    return true;
+}
+
 void terminal_setcolor(uint8_t color) {
     terminal_color = color;
 }
 
 void terminal_putentryat(unsigned char c, uint8_t color, size_t x, size_t y) {
-    const size_t index = y * VGA_WIDTH + x;
-    terminal_buffer[index] = vga_entry(c, color);
+    uint32_t flags = spin_lock_irqsave(&tty_lock);
+    screen_row(y)[x] = vga_entry(c, color);
+    dirty_rows |= 1ULL << y;
+    spin_unlock_irqrestore(&tty_lock, flags);
 }
 
 void scroll(void) {
-    memmove(terminal_buffer,
-            terminal_buffer + VGA_WIDTH,
-            sizeof(uint16_t) * VGA_WIDTH * (VGA_HEIGHT - 1));
-    memset(terminal_buffer + VGA_WIDTH * (VGA_HEIGHT - 1),
-           0,
-           sizeof(uint16_t) * VGA_WIDTH);
+    kstat_inc(tty, scrolls);
+    screen_top++;
+    if (screen_top + terminal_height - history_start > HISTORY_LINES) {
+        history_start++;
+    }
+    clear_row(screen_row(terminal_height - 1));
+
+    if (terminal_framebuffer) {
+        /* Redraw from RAM; unchanged cells are skipped by the backend */
+        dirty_rows = all_rows_dirty();
+    } else if (vga_top + VGA_HEIGHT < VGA_RING_ROWS) {
+        /* Common case: move the display window down by one row */
+        vga_top++;
+        dirty_rows = (dirty_rows >> 1) | (1ULL << (VGA_HEIGHT - 1));
+    } else {
+        /* Out of VGA memory: rewrite the whole screen at the start */
+        vga_top = 0;
+        dirty_rows = all_rows_dirty();
+    }
+
     if (terminal_row > 0) {
         terminal_row--;
     }
 }
 
-void terminal_putchar(char c) {
-    /* Output to VGA */
+/* Move the cursor to the start of the next line, scrolling if needed */
+static void terminal_newline(void) {
+    terminal_column = 0;
+    terminal_row++;
+    if (terminal_row >= terminal_height) {
+        scroll();
+    }
+}
+
+/* Characters handled by terminal_control() rather than drawn as glyphs */
+#define CONTROL_CHARS ((1u << '\t') | (1u << '\n') | (1u << '\r'))
+
+static inline bool is_control(char c) {
+    return (unsigned char)c <= '\r' && (CONTROL_CHARS & (1u << c));
+}
+
+/* Apply a control character to the cursor without flushing */
+static void terminal_control(char c) {
     if (c == '\n') {
-        terminal_column = 0;
-        terminal_row++;
-        if (terminal_row >= VGA_HEIGHT) {
-            scroll();
-        }
+        terminal_newline();
 
         /* Output to serial port if enabled */
         if (terminal_serial_output) {
-            serial_com1_write_byte('\r');
-            serial_com1_write_byte('\n');
+            serial_com1_write("\r\n", 2);
         }
         return;
     }
@@ -108,44 +384,224 @@ void terminal_putchar(char c) {
         return;
     }
 
-    if (c == '\t') {
-        terminal_column += 4;
-        if (terminal_column >= VGA_WIDTH) {
-            terminal_column = 0;
-            terminal_row++;
-            if (terminal_row >= VGA_HEIGHT) {
-                scroll();
-            }
-        }
-
-        /* Output to serial port if enabled */
-        if (terminal_serial_output) {
-            serial_com1_write_byte('\t');
-        }
-        return;
+    /* Tab */
+    terminal_column += 4;
+    if (terminal_column >= terminal_width) {
+        terminal_newline();
     }
 
-    terminal_putentryat(c, terminal_color, terminal_column, terminal_row);
-    terminal_column++;
-    if (terminal_column >= VGA_WIDTH) {
-        terminal_column = 0;
-        terminal_row++;
-        if (terminal_row >= VGA_HEIGHT) {
-            scroll();
-        }
+    /* Output to serial port if enabled */
+    if (terminal_serial_output) {
+        serial_com1_write_byte('\t');
     }
+}
+
+/*
+ * Draw a run of printable characters into the history ring. Each row gets
+ * one tight store loop with the attribute word computed once, and the
+ * cursor moves once per row rather than per character.
+ */
+static void terminal_write_span(const char *data, size_t size) {
+    const uint16_t attribute = (uint16_t)terminal_color << 8;
 
     /* Output to serial port if enabled */
     if (terminal_serial_output) {
-        serial_com1_write_byte(c);
+        serial_com1_write(data, size);
     }
+
+    while (size > 0) {
+        size_t room = terminal_width - terminal_column;
+        size_t count = size < room ? size : room;
+        uint16_t *cell = screen_row(terminal_row) + terminal_column;
+
+        for (size_t i = 0; i < count; i++) {
+            cell[i] = attribute | (unsigned char)data[i];
+        }
+        dirty_rows |= 1ULL << terminal_row;
+
+        data += count;
+        size -= count;
+        terminal_column += count;
+        if (terminal_column >= terminal_width) {
+            terminal_newline();
+        }
+    }
+}
+
+void terminal_putchar(char c) {
+    terminal_write(&c, 1);
 }
 
 void terminal_write(const char *data, size_t size) {
-    for (size_t i = 0; i < size; i++)
-        terminal_putchar(data[i]);
+    uint32_t flags = spin_lock_irqsave(&tty_lock);
+    kstat_add(tty, chars, size);
+    terminal_snap_to_live();
+
+    size_t i = 0;
+    while (i < size) {
+        if (is_control(data[i])) {
+            terminal_control(data[i++]);
+            continue;
+        }
+
+        size_t end = i + 1;
+        while (end < size && !is_control(data[end])) {
+            end++;
+        }
+        terminal_write_span(data + i, end - i);
+        i = end;
+    }
+
+    flush_rows();
+    update_cursor();
+    spin_unlock_irqrestore(&tty_lock, flags);
 }
 
 void terminal_writestring(const char *data) {
     terminal_write(data, strlen(data));
 }
+
+/*
+ * Reference implementation of the previous output path: every character is
+ * stored straight into VGA memory and every scroll moves the screen contents
+ * inside VGA memory. The framebuffer has its own, fbcon_benchmark_direct().
+ */
+static void direct_write_line(const char *line, size_t *row) {
+    for (size_t x = 0; line[x] != '\n'; x++) {
+        terminal_buffer[*row * VGA_WIDTH + x] = vga_entry(line[x], terminal_color);
+    }
+    (*row)++;
+    if (*row >= VGA_HEIGHT) {
+        memmove(terminal_buffer,
+                terminal_buffer + VGA_WIDTH,
+                sizeof(uint16_t) * VGA_WIDTH * (VGA_HEIGHT - 1));
+        memset(terminal_buffer + VGA_WIDTH * (VGA_HEIGHT - 1),
+               0,
+               sizeof(uint16_t) * VGA_WIDTH);
+        (*row)--;
+    }
+}
+
+void terminal_benchmark_scroll(size_t lines, uint64_t *console_cycles, uint64_t *direct_cycles) {
+    static uint16_t saved_screen[TTY_MAX_COLUMNS * TTY_MAX_ROWS];
+    static const char line[] =
+        "The quick brown fox jumps over the lazy dog. 0123456789 ABCDEFGHIJKLMNOPQRSTUV\n";
+
+    /*
+     * Keep the benchmark out of the serial log and take its lines back out
+     * of the history afterwards. If the history ring is already full, the
+     * oldest lines it overwrote are lost, and so is anything other CPUs or
+     * threads print while the benchmark runs.
+     */
+    uint32_t flags = spin_lock_irqsave(&tty_lock);
+    bool serial = terminal_serial_output;
+    size_t saved_row = terminal_row;
+    size_t saved_column = terminal_column;
+    uint32_t saved_top = screen_top;
+    uint32_t saved_start = history_start;
+    for (size_t y = 0; y < terminal_height; y++) {
+        memcpy(&saved_screen[y * TTY_MAX_COLUMNS], screen_row(y), sizeof(uint16_t) * terminal_width);
+    }
+    terminal_snap_to_live();
+    flush_rows();
+    update_cursor();
+    terminal_serial_output = false;
+    spin_unlock_irqrestore(&tty_lock, flags);
+
+    // terminal_write() takes the lock itself, as any caller's would
+    uint64_t start = rdtsc();
+    for (size_t i = 0; i < lines; i++) {
+        terminal_write(line, sizeof(line) - 1);
+    }
+    *console_cycles = rdtsc() - start;
+
+    flags = spin_lock_irqsave(&tty_lock);
+    if (terminal_framebuffer) {
+        *direct_cycles = fbcon_benchmark_direct(line, terminal_color, lines);
+    } else {
+        /* The reference path draws from the top of VGA memory */
+        vga_top = 0;
+        set_display_start(0);
+        size_t row = VGA_HEIGHT - 1;
+        start = rdtsc();
+        for (size_t i = 0; i < lines; i++) {
+            direct_write_line(line, &row);
+        }
+        *direct_cycles = rdtsc() - start;
+    }
+
+    screen_top = saved_top;
+    history_start = saved_start;
+    for (size_t y = 0; y < terminal_height; y++) {
+        memcpy(screen_row(y), &saved_screen[y * TTY_MAX_COLUMNS], sizeof(uint16_t) * terminal_width);
+    }
+    terminal_row = saved_row;
+    terminal_column = saved_column;
+    terminal_serial_output = serial;
+    dirty_rows = all_rows_dirty();
+    flush_rows();
+    update_cursor();
+    spin_unlock_irqrestore(&tty_lock, flags);
+}
+
+void terminal_use_write_combining(void) {
+    if (terminal_buffer) {
+        set_region_cache_type(terminal_buffer, VGA_BUFFER_CELLS * sizeof(uint16_t), PAGE_CACHE_WC);
+    }
+}
+
+void terminal_benchmark_cache(size_t passes, struct console_cache_benchmark *result) {
+    static const enum page_cache_type types[2] = { PAGE_CACHE_UC, PAGE_CACHE_WC };
+    uint64_t fill[2];
+    uint64_t scroll[2];
+
+    uint32_t flags = spin_lock_irqsave(&tty_lock);
+    terminal_snap_to_live();
+    flush_rows();
+    update_cursor();
+    spin_unlock_irqrestore(&tty_lock, flags);
+
+    /*
+     * A fill stores every cell or pixel of the screen. A scroll is a
+     * full-screen rewrite: in text mode the one done when the display
+     * window wraps, on the framebuffer a redraw of every cell. Remapping
+     * takes the paging lock, so it happens outside tty_lock, which must
+     * stay innermost.
+     */
+    for (size_t t = 0; t < 2; t++) {
+        if (terminal_framebuffer) {
+            fbcon_set_cache_type(types[t]);
+        } else {
+            set_region_cache_type(terminal_buffer, VGA_BUFFER_CELLS * sizeof(uint16_t), types[t]);
+        }
+
+        flags = spin_lock_irqsave(&tty_lock);
+        if (terminal_framebuffer) {
+            fbcon_benchmark_pass(passes, &fill[t], &scroll[t]);
+        } else {
+            uint16_t *window = terminal_buffer + vga_top * VGA_WIDTH;
+            uint64_t start = rdtsc();
+            for (size_t i = 0; i < passes; i++) {
+                const uint16_t cell = vga_entry(i & 1 ? '#' : ' ', terminal_color);
+                for (size_t x = 0; x < VGA_WIDTH * VGA_HEIGHT; x++) {
+                    window[x] = cell;
+                }
+            }
+            fill[t] = rdtsc() - start;
+
+            start = rdtsc();
+            for (size_t i = 0; i < passes; i++) {
+                dirty_rows = all_rows_dirty();
+                flush_rows();
+            }
+            scroll[t] = rdtsc() - start;
+        }
+        spin_unlock_irqrestore(&tty_lock, flags);
+    }
+
+    /* types[] ends with WC, and the last flush restored the screen */
+    result->uc_fill = fill[0];
+    result->wc_fill = fill[1];
+    result->uc_scroll = scroll[0];
+    result->wc_scroll = scroll[1];
+}
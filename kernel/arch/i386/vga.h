@@ -2,9 +2,7 @@
 #define ARCH_I386_VGA_H
 
 #include <stdint.h>
-
-/* Define the virtual base address for kernel */
-#define KERNEL_VIRTUAL_BASE 0xC0000000
+#include <paging.h>
 
 /* VGA buffer physical address */
 #define VGA_BUFFER_PHYSICAL 0xB8000
@@ -12,12 +10,16 @@
 /* VGA buffer virtual address (used after paging is enabled) */
 #define VGA_BUFFER_VIRTUAL (VGA_BUFFER_PHYSICAL + KERNEL_VIRTUAL_BASE)
 
-/* Determine if paging is enabled by checking CR0 register */
-static inline int is_paging_enabled(void) {
-    uint32_t cr0;
-    __asm__ volatile("movl %%cr0, %0" : "=r"(cr0));
-    return (cr0 & 0x80000000) != 0; /* Check PG bit */
-}
+/* The colour text window at 0xB8000 is 32KB, i.e. 16K character cells */
+#define VGA_BUFFER_CELLS 0x4000
+
+/* CRT controller ports and registers */
+#define VGA_CRTC_INDEX       0x3D4
+#define VGA_CRTC_DATA        0x3D5
+#define VGA_CRTC_START_HIGH  0x0C /* Display start address, bits 15:8 */
+#define VGA_CRTC_START_LOW   0x0D /* Display start address, bits 7:0 */
+#define VGA_CRTC_CURSOR_HIGH 0x0E /* Cursor location, bits 15:8 */
+#define VGA_CRTC_CURSOR_LOW  0x0F /* Cursor location, bits 7:0 */
 
 /* Get the appropriate VGA buffer address based on paging state */
 static inline uint16_t* get_vga_buffer(void) {
@@ -0,0 +1,42 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <kernel/bench.h>
+#include <kernel/tty.h>
+
+/* One line of output, so every call also scrolls the console */
+static const char line[] =
+    "bench: the quick brown fox jumps over the lazy dog 0123456789 abcdefghijklmno\n";
+
+static char format_buffer[128];
+static bool serial_was_enabled;
+
+/* Time the console alone, without mirroring every line to COM1 */
+static void console_setup(void) {
+    serial_was_enabled = terminal_is_serial_enabled();
+    terminal_enable_serial(false);
+}
+
+static void console_teardown(void) {
+    terminal_enable_serial(serial_was_enabled);
+}
+
+/* Formatting only: integers, a string, hex and padding */
+static void bench_snprintf(void) {
+    snprintf(format_buffer, sizeof(format_buffer), "%d %u %s 0x%08x %-8s|%5d",
+             -12345, 4000000000u, "frame", 0xC0100000u, "pad", 42);
+    bench_use(format_buffer);
+}
+
+/* Formatting plus console output of one line */
+static void bench_printf(void) {
+    printf("bench: %d %s 0x%x\n", 12345, "printf", 0xC0100000u);
+}
+
+static void bench_terminal_write(void) {
+    terminal_write(line, sizeof(line) - 1);
+}
+
+BENCHMARK(snprintf, bench_snprintf);
+BENCHMARK_FIXTURE(printf, bench_printf, console_setup, console_teardown);
+BENCHMARK_FIXTURE(terminal_write, bench_terminal_write, console_setup, console_teardown);
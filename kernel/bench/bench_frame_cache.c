@@ -0,0 +1,70 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/bench.h>
+#include <kernel/debug.h>
+#include <kernel/frame.h>
+
+/*
+ * Frame allocation scaling: every participating CPU allocates
+ * SCALING_DEPTH frames and frees them again, SCALING_ROUNDS times, all at
+ * once. One iteration is the time until the last CPU is done, so with
+ * perfect scaling it stays flat as CPUs are added.
+ */
+#define SCALING_ROUNDS     16
+#define SCALING_DEPTH      16
+#define SCALING_ITERATIONS 200
+
+struct scaling_ops {
+    uint32_t (*alloc)(void);
+    void (*free)(uint32_t frame_addr);
+};
+
+static const struct scaling_ops global_ops = { frame_alloc, frame_free };
+static const struct scaling_ops cache_ops = { frame_cache_alloc, frame_cache_free };
+
+static volatile uint32_t scaling_failures;
+
+static void scaling_work(void* arg) {
+    const struct scaling_ops* ops = arg;
+    uint32_t frames[SCALING_DEPTH];
+
+    for (int round = 0; round < SCALING_ROUNDS; round++) {
+        for (int i = 0; i < SCALING_DEPTH; i++) {
+            frames[i] = ops->alloc();
+        }
+        for (int i = 0; i < SCALING_DEPTH; i++) {
+            if (frames[i]) {
+                ops->free(frames[i]);
+            } else {
+                __atomic_fetch_add(&scaling_failures, 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+static void run_scaling(uint32_t cpus, const struct scaling_ops* ops) {
+    bench_run_on_cpus(cpus, scaling_work, (void*)ops);
+}
+
+static void scaling_setup(void) {
+    scaling_failures = 0;
+}
+
+static void scaling_report(void) {
+    if (scaling_failures) {
+        debug_warning("bench: %u frame allocations failed", scaling_failures);
+    }
+}
+
+#define SCALING_BENCHMARKS(cpus)                                                        \
+    static void bench_frame_global_##cpus(void) { run_scaling(cpus, &global_ops); }     \
+    static void bench_frame_cache_##cpus(void) { run_scaling(cpus, &cache_ops); }       \
+    BENCHMARK_CPUS(frame_global_##cpus##cpu, bench_frame_global_##cpus,                 \
+                   scaling_setup, scaling_report, SCALING_ITERATIONS, cpus);            \
+    BENCHMARK_CPUS(frame_cache_##cpus##cpu, bench_frame_cache_##cpus,                   \
+                   scaling_setup, scaling_report, SCALING_ITERATIONS, cpus)
+
+SCALING_BENCHMARKS(1);
+SCALING_BENCHMARKS(2);
+SCALING_BENCHMARKS(4);
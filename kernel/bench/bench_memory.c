@@ -0,0 +1,39 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "paging.h"
+#include <kernel/bench.h>
+
+/* Unused kernel-space address for the map/unmap benchmark */
+#define BENCH_MAP_ADDRESS ((void*)0xD0400000)
+
+static void *bench_frame;
+
+/* Allocate a zeroed frame and give it back */
+static void bench_frame_alloc_free(void) {
+    void *frame = kmalloc_physical_page();
+    bench_use(frame);
+    kfree_physical_page(frame);
+}
+
+BENCHMARK(frame_alloc_free, bench_frame_alloc_free);
+
+static void map_setup(void) {
+    bench_frame = kmalloc_physical_page();
+    // Create the page table now, not inside the first timed call
+    map_page_to_frame(BENCH_MAP_ADDRESS, bench_frame, PAGE_WRITE, PAGE_CACHE_WB);
+    unmap_page(BENCH_MAP_ADDRESS);
+}
+
+static void map_teardown(void) {
+    kfree_physical_page(bench_frame);
+    bench_frame = NULL;
+}
+
+/* Map a page, touch it through the new mapping and unmap it again */
+static void bench_map_unmap(void) {
+    map_page_to_frame(BENCH_MAP_ADDRESS, bench_frame, PAGE_WRITE, PAGE_CACHE_WB);
+    *(volatile uint32_t*)BENCH_MAP_ADDRESS = 0;
+    unmap_page(BENCH_MAP_ADDRESS);
+}
+
+BENCHMARK_FIXTURE(map_unmap, bench_map_unmap, map_setup, map_teardown);
@@ -0,0 +1,92 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include "interrupts.h"
+#include <kernel/bench.h>
+#include <kernel/debug.h>
+#include <kernel/sched.h>
+
+/* Threads left runnable at a low priority while the crowded benchmark runs */
+#define CROWD_THREADS 64
+
+static volatile bool partner_stop;
+static struct thread* partner;
+static volatile bool crowd_stop;
+static volatile unsigned int crowd_left;
+
+/* Yields straight back, so every kthread_yield() of ours is two switches */
+static void partner_loop(void* arg) {
+    (void)arg;
+    while (!partner_stop) {
+        kthread_yield();
+    }
+}
+
+static void yield_setup(void) {
+    partner_stop = false;
+    partner = kthread_create("bench-partner", partner_loop, NULL);
+    if (!partner) {
+        debug_error("bench: cannot create the yield partner thread");
+    }
+}
+
+static void yield_teardown(void) {
+    partner_stop = true;
+    // Let the partner see the flag and exit
+    while (partner && partner->state != THREAD_DEAD) {
+        kthread_yield();
+    }
+    partner = NULL;
+}
+
+static void crowd_loop(void* arg) {
+    (void)arg;
+    while (!crowd_stop) {
+        kthread_yield();
+    }
+    uint32_t flags = irq_save();
+    crowd_left--;
+    irq_restore(flags);
+}
+
+/* The partner plus runnable threads on another level, which a pick skips */
+static void crowded_setup(void) {
+    crowd_stop = false;
+    crowd_left = 0;
+    for (int i = 0; i < CROWD_THREADS; i++) {
+        struct thread* thread = kthread_create("bench-crowd", crowd_loop, NULL);
+        if (!thread) {
+            break;
+        }
+        kthread_set_priority(thread, SCHED_PRIORITIES - 2);
+        crowd_left++;
+    }
+    yield_setup();
+}
+
+static void crowded_teardown(void) {
+    struct thread* self = kthread_current();
+    uint8_t priority = self->base_priority;
+
+    yield_teardown();
+    // Drop to the crowd's level so round robin lets it see the flag
+    crowd_stop = true;
+    kthread_set_priority(self, SCHED_PRIORITIES - 2);
+    while (crowd_left) {
+        kthread_yield();
+    }
+    kthread_set_priority(self, priority);
+}
+
+/* A round trip to another thread and back: two switch_to() calls */
+static void bench_yield_round_trip(void) {
+    kthread_yield();
+}
+
+/* Nobody else runnable: the cost of entering and leaving the scheduler */
+static void bench_yield_alone(void) {
+    kthread_yield();
+}
+
+BENCHMARK_FIXTURE(kthread_yield_round_trip, bench_yield_round_trip, yield_setup, yield_teardown);
+BENCHMARK(kthread_yield_alone, bench_yield_alone);
+BENCHMARK_FIXTURE(kthread_yield_crowded, bench_yield_round_trip, crowded_setup, crowded_teardown);
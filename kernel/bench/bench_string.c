@@ -0,0 +1,55 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <kernel/bench.h>
+
+#define BENCH_BUFFER_SIZE 4096
+#define BENCH_SMALL_SIZE  64
+
+static uint8_t src[BENCH_BUFFER_SIZE] __attribute__((aligned(64)));
+static uint8_t dst[BENCH_BUFFER_SIZE + BENCH_SMALL_SIZE] __attribute__((aligned(64)));
+
+static void bench_memcpy_4k(void) {
+    memcpy(dst, src, BENCH_BUFFER_SIZE);
+    bench_use(dst);
+}
+
+static void bench_memcpy_64(void) {
+    memcpy(dst, src, BENCH_SMALL_SIZE);
+    bench_use(dst);
+}
+
+/* Source and destination one byte apart, the unaligned worst case */
+static void bench_memcpy_4k_unaligned(void) {
+    memcpy(dst + 1, src, BENCH_BUFFER_SIZE - 1);
+    bench_use(dst);
+}
+
+static void bench_memset_4k(void) {
+    memset(dst, 0x5A, BENCH_BUFFER_SIZE);
+    bench_use(dst);
+}
+
+/* Overlapping move towards higher addresses, so it has to run backwards */
+static void bench_memmove_4k_overlap(void) {
+    memmove(dst + BENCH_SMALL_SIZE, dst, BENCH_BUFFER_SIZE);
+    bench_use(dst);
+}
+
+static void memcmp_setup(void) {
+    memcpy(dst, src, BENCH_BUFFER_SIZE);
+}
+
+/* Equal buffers, so every byte is compared */
+static void bench_memcmp_4k(void) {
+    bench_use(src);
+    volatile int result = memcmp(dst, src, BENCH_BUFFER_SIZE);
+    (void)result;
+}
+
+BENCHMARK(memcpy_4k, bench_memcpy_4k);
+BENCHMARK(memcpy_64, bench_memcpy_64);
+BENCHMARK(memcpy_4k_unaligned, bench_memcpy_4k_unaligned);
+BENCHMARK(memset_4k, bench_memset_4k);
+BENCHMARK(memmove_4k_overlap, bench_memmove_4k_overlap);
+BENCHMARK_FIXTURE(memcmp_4k, bench_memcmp_4k, memcmp_setup, 0);
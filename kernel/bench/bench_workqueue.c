@@ -0,0 +1,70 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/bench.h>
+#include <kernel/completion.h>
+#include <kernel/debug.h>
+#include <kernel/workqueue.h>
+
+/* Items one fan-out iteration splits into, queued from a worker */
+#define FAN_OUT_ITEMS 32
+
+static struct completion bench_done = COMPLETION_INIT;
+static volatile uint32_t fan_out_left;
+static volatile uint32_t queue_failures;
+
+static void signal_done(void* arg) {
+    complete(arg);
+}
+
+static void fan_out_leaf(void* arg) {
+    (void)arg;
+    if (__atomic_sub_fetch(&fan_out_left, 1, __ATOMIC_ACQ_REL) == 0) {
+        complete(&bench_done);
+    }
+}
+
+/* Runs on a worker, so the leaves land on its deque for the others to steal */
+static void fan_out_root(void* arg) {
+    (void)arg;
+    for (int i = 0; i < FAN_OUT_ITEMS; i++) {
+        if (!queue_work(fan_out_leaf, NULL)) {
+            queue_failures++;
+            fan_out_leaf(NULL);
+        }
+    }
+}
+
+static void workqueue_setup(void) {
+    completion_init(&bench_done);
+    queue_failures = 0;
+}
+
+static void workqueue_teardown(void) {
+    if (queue_failures) {
+        debug_warning("bench: %u work items did not fit the queue", queue_failures);
+    }
+    workqueue_dump();
+}
+
+/* Queue one item from outside the pool and sleep until it has run */
+static void bench_round_trip(void) {
+    if (!queue_work(signal_done, &bench_done)) {
+        queue_failures++;
+        return;
+    }
+    wait_for_completion(&bench_done);
+}
+
+/* One item that queues FAN_OUT_ITEMS more, then wait for them all */
+static void bench_fan_out(void) {
+    fan_out_left = FAN_OUT_ITEMS;
+    if (!queue_work(fan_out_root, NULL)) {
+        queue_failures++;
+        return;
+    }
+    wait_for_completion(&bench_done);
+}
+
+BENCHMARK_FIXTURE(workqueue_round_trip, bench_round_trip, workqueue_setup, workqueue_teardown);
+BENCHMARK_FIXTURE(workqueue_fan_out, bench_fan_out, workqueue_setup, workqueue_teardown);
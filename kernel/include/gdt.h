@@ -3,8 +3,12 @@
 
 #include <stdint.h>
 
+// Descriptors in the GDT of each CPU: null, code, data and per-CPU data
+#define GDT_ENTRIES 4
+
 #define GDT_KERNEL_CODE_SEGMENT_SELECTOR 0x08
 #define GDT_KERNEL_DATA_SEGMENT_SELECTOR 0x10
+#define GDT_PERCPU_SEGMENT_SELECTOR      0x18  // Loaded into GS
 
 // Segment access byte values for code and data segments
 // Reference: Intel Software Developer Manual, Volume 3, Section 3.4.5
@@ -53,6 +57,15 @@ struct gdt_ptr {
     uint32_t base;    // Base address of the GDT
 } __attribute__((packed));
 
+void setup_gdt(void);
+
+// Fill a GDT with the kernel's flat code and data segments and a per-CPU
+// segment covering size bytes at percpu
+void gdt_init_table(struct gdt_entry* table, const void* percpu, uint32_t size);
+
+// Load a GDT of GDT_ENTRIES descriptors and reload every segment register,
+// GS with the per-CPU segment
+void gdt_load(struct gdt_entry* table, struct gdt_ptr* ptr);
 
 #endif // GDT_H
 
@@ -0,0 +1,41 @@
+#ifndef IDT_H
+#define IDT_H
+
+#include <stdint.h>
+
+// Number of gates in the IDT and how they are used
+#define IDT_ENTRIES       256
+#define IDT_EXCEPTIONS    32    // Vectors 0-31 are CPU exceptions
+#define IDT_IRQ_BASE      32    // The PICs are remapped to vectors 32-47
+#define IDT_IRQ_COUNT     16
+#define IDT_STUB_COUNT    (IDT_IRQ_BASE + IDT_IRQ_COUNT)
+#define IDT_LAPIC_CALL    0xF0  // Wakes an idle CPU to run smp_call() work
+#define IDT_LAPIC_SPURIOUS 0xFF // Low nibble must be all ones on P6 APICs
+
+// Gate type and attribute byte
+// Reference: Intel Software Developer Manual, Volume 3, Section 6.11
+#define IDT_GATE_PRESENT        0x80
+#define IDT_GATE_INTERRUPT_32   0x0E  // Clears IF on entry
+#define IDT_GATE_KERNEL (IDT_GATE_PRESENT | IDT_GATE_INTERRUPT_32)
+
+// Structure to represent an IDT gate descriptor
+struct idt_entry {
+    uint16_t offset_low;   // Lower 16 bits of the handler address
+    uint16_t selector;     // Code segment selector
+    uint8_t zero;          // Always zero
+    uint8_t type_attr;     // Gate type, DPL and present bit
+    uint16_t offset_high;  // Upper 16 bits of the handler address
+} __attribute__((packed));
+
+// Structure to represent the IDT pointer
+struct idt_ptr {
+    uint16_t limit;   // Limit of the IDT
+    uint32_t base;    // Base address of the IDT
+} __attribute__((packed));
+
+void setup_idt(void);
+
+// Load the IDT built by setup_idt() on another CPU
+void idt_load(void);
+
+#endif // IDT_H
@@ -0,0 +1,54 @@
+#ifndef INTERRUPTS_H
+#define INTERRUPTS_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Registers saved by the common interrupt stub, lowest address first */
+struct interrupt_frame {
+    uint32_t gs, fs, es, ds;
+    uint32_t edi, esi, ebp, esp_unused, ebx, edx, ecx, eax;
+    uint32_t vector;
+    uint32_t error_code;
+    uint32_t eip, cs, eflags;    /* Pushed by the CPU */
+};
+
+/* Handler for a hardware interrupt line; runs with interrupts disabled */
+typedef void (*irq_handler_t)(struct interrupt_frame* frame);
+
+/* Install a handler for an IRQ line and unmask it */
+void irq_register_handler(uint8_t irq, irq_handler_t handler);
+
+/* Called by the assembly stubs for every vector */
+void interrupt_dispatch(struct interrupt_frame* frame);
+
+#define EFLAGS_IF 0x200
+
+static inline void interrupts_enable(void) {
+    __asm__ volatile("sti" ::: "memory");
+}
+
+static inline void interrupts_disable(void) {
+    __asm__ volatile("cli" ::: "memory");
+}
+
+/* Disable interrupts, returning the previous EFLAGS for irq_restore() */
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0; cli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & EFLAGS_IF) {
+        interrupts_enable();
+    }
+}
+
+static inline bool interrupts_enabled(void) {
+    uint32_t flags;
+    __asm__ volatile("pushfl; popl %0" : "=r"(flags));
+    return (flags & EFLAGS_IF) != 0;
+}
+
+#endif /* INTERRUPTS_H */
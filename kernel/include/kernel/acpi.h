@@ -0,0 +1,142 @@
+#ifndef _KERNEL_ACPI_H
+#define _KERNEL_ACPI_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Root system description pointer */
+struct acpi_rsdp {
+    char signature[8];          /* "RSD PTR " */
+    uint8_t checksum;
+    char oem_id[6];
+    uint8_t revision;
+    uint32_t rsdt_address;
+    /* ACPI 2.0+ */
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t extended_checksum;
+    uint8_t reserved[3];
+} __attribute__((packed));
+
+/* Header shared by every system description table */
+struct acpi_sdt_header {
+    char signature[4];
+    uint32_t length;
+    uint8_t revision;
+    uint8_t checksum;
+    char oem_id[6];
+    char oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed));
+
+/* Generic address structure */
+struct acpi_gas {
+    uint8_t address_space;      /* ACPI_GAS_* */
+    uint8_t bit_width;
+    uint8_t bit_offset;
+    uint8_t access_size;
+    uint64_t address;
+} __attribute__((packed));
+
+#define ACPI_GAS_MEMORY 0
+#define ACPI_GAS_IO     1
+
+/* Fixed ACPI description table ("FACP"), up to the PM timer fields */
+struct acpi_fadt {
+    struct acpi_sdt_header header;
+    uint32_t firmware_ctrl;
+    uint32_t dsdt;
+    uint8_t reserved0;
+    uint8_t preferred_pm_profile;
+    uint16_t sci_int;
+    uint32_t smi_cmd;
+    uint8_t acpi_enable;
+    uint8_t acpi_disable;
+    uint8_t s4bios_req;
+    uint8_t pstate_cnt;
+    uint32_t pm1a_evt_blk;
+    uint32_t pm1b_evt_blk;
+    uint32_t pm1a_cnt_blk;
+    uint32_t pm1b_cnt_blk;
+    uint32_t pm2_cnt_blk;
+    uint32_t pm_tmr_blk;        /* I/O port of the PM timer */
+    uint32_t gpe0_blk;
+    uint32_t gpe1_blk;
+    uint8_t pm1_evt_len;
+    uint8_t pm1_cnt_len;
+    uint8_t pm2_cnt_len;
+    uint8_t pm_tmr_len;
+    uint8_t gpe0_blk_len;
+    uint8_t gpe1_blk_len;
+    uint8_t gpe1_base;
+    uint8_t cst_cnt;
+    uint16_t p_lvl2_lat;
+    uint16_t p_lvl3_lat;
+    uint16_t flush_size;
+    uint16_t flush_stride;
+    uint8_t duty_offset;
+    uint8_t duty_width;
+    uint8_t day_alrm;
+    uint8_t mon_alrm;
+    uint8_t century;
+    uint16_t iapc_boot_arch;
+    uint8_t reserved1;
+    uint32_t flags;             /* ACPI_FADT_* */
+} __attribute__((packed));
+
+#define ACPI_FADT_TMR_VAL_EXT (1u << 8)  /* PM timer is 32 bits wide */
+
+/* HPET description table ("HPET") */
+struct acpi_hpet {
+    struct acpi_sdt_header header;
+    uint32_t event_timer_block_id;
+    struct acpi_gas base_address;
+    uint8_t hpet_number;
+    uint16_t minimum_tick;
+    uint8_t page_protection;
+} __attribute__((packed));
+
+/* Multiple APIC description table ("APIC"), followed by its entries */
+struct acpi_madt {
+    struct acpi_sdt_header header;
+    uint32_t local_apic_address;
+    uint32_t flags;
+} __attribute__((packed));
+
+/* Header of every MADT entry */
+struct acpi_madt_entry {
+    uint8_t type;               /* ACPI_MADT_* */
+    uint8_t length;
+} __attribute__((packed));
+
+#define ACPI_MADT_LOCAL_APIC          0
+#define ACPI_MADT_IO_APIC             1
+#define ACPI_MADT_LOCAL_APIC_OVERRIDE 5
+
+/* One processor and its local APIC */
+struct acpi_madt_local_apic {
+    struct acpi_madt_entry entry;
+    uint8_t processor_id;
+    uint8_t apic_id;
+    uint32_t flags;             /* ACPI_MADT_LAPIC_* */
+} __attribute__((packed));
+
+#define ACPI_MADT_LAPIC_ENABLED        (1u << 0)
+#define ACPI_MADT_LAPIC_ONLINE_CAPABLE (1u << 1)
+
+/* 64-bit address of the local APICs, replacing local_apic_address */
+struct acpi_madt_local_apic_override {
+    struct acpi_madt_entry entry;
+    uint16_t reserved;
+    uint64_t address;
+} __attribute__((packed));
+
+/* Map the tables reachable from the RSDP saved at boot */
+bool acpi_init(void);
+
+/* Find a table by its signature, or NULL if it is absent */
+const struct acpi_sdt_header* acpi_find_table(const char* signature);
+
+#endif /* _KERNEL_ACPI_H */
@@ -0,0 +1,30 @@
+#ifndef _KERNEL_BACKTRACE_H
+#define _KERNEL_BACKTRACE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Most frames backtrace_print() follows */
+#define BACKTRACE_MAX_FRAMES 16
+
+/*
+ * Collect return addresses by following saved frame pointers, innermost
+ * first. A frame outside the current thread's stack (the boot stack on a
+ * CPU that runs no threads), a return address outside the kernel image or
+ * a link that does not move up the stack ends the walk, so a register that
+ * is not a frame pointer cannot fault.
+ * Only complete with KERNEL_FRAME_POINTERS.
+ * @param ebp Frame pointer to start from
+ * @param callers Where the return addresses are stored
+ * @param max Room in callers
+ * @return Number of return addresses stored
+ */
+size_t backtrace_walk(uint32_t ebp, uint32_t* callers, size_t max);
+
+/*
+ * Print eip and the callers found from ebp through debug_error(), with
+ * function names when the kernel has a symbol table
+ */
+void backtrace_print(uint32_t eip, uint32_t ebp);
+
+#endif /* _KERNEL_BACKTRACE_H */
@@ -0,0 +1,70 @@
+#ifndef _KERNEL_BENCH_H
+#define _KERNEL_BENCH_H
+
+#include <stdint.h>
+
+/* Timed iterations of a benchmark that does not ask for its own count */
+#ifndef BENCH_ITERATIONS
+#define BENCH_ITERATIONS 1000
+#endif
+
+/* Most iterations a benchmark may ask for; samples are kept for percentiles */
+#define BENCH_MAX_ITERATIONS 8192
+
+typedef void (*bench_fn_t)(void);
+
+/*
+ * One benchmark of the bench kernel. fn is called once per iteration and
+ * timed on its own; setup and teardown, if set, run once around all calls.
+ */
+struct benchmark {
+    const char* name;
+    bench_fn_t fn;
+    bench_fn_t setup;
+    bench_fn_t teardown;
+    uint32_t iterations;        /* 0 for BENCH_ITERATIONS */
+    uint32_t cpus;              /* CPUs it needs at once, 0 for just this one */
+};
+
+/* Register a benchmark; the linker collects them into one table */
+#define BENCHMARK_FULL(bench_name, bench_fn, bench_setup, bench_teardown, bench_iterations) \
+    static const struct benchmark bench_entry_##bench_name                              \
+        __attribute__((used, section(".benchmarks"), aligned(4))) = {                   \
+        #bench_name, bench_fn, bench_setup, bench_teardown, bench_iterations, 0         \
+    }
+
+/*
+ * Register a benchmark that runs on bench_cpus CPUs at once through
+ * bench_run_on_cpus(). It is skipped with fewer CPUs online, and its result
+ * is dropped if a run got fewer, so an Ncpu name always means N CPUs.
+ */
+#define BENCHMARK_CPUS(bench_name, bench_fn, bench_setup, bench_teardown, bench_iterations, \
+                       bench_cpus)                                                      \
+    static const struct benchmark bench_entry_##bench_name                              \
+        __attribute__((used, section(".benchmarks"), aligned(4))) = {                   \
+        #bench_name, bench_fn, bench_setup, bench_teardown, bench_iterations, bench_cpus \
+    }
+
+#define BENCHMARK(name, fn) BENCHMARK_FULL(name, fn, 0, 0, 0)
+#define BENCHMARK_FIXTURE(name, fn, setup, teardown) BENCHMARK_FULL(name, fn, setup, teardown, 0)
+
+/* Make the compiler assume the memory behind p is read, so work on it stays */
+static inline void bench_use(const void* p) {
+    __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+/*
+ * Run fn(arg) on this CPU and up to cpus - 1 others at the same time, for
+ * scaling benchmarks. The other copies run with interrupts disabled and
+ * must not sleep, see smp_call().
+ * @return CPUs that took part
+ */
+uint32_t bench_run_on_cpus(uint32_t cpus, void (*fn)(void*), void* arg);
+
+/*
+ * Warm up and time every registered benchmark, print the results over the
+ * debug subsystem and leave QEMU through isa-debug-exit. Does not return.
+ */
+void bench_run_all(void) __attribute__((noreturn));
+
+#endif /* _KERNEL_BENCH_H */
@@ -0,0 +1,46 @@
+#ifndef _KERNEL_BOOTINFO_H
+#define _KERNEL_BOOTINFO_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Linear framebuffer set up by the bootloader */
+struct boot_framebuffer {
+    bool present;
+    uint64_t address;         /* Physical address */
+    uint32_t pitch;           /* Bytes per scanline */
+    uint32_t width;           /* Pixels */
+    uint32_t height;          /* Pixels */
+    uint8_t bpp;              /* Bits per pixel */
+    uint8_t type;             /* MULTIBOOT_FRAMEBUFFER_TYPE_* */
+    uint8_t red_position;
+    uint8_t red_size;
+    uint8_t green_position;
+    uint8_t green_size;
+    uint8_t blue_position;
+    uint8_t blue_size;
+};
+
+/* Largest RSDP layout (ACPI 2.0+) */
+#define BOOT_ACPI_RSDP_SIZE 36
+
+/* Copy of the ACPI root system description pointer */
+struct boot_acpi {
+    bool present;
+    uint32_t length;          /* Bytes of rsdp that are valid */
+    uint8_t rsdp[BOOT_ACPI_RSDP_SIZE];
+};
+
+/*
+ * Information copied out of the multiboot2 structure by validate_boot().
+ * The original structure is not reserved in the frame allocator, so
+ * anything needed after boot must be kept here.
+ */
+struct boot_info {
+    struct boot_framebuffer framebuffer;
+    struct boot_acpi acpi;
+};
+
+extern struct boot_info boot_info;
+
+#endif /* _KERNEL_BOOTINFO_H */
@@ -0,0 +1,57 @@
+#ifndef _KERNEL_BOOTPROF_H
+#define _KERNEL_BOOTPROF_H
+
+/*
+ * Boot phase profiling. boot.S stamps the TSC into boot_tsc_marks[] at each
+ * BOOT_MARK_* point, the first one being the very first instruction of
+ * multiboot_entry. Later phases are marked from C with bootprof_mark(). A
+ * phase lasts from its mark to the next one.
+ */
+#define BOOT_MARK_ENTRY         0   /* multiboot_entry, paging off */
+#define BOOT_MARK_PAGING        1   /* Bootstrap page tables built */
+#define BOOT_MARK_HIGHER_HALF   2   /* Running at 0xC0000000 */
+#define BOOT_MARK_BOOT_INFO     3
+#define BOOT_MARK_IDT           4
+#define BOOT_MARK_CONSTRUCTORS  5
+#define BOOT_MARK_TERMINAL      6
+#define BOOT_MARK_KERNEL_MAIN   7
+#define BOOT_EARLY_MARKS        8
+
+#ifndef ASM_FILE
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Most phases kernel_main can mark */
+#define BOOTPROF_MAX_MARKS 24
+
+/* Most phases bootprof_get_phases() returns */
+#define BOOTPROF_MAX_PHASES (1 + BOOT_EARLY_MARKS + BOOTPROF_MAX_MARKS + 1)
+
+struct bootprof_phase {
+    const char* name;
+    uint64_t cycles;
+};
+
+/* TSC values stored by boot.S, indexed by BOOT_MARK_* */
+extern uint64_t boot_tsc_marks[BOOT_EARLY_MARKS];
+
+/* Start a new phase called name; name must stay valid until the report */
+void bootprof_mark(const char* name);
+
+/*
+ * Get every phase so far: the firmware and bootloader, each marked phase
+ * with the last one running up to now (or to bootprof_report()), and the total
+ * @return Number of phases stored
+ */
+size_t bootprof_get_phases(struct bootprof_phase* phases, size_t max);
+
+/*
+ * Close the last phase and print every phase in cycles and microseconds
+ * through the debug subsystem. Microseconds need the TSC clocksource.
+ */
+void bootprof_report(void);
+
+#endif /* ASM_FILE */
+
+#endif /* _KERNEL_BOOTPROF_H */
@@ -0,0 +1,27 @@
+#ifndef _KERNEL_CLOCKEVENT_H
+#define _KERNEL_CLOCKEVENT_H
+
+#include <stdint.h>
+
+/*
+ * A hardware timer that raises one interrupt after a programmed delay.
+ * The timer core keeps it armed only for the next expiring timer, so an
+ * idle system with no timers takes no timer interrupts at all.
+ */
+struct clock_event_device {
+    const char* name;
+    uint32_t freq_hz;
+    uint32_t min_delta_ticks;
+    uint32_t max_delta_ticks;
+    uint32_t mult;              /* ticks = (ns * mult) >> shift */
+    uint32_t shift;
+    void (*set_next_event)(uint32_t ticks);
+};
+
+/* Make dev the timer core's event source; freq_hz and deltas must be set */
+void clockevent_register(struct clock_event_device* dev);
+
+/* Called from the device's interrupt handler */
+void clockevent_interrupt(void);
+
+#endif /* _KERNEL_CLOCKEVENT_H */
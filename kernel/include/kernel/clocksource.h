@@ -0,0 +1,48 @@
+#ifndef _KERNEL_CLOCKSOURCE_H
+#define _KERNEL_CLOCKSOURCE_H
+
+#include <stdint.h>
+
+#define NSEC_PER_SEC 1000000000ULL
+
+/*
+ * A free-running hardware counter the kernel can tell time with. Counters
+ * narrower than 64 bits wrap; ktime_get_ns() extends them in software, so
+ * it must be called at least once per wrap period of the current source.
+ */
+struct clocksource {
+    const char* name;
+    int rating;                 /* Higher is better, the best one is used */
+    uint64_t (*read)(void);     /* Current count, increasing */
+    uint64_t mask;              /* Valid bits of a count */
+    uint64_t freq_hz;           /* A TSC can run faster than 4.29 GHz */
+    uint32_t mult;              /* ns = (cycles * mult) >> shift */
+    uint32_t shift;
+    struct clocksource* next;
+};
+
+/* Add a counter with freq_hz set to the list of candidates */
+void clocksource_register(struct clocksource* cs);
+
+/* Switch to the best rated registered counter */
+void clocksource_select(void);
+
+/* Get the counter ktime_get_ns() reads, or NULL before time_init() */
+const struct clocksource* clocksource_current(void);
+
+/* Get a registered counter by name, or NULL if it was not found */
+const struct clocksource* clocksource_get(const char* name);
+
+/* Convert a count of cs ticks to nanoseconds */
+uint64_t clocksource_cycles_to_ns(const struct clocksource* cs, uint64_t cycles);
+
+/* Nanoseconds since the first clocksource was selected */
+uint64_t ktime_get_ns(void);
+
+/*
+ * Probe the platform timers, calibrate the TSC, pick a clocksource and
+ * register the clock event device used by the timer wheel
+ */
+void time_init(void);
+
+#endif /* _KERNEL_CLOCKSOURCE_H */
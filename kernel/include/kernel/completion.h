@@ -0,0 +1,35 @@
+#ifndef _KERNEL_COMPLETION_H
+#define _KERNEL_COMPLETION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <kernel/wait.h>
+
+/*
+ * A count of events that threads can sleep on: wait_for_completion()
+ * consumes one, sleeping until complete() provides it. complete_all()
+ * lets every present and future waiter through. complete() may be called
+ * from interrupt handlers.
+ */
+struct completion {
+    uint32_t done;
+    struct wait_queue wait;
+};
+
+#define COMPLETION_INIT { 0, WAIT_QUEUE_INIT }
+
+void completion_init(struct completion* completion);
+
+/* Wake the oldest waiter, or let the next wait_for_completion() through */
+void complete(struct completion* completion);
+
+/* Wake every waiter and let all later waits through */
+void complete_all(struct completion* completion);
+
+/* Sleep until the completion is signalled, then consume one signal */
+void wait_for_completion(struct completion* completion);
+
+/* Consume a signal without sleeping; false if there was none */
+bool try_wait_for_completion(struct completion* completion);
+
+#endif /* _KERNEL_COMPLETION_H */
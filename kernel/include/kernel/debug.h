@@ -33,6 +33,9 @@ void debug_set_target(int target);
 /* Get the current debug output target */
 int debug_get_target(void);
 
+/* Release the output locks whoever holds them; for panic only */
+void debug_break_locks(void);
+
 /* Debug output functions for different levels */
 void debug_error(const char* format, ...);
 void debug_warning(const char* format, ...);
@@ -50,8 +53,4 @@ void debug_vprint(const char* format, va_list args);
 /* Function to output a buffer as hex bytes (for memory dumps) */
 void debug_hex_dump(const void* data, size_t size);
 
-/* Custom implementations of snprintf and vsnprintf for minimal dependencies */
-int vsnprintf(char* str, size_t size, const char* format, va_list args);
-int snprintf(char* str, size_t size, const char* format, ...);
-
 #endif /* _KERNEL_DEBUG_H */
@@ -0,0 +1,70 @@
+#ifndef _KERNEL_FRAME_H
+#define _KERNEL_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Physical memory managed by the frame allocator */
+#define FRAME_MEMORY_MB 64
+#define FRAME_SIZE      4096
+#define FRAME_COUNT     (FRAME_MEMORY_MB * 1024 * 1024 / FRAME_SIZE)
+
+/* Mark every frame free */
+void frame_init(void);
+
+/* Mark the frames overlapping [start, end) as used */
+void frame_reserve_range(uint32_t start, uint32_t end);
+
+/*
+ * Allocate a frame. Returns its physical address, or 0 when memory is
+ * exhausted; frame 0 is always reserved, so 0 is never a valid frame.
+ */
+uint32_t frame_alloc(void);
+
+/* Return a frame to the allocator */
+void frame_free(uint32_t frame_addr);
+
+/*
+ * Allocate up to count frames into frames[] and return how many were
+ * allocated, or free count frames, taking the frame lock once either way
+ */
+uint32_t frame_alloc_batch(uint32_t* frames, uint32_t count);
+void frame_free_batch(const uint32_t* frames, uint32_t count);
+
+/* Whether the frame holding frame_addr is in use */
+bool frame_is_used(uint32_t frame_addr);
+
+/* Number of frames in use, including those held in per-CPU caches */
+uint32_t frame_used_count(void);
+
+/*
+ * Per-CPU frame caches (frame_cache.c). Each CPU keeps a stack of free
+ * frames; frame_cache_alloc() and frame_cache_free() work on the calling
+ * CPU's stack with interrupts off and no lock. When the stack falls to the
+ * low watermark it is refilled with a batch from the frame allocator, and
+ * when it reaches the high watermark a batch is handed back, so the frame
+ * lock is taken once per batch rather than once per frame.
+ */
+#define FRAME_CACHE_SIZE  128   /* Most frames one CPU can hold */
+#define FRAME_CACHE_LOW   0     /* Default watermarks and batch size */
+#define FRAME_CACHE_HIGH  96
+#define FRAME_CACHE_BATCH 32
+
+/* Same contract as frame_alloc() and frame_free() */
+uint32_t frame_cache_alloc(void);
+void frame_cache_free(uint32_t frame_addr);
+
+/*
+ * Set the watermarks and batch size of every CPU's cache. Needs
+ * 0 < batch, low + batch <= high <= FRAME_CACHE_SIZE; returns false and
+ * changes nothing otherwise.
+ */
+bool frame_cache_tune(uint32_t low, uint32_t high, uint32_t batch);
+
+/* Give every frame cached by the calling CPU back to the frame allocator */
+void frame_cache_drain(void);
+
+/* Frames held in all CPUs' caches */
+uint32_t frame_cache_count(void);
+
+#endif /* _KERNEL_FRAME_H */
@@ -0,0 +1,52 @@
+#ifndef _KERNEL_IDLE_H
+#define _KERNEL_IDLE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <kernel/percpu.h>
+
+/*
+ * Waiting for work with nothing to run. cpu_idle() halts the calling CPU
+ * until an interrupt, or with MONITOR/MWAIT until a write to a watched word
+ * as well, and counts the cycles it spent halted. Everything else a CPU
+ * does between coming online and now counts as busy.
+ */
+
+/* Find out how CPUs can wait; before smp_init() */
+void idle_init(void);
+
+/*
+ * Halt until woken. Call with interrupts disabled after finding nothing to
+ * do; they are enabled on return. With MWAIT, a store to the 32-bit word at
+ * watch ends the wait without an interrupt if the word was zero, so it can
+ * be a flag the waker sets; NULL waits for an interrupt only.
+ */
+void cpu_idle(const volatile void* watch);
+
+/* Whether cpu_idle() uses MWAIT rather than HLT */
+bool cpu_idle_mwait(void);
+
+/*
+ * TSC cycles a CPU has been busy and idle since it came online, counting a
+ * halt in progress
+ * @return false if there is no such CPU or it is offline
+ */
+bool cpu_times(uint32_t index, uint64_t* busy, uint64_t* idle);
+
+/* Share of busy + idle that was busy, 0 to 100 */
+uint32_t cpu_busy_percent(uint64_t busy, uint64_t idle);
+
+/* Out of line part of idle_account() */
+void idle_account_end(void);
+
+/*
+ * Close the idle period of an interrupt that ended a halt, so the handler's
+ * time counts as busy. Called first thing by the interrupt dispatcher.
+ */
+static inline void idle_account(void) {
+    if (this_cpu_read(idle_start)) {
+        idle_account_end();
+    }
+}
+
+#endif /* _KERNEL_IDLE_H */
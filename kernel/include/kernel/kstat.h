@@ -0,0 +1,84 @@
+#ifndef _KERNEL_KSTAT_H
+#define _KERNEL_KSTAT_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Kernel statistics. Each counter is a static struct kstat placed in the
+ * .kstat section, so the registry is simply every object the linker put
+ * there and counters need no registration call. The value lives in the
+ * per-CPU area: a counter's place in the section is its slot in every
+ * struct cpu's kstats[], and counting is a %gs-relative add and adc to the
+ * calling CPU's slot, with no lock and no cache line shared between CPUs.
+ * kstat_read() sums the slots. The host build has no per-CPU data and keeps
+ * the value in the struct.
+ */
+#ifdef REDOS_HOST
+
+struct kstat {
+    uint64_t value;
+    const char* name;       /* "subsystem.counter" */
+} __attribute__((aligned(8)));
+
+#define KSTAT_INIT(subsys, name) { 0, #subsys "." #name }
+
+/* Add n to a counter */
+#define kstat_add(subsys, name, n) (kstat_##subsys##_##name.value += (n))
+
+#else
+
+#include <kernel/percpu.h>
+
+/* 8 bytes, so a counter's byte offset in .kstat is its offset in kstats[] */
+struct kstat {
+    const char* name;       /* "subsystem.counter" */
+} __attribute__((aligned(8)));
+
+#define KSTAT_INIT(subsys, name) { #subsys "." #name }
+
+/* Start of the .kstat section, from the linker script */
+extern struct kstat __kstat_start[];
+
+static inline void __kstat_add(struct kstat* stat, uint64_t n) {
+    uint32_t slot = (uint32_t)stat - (uint32_t)__kstat_start;
+    __asm__ volatile("addl %%eax, %%gs:%c1(%2)\n\t"
+                     "adcl %%edx, %%gs:%c1+4(%2)"
+                     : : "A"(n), "i"(__percpu_offset(kstats)), "r"(slot) : "memory", "cc");
+}
+
+/* Add n to the calling CPU's slot of a counter */
+#define kstat_add(subsys, name, n) __kstat_add(&kstat_##subsys##_##name, (n))
+
+#endif /* REDOS_HOST */
+
+/* Define the counter subsys.name at file scope */
+#define KSTAT_DEFINE(subsys, name) \
+    __attribute__((section(".kstat"), used)) \
+    struct kstat kstat_##subsys##_##name = KSTAT_INIT(subsys, name)
+
+/* Declare a counter defined in another file */
+#define KSTAT_DECLARE(subsys, name) extern struct kstat kstat_##subsys##_##name
+
+/* Add one to a counter */
+#define kstat_inc(subsys, name) kstat_add(subsys, name, 1)
+
+/* Number of counters in the registry */
+size_t kstat_count(void);
+
+/* Counter at index, 0 <= index < kstat_count(), in link order */
+const struct kstat* kstat_at(size_t index);
+
+/* Counter called name, or NULL */
+const struct kstat* kstat_find(const char* name);
+
+/* Value of a counter, summed over every CPU */
+uint64_t kstat_read(const struct kstat* stat);
+
+/* Zero every counter */
+void kstat_reset(void);
+
+/* Print every counter through the debug subsystem, sorted by name */
+void kstat_dump(void);
+
+#endif /* _KERNEL_KSTAT_H */
@@ -0,0 +1,31 @@
+#ifndef _KERNEL_KSYMS_H
+#define _KERNEL_KSYMS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * Function symbols of the running kernel, generated by scripts/ksyms.py
+ * from the first link of redos.kernel and linked into the second.
+ */
+struct ksym_table {
+    uint32_t count;
+    uint32_t end;                   /* End of the last function */
+    const uint32_t* addresses;      /* Sorted */
+    const uint32_t* name_offsets;   /* Into names, one per address */
+    const char* names;
+};
+
+/*
+ * Find the function holding an address
+ * @param addr Code address
+ * @param offset If not NULL, set to the distance from the function start
+ * @return Function name, or NULL if addr is not in a known function or the
+ *         kernel was linked without a symbol table
+ */
+const char* ksym_lookup(uintptr_t addr, uint32_t* offset);
+
+/* Number of symbols in the table, 0 without one */
+size_t ksym_count(void);
+
+#endif /* _KERNEL_KSYMS_H */
@@ -0,0 +1,58 @@
+#ifndef _KERNEL_MATH64_H
+#define _KERNEL_MATH64_H
+
+#include <stdint.h>
+
+/*
+ * 64-bit arithmetic helpers built from 32-bit operations, so hot paths do
+ * not end up in libgcc's generic 64-bit division routines.
+ */
+
+/* Divide a 64-bit value by a 32-bit one */
+static inline uint64_t div_u64_u32(uint64_t dividend, uint32_t divisor) {
+#if defined(__i386__)
+    uint32_t high = (uint32_t)(dividend >> 32);
+    uint32_t low = (uint32_t)dividend;
+    uint32_t quot_high = high / divisor;
+    uint32_t rem = high % divisor;
+    uint32_t quot_low;
+
+    // rem < divisor, so the 64/32 divide of rem:low cannot overflow
+    __asm__("divl %4" : "=a"(quot_low), "=d"(rem) : "a"(low), "d"(rem), "rm"(divisor));
+    return ((uint64_t)quot_high << 32) | quot_low;
+#else
+    return dividend / divisor;
+#endif
+}
+
+/*
+ * Divide by a 64-bit value. Both are scaled down until the divisor fits in
+ * 32 bits, so the result is exact below that and otherwise off by less
+ * than one part in 2^31. A zero divisor gives 0.
+ */
+static inline uint64_t div_u64_u64_approx(uint64_t dividend, uint64_t divisor) {
+    while (divisor > 0xFFFFFFFFULL) {
+        dividend >>= 1;
+        divisor >>= 1;
+    }
+    return divisor ? div_u64_u32(dividend, (uint32_t)divisor) : 0;
+}
+
+/* Compute (value * mult) >> shift without losing the high bits of the product */
+static inline uint64_t mul_u64_u32_shr(uint64_t value, uint32_t mult, unsigned int shift) {
+    uint64_t low = (uint64_t)(uint32_t)value * mult;
+    uint64_t high = (uint64_t)(uint32_t)(value >> 32) * mult;
+
+    if (shift == 0) {
+        return low + (high << 32);
+    }
+    return (low >> shift) + (shift <= 32 ? high << (32 - shift) : high >> (shift - 32));
+}
+
+/* Index of the lowest set bit of a non-zero value */
+static inline unsigned int ctz_u64(uint64_t value) {
+    uint32_t low = (uint32_t)value;
+    return low ? (unsigned int)__builtin_ctz(low) : 32 + (unsigned int)__builtin_ctz((uint32_t)(value >> 32));
+}
+
+#endif /* _KERNEL_MATH64_H */
@@ -0,0 +1,56 @@
+#ifndef _KERNEL_MUTEX_H
+#define _KERNEL_MUTEX_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <kernel/wait.h>
+
+struct thread;
+
+/*
+ * A sleeping lock for threads. Taking a free mutex or releasing one nobody
+ * waits for is a single atomic instruction; only contention touches the
+ * wait queue, as with a futex. Not for interrupt handlers, and the thread
+ * that locked it must be the one to unlock it.
+ */
+struct mutex {
+    uint32_t state;             /* MUTEX_UNLOCKED, _LOCKED or _CONTENDED */
+    struct thread* owner;
+    struct wait_queue wait;
+};
+
+#define MUTEX_UNLOCKED  0
+#define MUTEX_LOCKED    1       /* Held, nobody waiting */
+#define MUTEX_CONTENDED 2       /* Held, threads may be waiting */
+
+#define MUTEX_INIT { MUTEX_UNLOCKED, 0, WAIT_QUEUE_INIT }
+#define DEFINE_MUTEX(name) struct mutex name = MUTEX_INIT
+
+void mutex_init(struct mutex* mutex);
+
+/* Take the mutex, sleeping while another thread holds it */
+void mutex_lock(struct mutex* mutex);
+
+/* Take the mutex only if it is free; true if taken */
+bool mutex_trylock(struct mutex* mutex);
+
+void mutex_unlock(struct mutex* mutex);
+
+/*
+ * A counting semaphore: sem_down() takes one of count units, sleeping
+ * until there is one, and sem_up() returns one, also from interrupt
+ * handlers.
+ */
+struct semaphore {
+    uint32_t count;
+    struct wait_queue wait;
+};
+
+#define SEMAPHORE_INIT(count) { (count), WAIT_QUEUE_INIT }
+
+void sem_init(struct semaphore* sem, uint32_t count);
+void sem_down(struct semaphore* sem);
+bool sem_try_down(struct semaphore* sem);
+void sem_up(struct semaphore* sem);
+
+#endif /* _KERNEL_MUTEX_H */
@@ -2,6 +2,7 @@
 #define _KERNEL_PANIC_H
 
 #include <stdint.h>
+#include <interrupts.h>
 
 /**
  * Kernel panic function - prints a message and halts the system
@@ -25,10 +26,9 @@ void dump_registers(void);
 
 /**
  * Exception handler for CPU exceptions
- * @param exception_number The CPU exception number
- * @param error_code The error code associated with the exception (if any)
+ * @param frame Registers at the fault, including the vector and error code
  */
 __attribute__((noreturn))
-void exception_handler(uint32_t exception_number, uint32_t error_code);
+void exception_handler(const struct interrupt_frame* frame);
 
 #endif /* _KERNEL_PANIC_H */
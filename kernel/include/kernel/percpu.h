@@ -0,0 +1,101 @@
+#ifndef _KERNEL_PERCPU_H
+#define _KERNEL_PERCPU_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/smp.h>
+
+/*
+ * Every CPU loads GS with a segment whose base is its own struct cpu, so a
+ * field of the calling CPU's block is one %gs-relative access: no CPU ID
+ * lookup, and no lock, because only the owning CPU writes it and a single
+ * instruction cannot be split by an interrupt. Fields must be scalars of
+ * 1, 2, 4 or 8 bytes; 8-byte fields take two instructions to read or write.
+ */
+
+#define __percpu_offset(field) offsetof(struct cpu, field)
+
+/* Holds a field's value and its raw bits, so no branch needs a cast */
+#define __percpu_union(field)               \
+    union {                                 \
+        __typeof__(((struct cpu*)0)->field) value; \
+        uint8_t b;                          \
+        uint16_t w;                         \
+        uint32_t l;                         \
+        uint64_t q;                         \
+    }
+
+#define this_cpu_read(field) ({                                                     \
+    __percpu_union(field) __u;                                                      \
+    switch (sizeof(__u.value)) {                                                    \
+    case 1:                                                                         \
+        __asm__ volatile("movb %%gs:%c1, %0" : "=q"(__u.b) : "i"(__percpu_offset(field))); \
+        break;                                                                      \
+    case 2:                                                                         \
+        __asm__ volatile("movw %%gs:%c1, %0" : "=r"(__u.w) : "i"(__percpu_offset(field))); \
+        break;                                                                      \
+    case 4:                                                                         \
+        __asm__ volatile("movl %%gs:%c1, %0" : "=r"(__u.l) : "i"(__percpu_offset(field))); \
+        break;                                                                      \
+    default:                                                                        \
+        __asm__ volatile("movl %%gs:%c1, %%eax\n\t"                                 \
+                         "movl %%gs:%c1+4, %%edx"                                   \
+                         : "=A"(__u.q) : "i"(__percpu_offset(field)));              \
+        break;                                                                      \
+    }                                                                               \
+    __u.value;                                                                      \
+})
+
+#define this_cpu_write(field, val) do {                                             \
+    __percpu_union(field) __u;                                                      \
+    __u.value = (val);                                                              \
+    switch (sizeof(__u.value)) {                                                    \
+    case 1:                                                                         \
+        __asm__ volatile("movb %0, %%gs:%c1" : : "qi"(__u.b), "i"(__percpu_offset(field)) : "memory"); \
+        break;                                                                      \
+    case 2:                                                                         \
+        __asm__ volatile("movw %0, %%gs:%c1" : : "ri"(__u.w), "i"(__percpu_offset(field)) : "memory"); \
+        break;                                                                      \
+    case 4:                                                                         \
+        __asm__ volatile("movl %0, %%gs:%c1" : : "ri"(__u.l), "i"(__percpu_offset(field)) : "memory"); \
+        break;                                                                      \
+    default:                                                                        \
+        __asm__ volatile("movl %%eax, %%gs:%c1\n\t"                                 \
+                         "movl %%edx, %%gs:%c1+4"                                   \
+                         : : "A"(__u.q), "i"(__percpu_offset(field)) : "memory");  \
+        break;                                                                      \
+    }                                                                               \
+} while (0)
+
+/*
+ * Add to an integer field. The 8-byte form is add then adc; an interrupt
+ * between them adds with its own carry and iret restores ours, so no update
+ * is lost.
+ */
+#define this_cpu_add(field, n) do {                                                 \
+    switch (sizeof(((struct cpu*)0)->field)) {                                      \
+    case 1:                                                                         \
+        __asm__ volatile("addb %0, %%gs:%c1" : : "qi"((uint8_t)(n)), "i"(__percpu_offset(field)) : "memory", "cc"); \
+        break;                                                                      \
+    case 2:                                                                         \
+        __asm__ volatile("addw %0, %%gs:%c1" : : "ri"((uint16_t)(n)), "i"(__percpu_offset(field)) : "memory", "cc"); \
+        break;                                                                      \
+    case 4:                                                                         \
+        __asm__ volatile("addl %0, %%gs:%c1" : : "ri"((uint32_t)(n)), "i"(__percpu_offset(field)) : "memory", "cc"); \
+        break;                                                                      \
+    default:                                                                        \
+        __asm__ volatile("addl %%eax, %%gs:%c1\n\t"                                 \
+                         "adcl %%edx, %%gs:%c1+4"                                   \
+                         : : "A"((uint64_t)(n)), "i"(__percpu_offset(field)) : "memory", "cc"); \
+        break;                                                                      \
+    }                                                                               \
+} while (0)
+
+#define this_cpu_inc(field) this_cpu_add(field, 1)
+
+/* The calling CPU's block, for passing around or reading another field */
+static inline struct cpu* this_cpu_ptr(void) {
+    return this_cpu_read(self);
+}
+
+#endif /* _KERNEL_PERCPU_H */
@@ -0,0 +1,56 @@
+#ifndef _KERNEL_PROFILER_H
+#define _KERNEL_PROFILER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Samples the buffer holds; later samples are counted as dropped */
+#define PROFILER_MAX_SAMPLES 4096
+
+/* Return addresses recorded per sample, besides the interrupted EIP */
+#define PROFILER_MAX_DEPTH 8
+
+/* Sampling rate used when none is configured */
+#ifndef PROFILER_HZ
+#define PROFILER_HZ 1024
+#endif
+
+/* Frame pointer backtraces need a kernel built with KERNEL_FRAME_POINTERS */
+#ifdef KERNEL_FRAME_POINTERS
+#define PROFILER_BACKTRACE true
+#else
+#define PROFILER_BACKTRACE false
+#endif
+
+/* Overhead of sampling, as measured by profiler_measure_overhead() */
+struct profiler_overhead {
+    uint32_t hz;                    /* Rate actually used */
+    uint32_t samples;               /* Samples taken during the measurement */
+    uint64_t cycles_per_sample;     /* Mean TSC cycles spent in the handler */
+    uint32_t slowdown_permille;     /* Loss of work done, in 1/1000 */
+};
+
+/*
+ * Start sampling the interrupted EIP, and with backtrace the return
+ * addresses found by walking the frame pointer chain, hz times a second.
+ * The buffer is emptied first. The rate is rounded up to a power of two.
+ * @return false if the profiler is already running
+ */
+bool profiler_start(uint32_t hz, bool backtrace);
+
+/* Stop sampling; the samples stay in the buffer until the next start */
+void profiler_stop(void);
+
+/*
+ * Write the samples to COM1 as "profile-*" lines for scripts/profile.py,
+ * along with the handler cost. Safe to call while sampling.
+ */
+void profiler_dump(void);
+
+/*
+ * Run the same busy loop with the profiler off and on and report how much
+ * slower it got and how long each sample took. The profiler must be stopped.
+ */
+void profiler_measure_overhead(uint32_t hz, bool backtrace, struct profiler_overhead* result);
+
+#endif /* _KERNEL_PROFILER_H */
@@ -0,0 +1,77 @@
+#ifndef _KERNEL_RCU_H
+#define _KERNEL_RCU_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <kernel/sched.h>
+
+/* How often pending callbacks are checked when the CPU does not go idle */
+#define RCU_POLL_NS 1000000ULL
+
+/*
+ * Read-copy-update for read-mostly data. Readers take no lock and write
+ * nothing shared:
+ *
+ *     rcu_read_lock();
+ *     const struct config* config = rcu_dereference(current_config);
+ *     ... use config ...
+ *     rcu_read_unlock();
+ *
+ * A writer publishes a new copy with rcu_assign_pointer() and frees the
+ * old one after a grace period, with synchronize_rcu() or call_rcu(), by
+ * when every reader that could have seen it has finished.
+ *
+ * Quiescent-state based: a reader only holds off preemption, so a CPU
+ * that switches threads or sits in its idle loop is outside any reader.
+ * A grace period ends once every online CPU has done either since it
+ * started. Readers must not sleep; they may run in interrupt handlers.
+ */
+
+struct rcu_head;
+typedef void (*rcu_callback_t)(struct rcu_head* head);
+
+/* Embed in an object to free it with call_rcu() */
+struct rcu_head {
+    struct rcu_head* next;
+    rcu_callback_t func;
+};
+
+static inline void rcu_read_lock(void) {
+    preempt_disable();
+}
+
+static inline void rcu_read_unlock(void) {
+    preempt_enable();
+}
+
+/* Read a pointer published with rcu_assign_pointer(), inside a reader */
+#define rcu_dereference(p) __atomic_load_n(&(p), __ATOMIC_CONSUME)
+
+/* Publish p = v once everything v points at is initialized */
+#define rcu_assign_pointer(p, v) __atomic_store_n(&(p), (v), __ATOMIC_RELEASE)
+
+void rcu_init(void);
+
+/*
+ * Call func(head) after a grace period. Safe from interrupt handlers and
+ * from readers, on the bootstrap processor. Callbacks run in batches from
+ * the idle loop, or from the timer interrupt if the CPU stays busy, so
+ * they must not sleep.
+ */
+void call_rcu(struct rcu_head* head, rcu_callback_t func);
+
+/* Sleep until a grace period has passed; thread context, outside readers */
+void synchronize_rcu(void);
+
+/* Quiescent state hooks for the scheduler and idle loops */
+void rcu_note_context_switch(void);
+void rcu_idle_work(void);
+
+/*
+ * Bracket a halt outside any reader on a CPU that does not schedule, so
+ * grace periods need not wait for it to wake up
+ */
+void rcu_idle_enter(void);
+void rcu_idle_exit(void);
+
+#endif /* _KERNEL_RCU_H */
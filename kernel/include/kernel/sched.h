@@ -0,0 +1,144 @@
+#ifndef _KERNEL_SCHED_H
+#define _KERNEL_SCHED_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <kernel/percpu.h>
+#include <kernel/timer.h>
+
+/* Stack of each kernel thread, with as much unmapped guard space below it */
+#define KTHREAD_STACK_SIZE 0x4000
+
+/* Longest a thread runs before others that are runnable get the CPU */
+#define SCHED_SLICE_NS 10000000ULL
+
+#define KTHREAD_NAME_SIZE 16
+
+/* Priority levels, 0 the most urgent; there is one FIFO run queue per level */
+#define SCHED_PRIORITIES 32
+#define SCHED_PRIORITY_DEFAULT 16
+
+/* Levels a thread that keeps blocking before its slice ends is raised by */
+#define SCHED_BOOST_MAX 4
+
+enum thread_state {
+    THREAD_RUNNING,         /* On the CPU */
+    THREAD_RUNNABLE,        /* On the run queue */
+    THREAD_SLEEPING,        /* Waiting for its sleep timer */
+    THREAD_DEAD,            /* Exited, stack not freed yet */
+};
+
+typedef void (*kthread_fn_t)(void* arg);
+
+struct thread {
+    uint32_t esp;               /* Saved by switch_to(), must stay first */
+    struct thread* next;        /* Run queue or dead list link */
+    struct thread* all_next;    /* Every thread, for sched_dump() */
+    enum thread_state state;
+    uint32_t id;
+    uint8_t base_priority;      /* Set by kthread_set_priority() */
+    uint8_t priority;           /* Current level, base minus any I/O boost */
+    char name[KTHREAD_NAME_SIZE];
+    uint32_t stack_base;        /* Lowest address of the stack */
+    uint32_t stack_top;
+    kthread_fn_t fn;
+    void* arg;
+    struct timer sleep_timer;
+    uint64_t switches;          /* Times switched to */
+    uint64_t cpu_cycles;        /* TSC cycles spent running */
+    uint64_t run_start;         /* TSC when last switched to */
+};
+
+/*
+ * Turn the boot code into the "main" thread and create the idle thread.
+ * Threads start running once interrupts are enabled.
+ */
+void sched_init(void);
+
+/*
+ * Create a thread running fn(arg) on a new stack at SCHED_PRIORITY_DEFAULT.
+ * It is runnable at once and exits when fn returns. Must be called from
+ * thread context.
+ * @return The thread, or NULL if no stack could be allocated
+ */
+struct thread* kthread_create(const char* name, kthread_fn_t fn, void* arg);
+
+/*
+ * Drop any boost and let the other runnable threads at the caller's level,
+ * and any more urgent ones, run before the caller continues
+ */
+void kthread_yield(void);
+
+/* Sleep for at least ns nanoseconds */
+void kthread_sleep(uint64_t ns);
+
+/*
+ * Sleep until sched_wakeup(). Call with interrupts disabled, after making
+ * the thread findable by whoever will wake it; they stay disabled on return.
+ */
+void kthread_block(void);
+
+/* As kthread_block(), waking by itself after ns if nobody else does */
+void kthread_block_timeout(uint64_t ns);
+
+/*
+ * Change a thread's base priority, dropping any boost. A thread made more
+ * urgent than the caller runs at once.
+ */
+void kthread_set_priority(struct thread* thread, uint8_t priority);
+
+/*
+ * Block the calling thread for good, for one that cannot exit such as
+ * kernel_main()'s once it returns
+ */
+void kthread_park(void) __attribute__((noreturn));
+
+/* End the calling thread; its stack is freed later from thread context */
+void kthread_exit(void) __attribute__((noreturn));
+
+/* The thread running on this CPU */
+struct thread* kthread_current(void);
+
+/*
+ * Make a sleeping thread runnable, one level above its last priority up to
+ * SCHED_BOOST_MAX above its base. Safe from interrupt handlers; from thread
+ * context a more urgent thread runs before this returns.
+ */
+void sched_wakeup(struct thread* thread);
+
+/* Called on the way out of every hardware interrupt to preempt if asked */
+void sched_irq_exit(void);
+
+/* Switch threads now if a preemption was held off; see preempt_enable() */
+void sched_preempt(void);
+
+/*
+ * Keep the calling thread on the CPU until preempt_enable(): wakeups and
+ * the end of a time slice only take effect then. Interrupts still run.
+ * Nests; the thread must not sleep or yield in between.
+ */
+static inline void preempt_disable(void) {
+    this_cpu_inc(preempt_count);
+    __asm__ volatile("" ::: "memory");
+}
+
+static inline void preempt_enable(void) {
+    __asm__ volatile("" ::: "memory");
+    this_cpu_add(preempt_count, -1);
+    if (this_cpu_read(preempt_count) == 0 && this_cpu_read(need_resched)) {
+        sched_preempt();
+    }
+}
+
+/*
+ * Map a KTHREAD_STACK_SIZE stack with an unmapped guard below it, for
+ * threads and for the boot stacks of other CPUs
+ * @return Lowest address of the stack, or 0 if none is left
+ */
+uint32_t kstack_alloc(void);
+void kstack_free(uint32_t base);
+
+/* Print every thread with its priority and CPU time through the debug subsystem */
+void sched_dump(void);
+
+#endif /* _KERNEL_SCHED_H */
@@ -0,0 +1,76 @@
+#ifndef _KERNEL_SMP_H
+#define _KERNEL_SMP_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <gdt.h>
+
+/* Most CPUs the kernel brings up */
+#define SMP_MAX_CPUS 16
+
+/* Most counters defined with KSTAT_DEFINE(), checked by linker.ld */
+#define KSTAT_MAX 128
+
+struct thread;
+
+/*
+ * State of one CPU, CPU 0 being the bootstrap processor. It is also the
+ * CPU's per-CPU area: GS points at it, see <kernel/percpu.h>.
+ */
+struct cpu {
+    struct cpu* self;           /* For this_cpu_ptr() */
+    struct thread* current;     /* Thread running here */
+    uint32_t index;
+    uint8_t apic_id;
+    volatile bool online;
+    uint32_t stack_base;        /* Stack the CPU entered the kernel on */
+    uint32_t stack_top;
+    uint64_t online_tsc;        /* TSC when it reached its idle loop */
+    uint64_t irqs;              /* Hardware interrupts taken */
+    uint64_t context_switches;
+    uint32_t preempt_count;     /* preempt_disable() depth */
+    volatile bool need_resched; /* Switch threads at the next chance */
+    uint32_t rcu_qs_seq;        /* Grace period of the last quiescent state */
+    volatile bool rcu_idle;     /* Halted outside RCU readers, always quiescent */
+    uint32_t idle_seq;          /* Odd while the two below are updated */
+    uint64_t idle_cycles;       /* TSC cycles spent halted in cpu_idle() */
+    uint64_t idle_start;        /* TSC when it last halted, 0 while busy */
+    volatile bool idle_watching;    /* In MWAIT: a write to its watch word wakes it */
+    void (*volatile call_fn)(void*);    /* Work from smp_call(), NULL when idle */
+    void* call_arg;
+    uint64_t kstats[KSTAT_MAX]; /* This CPU's part of each kstat counter */
+    struct gdt_entry gdt[GDT_ENTRIES];
+    struct gdt_ptr gdt_ptr;
+};
+
+/*
+ * Find the CPUs in the ACPI MADT, enable the local APIC and start every
+ * application processor through the real-mode trampoline. Each one loads
+ * its own GDT and halts in an idle loop until smp_call() gives it work.
+ */
+void smp_init(void);
+
+/* CPUs the firmware lists as enabled, at least 1 */
+uint32_t smp_cpu_count(void);
+
+/* CPUs that reached their idle loop, the bootstrap processor included */
+uint32_t smp_online_count(void);
+
+/* CPU by index, or NULL past smp_cpu_count() */
+struct cpu* smp_cpu(uint32_t index);
+
+/*
+ * Run fn(arg) on the application processor index, which must be online and
+ * idle. It runs with interrupts disabled and must not sleep or return to a
+ * scheduler; the processors do not run threads. Returns false if the CPU
+ * is offline, already busy, or could not be woken.
+ */
+bool smp_call(uint32_t index, void (*fn)(void*), void* arg);
+
+/* Wait until the work passed to smp_call() on CPU index has returned */
+void smp_call_wait(uint32_t index);
+
+/* Print the state and counters of every CPU through the debug subsystem */
+void smp_dump(void);
+
+#endif /* _KERNEL_SMP_H */
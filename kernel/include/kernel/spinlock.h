@@ -0,0 +1,244 @@
+#ifndef _KERNEL_SPINLOCK_H
+#define _KERNEL_SPINLOCK_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#ifndef REDOS_HOST
+#include <interrupts.h>
+#endif
+
+/*
+ * Two spinlocks with the same shape of API:
+ *
+ *   struct spinlock    ticket lock, two 16-bit counters. Waiters take a
+ *                      ticket and are served in order, all spinning on the
+ *                      one cache line. Cheap and fair; the default.
+ *   struct mcs_lock    MCS queue lock. Each waiter spins on a flag in its
+ *                      own node, passed in by the caller, so a contended
+ *                      handoff touches one remote line instead of every
+ *                      waiter's. For locks that may be hammered by many CPUs.
+ *
+ * There is no preemption count: a thread holding a spinlock must not be
+ * switched out, so every lock that is also taken with interrupts enabled
+ * must go through the _irqsave forms. spin_lock()/mcs_lock() are for code
+ * already running with interrupts off, such as IRQ handlers and timer
+ * callbacks. Neither lock is recursive.
+ *
+ * With KERNEL_LOCKSTAT each lock names a struct lock_class, kept in the
+ * .lockstat section like kstat counters, which counts acquisitions,
+ * contended acquisitions, cycles spent spinning and hold times. The counts
+ * are atomic, so one class can describe every lock initialized at a site.
+ */
+
+#ifdef KERNEL_LOCKSTAT
+
+struct lock_class {
+    const char* name;
+    uint64_t acquisitions;
+    uint64_t contended;         /* Acquisitions that had to wait */
+    uint64_t spin_cycles;       /* TSC cycles spent waiting, all acquisitions */
+    uint64_t hold_cycles;       /* TSC cycles held, all acquisitions */
+    uint64_t max_hold_cycles;
+} __attribute__((aligned(64)));     /* A line each, and an array in .lockstat */
+
+#define LOCK_CLASS_DEFINE(class_name, lock_name) \
+    __attribute__((section(".lockstat"), used)) \
+    static struct lock_class class_name = { lock_name, 0, 0, 0, 0, 0 }
+
+/* Called by the lock code once it owns the lock */
+void lockstat_acquired(struct lock_class* class, bool contended, uint64_t wait_start);
+
+/* Called by the lock code just before it releases the lock */
+void lockstat_release(struct lock_class* class, uint64_t acquired);
+
+/* Number of lock classes, and each one in link order */
+uint32_t lockstat_count(void);
+const struct lock_class* lockstat_at(uint32_t index);
+
+/* Print every lock class through the debug subsystem */
+void lockstat_dump(void);
+
+/* Zero every class, for measuring one phase */
+void lockstat_reset(void);
+
+static inline uint64_t lockstat_now(void) {
+    return __builtin_ia32_rdtsc();
+}
+
+/* The class of every lock initialized where this is expanded */
+#define __lock_class_here(lock_name) ({ \
+    LOCK_CLASS_DEFINE(__class, lock_name); \
+    &__class; \
+})
+
+#endif /* KERNEL_LOCKSTAT */
+
+/* Spin-wait hint, also a compiler barrier */
+static inline void cpu_relax(void) {
+    __asm__ volatile("pause" ::: "memory");
+}
+
+/* Interrupt masking used by the _irqsave forms; host builds have none */
+#ifdef REDOS_HOST
+static inline uint32_t spin_irq_save(void) { return 0; }
+static inline void spin_irq_restore(uint32_t flags) { (void)flags; }
+#else
+static inline uint32_t spin_irq_save(void) { return irq_save(); }
+static inline void spin_irq_restore(uint32_t flags) { irq_restore(flags); }
+#endif
+
+/* --- Ticket lock --- */
+
+struct spinlock {
+    uint16_t owner;             /* Ticket being served */
+    uint16_t next;              /* Next ticket to hand out */
+#ifdef KERNEL_LOCKSTAT
+    struct lock_class* class;
+    uint64_t acquired;          /* TSC when taken */
+#endif
+};
+
+/*
+ * Define a ticket lock at file scope, in a lock class of its own:
+ *   DEFINE_SPINLOCK(frame_lock);
+ */
+#ifdef KERNEL_LOCKSTAT
+#define DEFINE_SPINLOCK(lock)                                   \
+    LOCK_CLASS_DEFINE(lock##_class, #lock);                     \
+    static struct spinlock lock = { .class = &lock##_class }
+#else
+#define DEFINE_SPINLOCK(lock) static struct spinlock lock = { 0, 0 }
+#endif
+
+/* Initialize a lock embedded in another object; name is its lock class */
+#ifdef KERNEL_LOCKSTAT
+#define spin_lock_init(lock, name) \
+    (*(lock) = (struct spinlock){ .class = __lock_class_here(name) })
+#else
+#define spin_lock_init(lock, name) (*(lock) = (struct spinlock){ 0, 0 })
+#endif
+
+static inline void spin_lock(struct spinlock* lock) {
+    uint16_t ticket = __atomic_fetch_add(&lock->next, 1, __ATOMIC_RELAXED);
+#ifdef KERNEL_LOCKSTAT
+    bool contended = __atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket;
+    uint64_t wait_start = contended ? lockstat_now() : 0;
+#endif
+    while (__atomic_load_n(&lock->owner, __ATOMIC_ACQUIRE) != ticket) {
+        cpu_relax();
+    }
+#ifdef KERNEL_LOCKSTAT
+    lockstat_acquired(lock->class, contended, wait_start);
+    lock->acquired = lockstat_now();
+#endif
+}
+
+/* Take the lock only if it is free; true on success */
+static inline bool spin_trylock(struct spinlock* lock) {
+    uint16_t owner = __atomic_load_n(&lock->owner, __ATOMIC_RELAXED);
+    uint16_t expected = owner;
+    if (__atomic_load_n(&lock->next, __ATOMIC_RELAXED) != owner ||
+        !__atomic_compare_exchange_n(&lock->next, &expected, (uint16_t)(owner + 1), false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+#ifdef KERNEL_LOCKSTAT
+    lockstat_acquired(lock->class, false, 0);
+    lock->acquired = lockstat_now();
+#endif
+    return true;
+}
+
+static inline void spin_unlock(struct spinlock* lock) {
+#ifdef KERNEL_LOCKSTAT
+    lockstat_release(lock->class, lock->acquired);
+#endif
+    // Only the holder writes owner, so a plain increment is enough
+    __atomic_store_n(&lock->owner, (uint16_t)(lock->owner + 1), __ATOMIC_RELEASE);
+}
+
+/*
+ * Make the lock free whoever holds it. Waiters already queued stay stuck,
+ * so this is only for a panic that has to print through a lock it may
+ * have interrupted.
+ */
+static inline void spin_lock_break(struct spinlock* lock) {
+    __atomic_store_n(&lock->owner, __atomic_load_n(&lock->next, __ATOMIC_RELAXED),
+                     __ATOMIC_RELEASE);
+}
+
+static inline bool spin_is_locked(const struct spinlock* lock) {
+    return __atomic_load_n(&lock->owner, __ATOMIC_RELAXED) !=
+           __atomic_load_n(&lock->next, __ATOMIC_RELAXED);
+}
+
+/* Disable interrupts and take the lock, returning the flags to restore */
+static inline uint32_t spin_lock_irqsave(struct spinlock* lock) {
+    uint32_t flags = spin_irq_save();
+    spin_lock(lock);
+    return flags;
+}
+
+static inline void spin_unlock_irqrestore(struct spinlock* lock, uint32_t flags) {
+    spin_unlock(lock);
+    spin_irq_restore(flags);
+}
+
+/* --- MCS queue lock --- */
+
+/* One waiter's place in the queue; lives on the caller's stack */
+struct mcs_node {
+    struct mcs_node* volatile next;
+    volatile bool locked;
+};
+
+struct mcs_lock {
+    struct mcs_node* tail;      /* Last waiter, or the holder, or NULL */
+#ifdef KERNEL_LOCKSTAT
+    struct lock_class* class;
+    uint64_t acquired;
+#endif
+};
+
+#ifdef KERNEL_LOCKSTAT
+#define DEFINE_MCS_LOCK(lock)                                   \
+    LOCK_CLASS_DEFINE(lock##_class, #lock);                     \
+    static struct mcs_lock lock = { .class = &lock##_class }
+#define mcs_lock_init(lock, name) \
+    (*(lock) = (struct mcs_lock){ .class = __lock_class_here(name) })
+#else
+#define DEFINE_MCS_LOCK(lock) static struct mcs_lock lock = { 0 }
+#define mcs_lock_init(lock, name) (*(lock) = (struct mcs_lock){ 0 })
+#endif
+
+/* Queue on the lock through node, which must stay valid until mcs_unlock() */
+void mcs_lock(struct mcs_lock* lock, struct mcs_node* node);
+
+/* Take the lock only if nobody holds or waits for it; true on success */
+bool mcs_trylock(struct mcs_lock* lock, struct mcs_node* node);
+
+/* Release the lock taken through node, handing it to the next waiter */
+void mcs_unlock(struct mcs_lock* lock, struct mcs_node* node);
+
+/* As spin_lock_break() */
+static inline void mcs_lock_break(struct mcs_lock* lock) {
+    __atomic_store_n(&lock->tail, 0, __ATOMIC_RELEASE);
+}
+
+static inline bool mcs_is_locked(const struct mcs_lock* lock) {
+    return __atomic_load_n(&lock->tail, __ATOMIC_RELAXED) != 0;
+}
+
+static inline uint32_t mcs_lock_irqsave(struct mcs_lock* lock, struct mcs_node* node) {
+    uint32_t flags = spin_irq_save();
+    mcs_lock(lock, node);
+    return flags;
+}
+
+static inline void mcs_unlock_irqrestore(struct mcs_lock* lock, struct mcs_node* node,
+                                         uint32_t flags) {
+    mcs_unlock(lock, node);
+    spin_irq_restore(flags);
+}
+
+#endif /* _KERNEL_SPINLOCK_H */
@@ -0,0 +1,67 @@
+#ifndef _KERNEL_TELEMETRY_H
+#define _KERNEL_TELEMETRY_H
+
+#include <stdint.h>
+
+/*
+ * Telemetry page. The kernel keeps a snapshot of its statistics in one page
+ * at a fixed physical address, so the host can read it from guest memory
+ * (QEMU pmemsave or the gdbstub) without the guest doing any I/O. The
+ * layout is documented in docs/TELEMETRY.md; scripts/telemetry.py reads it.
+ *
+ * The page starts with a header followed by an array of named entries. A
+ * reader that only knows the header can walk the entries using entry_size,
+ * so new entries and wider entries do not need a new version.
+ */
+#define TELEMETRY_PHYS_ADDR  0x7000
+#define TELEMETRY_SIZE       4096
+#define TELEMETRY_MAGIC      0x4c455452     /* "RTEL" in memory */
+#define TELEMETRY_VERSION    1
+
+/* How often the page is refreshed */
+#define TELEMETRY_PERIOD_MS  100
+
+#define TELEMETRY_NAME_SIZE  28
+
+/* What an entry's value counts */
+#define TELEMETRY_UNIT_COUNT   0
+#define TELEMETRY_UNIT_CYCLES  1   /* TSC cycles, see tsc_hz */
+#define TELEMETRY_UNIT_FRAMES  2   /* 4 KB physical frames */
+#define TELEMETRY_UNIT_NS      3
+#define TELEMETRY_UNIT_PERCENT 4
+
+struct telemetry_header {
+    uint32_t magic;
+    uint16_t version;
+    uint16_t header_size;       /* Offset of the first entry */
+    uint16_t entry_size;
+    uint16_t entry_count;
+    /*
+     * Odd while the kernel is rewriting the page. A reader copies the page
+     * and keeps the copy if sequence was even and unchanged on both sides.
+     */
+    volatile uint32_t sequence;
+    uint64_t tsc_hz;            /* 0 if the TSC is not calibrated */
+    uint64_t updated_tsc;       /* TSC when the snapshot was taken */
+    uint64_t uptime_ns;
+    uint64_t log_sequence;      /* Messages logged through the debug subsystem */
+    uint32_t updates;           /* Snapshots written since boot */
+    uint32_t reserved;
+} __attribute__((packed));
+
+struct telemetry_entry {
+    char name[TELEMETRY_NAME_SIZE];     /* NUL padded, "group.name" */
+    uint32_t unit;                      /* TELEMETRY_UNIT_* */
+    uint64_t value;
+} __attribute__((packed));
+
+#define TELEMETRY_MAX_ENTRIES \
+    ((TELEMETRY_SIZE - sizeof(struct telemetry_header)) / sizeof(struct telemetry_entry))
+
+/* Publish the page and refresh it every TELEMETRY_PERIOD_MS */
+void telemetry_init(void);
+
+/* Refresh the page now */
+void telemetry_update(void);
+
+#endif /* _KERNEL_TELEMETRY_H */
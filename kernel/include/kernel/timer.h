@@ -0,0 +1,53 @@
+#ifndef _KERNEL_TIMER_H
+#define _KERNEL_TIMER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Resolution of the timing wheel */
+#define TIMER_TICK_NS 1000000ULL
+
+typedef void (*timer_fn_t)(void* data);
+
+/*
+ * A one-shot timeout. Callbacks run from the timer interrupt with
+ * interrupts disabled and may re-add their own timer.
+ */
+struct timer {
+    struct timer* next;
+    struct timer** pprev;       /* Link pointing at us, for O(1) removal */
+    uint64_t expires_ns;        /* Requested expiry, for lateness stats */
+    uint64_t expires;           /* Expiry in wheel ticks */
+    timer_fn_t function;
+    void* data;
+};
+
+/* Counters for judging how often the timer hardware wakes the CPU */
+struct timer_stats {
+    uint64_t since_ns;          /* ktime when the counters were reset */
+    uint32_t wakeups;           /* Timer interrupts taken */
+    uint32_t expired;           /* Callbacks run */
+    uint32_t reprograms;        /* Times the hardware was armed */
+    uint64_t late_total_ns;     /* Sum of expiry lateness */
+    uint64_t late_max_ns;
+};
+
+void timer_init(struct timer* timer, timer_fn_t function, void* data);
+
+/* Arm a timer for an absolute ktime, replacing any earlier expiry */
+void timer_add(struct timer* timer, uint64_t expires_ns);
+
+/* Arm a timer delay_ns from now */
+void timer_add_after(struct timer* timer, uint64_t delay_ns);
+
+/* Disarm a timer; returns true if it was pending */
+bool timer_cancel(struct timer* timer);
+
+static inline bool timer_pending(const struct timer* timer) {
+    return timer->pprev != 0;
+}
+
+void timer_get_stats(struct timer_stats* stats);
+void timer_reset_stats(void);
+
+#endif /* _KERNEL_TIMER_H */
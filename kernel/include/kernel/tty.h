@@ -3,12 +3,47 @@
 
 #include <stddef.h>
 #include <stdbool.h>
+#include <stdint.h>
+#include <kernel/bootinfo.h>
 
 void terminal_initialize(void);
 void terminal_putchar(char c);
 void terminal_write(const char* data, size_t size);
 void terminal_writestring(const char* data);
 
+/* Move the console onto the bootloader's linear framebuffer */
+bool terminal_use_framebuffer(const struct boot_framebuffer* fb);
+
+/* Write rows changed since the last flush from the history ring to the display */
+void terminal_flush(void);
+
+/* Scrollback: move the view by a number of lines (positive = older) */
+void terminal_scroll_view(int lines);
+void terminal_view_live(void);
+size_t terminal_history_lines(void);
+
+/*
+ * Time scrolling output through the console against writing it straight
+ * into display memory, VGA text or the framebuffer, whichever is in use
+ */
+void terminal_benchmark_scroll(size_t lines, uint64_t* console_cycles, uint64_t* direct_cycles);
+
+/* Map VGA text memory write-combining, once the PAT has been set up */
+void terminal_use_write_combining(void);
+
+/* Cycles for full-screen fills and scrolls with the display mapped UC or WC */
+struct console_cache_benchmark {
+    uint64_t uc_fill;
+    uint64_t wc_fill;
+    uint64_t uc_scroll;
+    uint64_t wc_scroll;
+};
+
+void terminal_benchmark_cache(size_t passes, struct console_cache_benchmark* result);
+
+/* Release the console lock whoever holds it; for panic only */
+void terminal_break_lock(void);
+
 /* Serial output control for terminal functions */
 void terminal_enable_serial(bool enable);
 bool terminal_is_serial_enabled(void);
@@ -0,0 +1,49 @@
+#ifndef _KERNEL_WAIT_H
+#define _KERNEL_WAIT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <interrupts.h>
+
+struct wait_queue_entry;
+
+/*
+ * Threads sleeping until some condition holds. Whoever makes it true calls
+ * wake_up(), from a thread or an interrupt handler. Threads only run on the
+ * bootstrap processor, so interrupts disabled around the check and the
+ * sleep are what keeps a wakeup from being missed.
+ */
+struct wait_queue {
+    struct wait_queue_entry* head;      /* Oldest first */
+};
+
+#define WAIT_QUEUE_INIT { 0 }
+
+void wait_queue_init(struct wait_queue* queue);
+
+/*
+ * Sleep until woken. Call with interrupts disabled after finding the
+ * condition false; they are still disabled on return, and the condition
+ * must be checked again.
+ */
+void wait_queue_sleep(struct wait_queue* queue);
+
+/* As wait_queue_sleep(), for at most ns; false if it timed out */
+bool wait_queue_sleep_timeout(struct wait_queue* queue, uint64_t ns);
+
+/* Wake the thread that has waited longest, if any */
+void wake_up(struct wait_queue* queue);
+
+/* Wake every waiting thread */
+void wake_up_all(struct wait_queue* queue);
+
+/* Sleep until condition is true; it is evaluated with interrupts disabled */
+#define wait_event(queue, condition) do {           \
+    uint32_t __wait_flags = irq_save();             \
+    while (!(condition)) {                          \
+        wait_queue_sleep(&(queue));                 \
+    }                                               \
+    irq_restore(__wait_flags);                      \
+} while (0)
+
+#endif /* _KERNEL_WAIT_H */
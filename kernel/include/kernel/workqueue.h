@@ -0,0 +1,43 @@
+#ifndef _KERNEL_WORKQUEUE_H
+#define _KERNEL_WORKQUEUE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Worker threads started by workqueue_init() */
+#ifndef WORKQUEUE_WORKERS
+#define WORKQUEUE_WORKERS 2
+#endif
+
+/* Items one worker's deque holds, and the shared queue (powers of two) */
+#define WORK_DEQUE_SIZE  256
+#define WORK_INJECT_SIZE 256
+
+typedef void (*work_fn_t)(void* arg);
+
+/*
+ * Deferred work for a pool of worker threads. Each worker owns a
+ * Chase-Lev deque: it pushes and pops at the bottom without locking,
+ * while idle workers steal from the top of the others' deques with one
+ * compare-and-swap. Work queued by a worker, such as a job splitting
+ * itself, goes on its own deque; work from other threads and interrupt
+ * handlers goes on a shared locked queue that workers drain before
+ * stealing. Workers with nothing to do sleep until work is queued.
+ *
+ * Work functions run in thread context with interrupts enabled and may
+ * sleep. They run in no particular order.
+ */
+
+/* Start the worker threads; needs the scheduler */
+void workqueue_init(void);
+
+/*
+ * Run fn(arg) on a worker thread. Safe from interrupt handlers.
+ * @return false if the queue is full, in which case nothing was queued
+ */
+bool queue_work(work_fn_t fn, void* arg);
+
+/* Print per-worker counts of work run and stolen, and queue latency */
+void workqueue_dump(void);
+
+#endif /* _KERNEL_WORKQUEUE_H */
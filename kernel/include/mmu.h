@@ -0,0 +1,67 @@
+#ifndef MMU_H
+#define MMU_H
+
+#include <stdint.h>
+#include "paging.h"
+
+/* CR0 paging enable bit */
+#define CR0_PG 0x80000000
+
+/*
+ * The privileged operations the paging code is built on. Host builds
+ * (REDOS_HOST) link host/shim/mmu.c instead, which backs physical memory
+ * with an ordinary buffer so the page table code runs as a normal process.
+ */
+#ifdef REDOS_HOST
+
+uint32_t mmu_read_cr0(void);
+void mmu_write_cr0(uint32_t value);
+uint32_t mmu_read_cr3(void);
+void mmu_write_cr3(uint32_t value);
+void mmu_invlpg(uint32_t addr);
+void mmu_wbinvd(void);
+void* mmu_phys_to_virt(uint32_t phys);
+uint32_t mmu_virt_to_phys(const void* virt);
+
+#else
+
+static inline uint32_t mmu_read_cr0(void) {
+    uint32_t value;
+    __asm__ __volatile__("movl %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void mmu_write_cr0(uint32_t value) {
+    __asm__ __volatile__("movl %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline uint32_t mmu_read_cr3(void) {
+    uint32_t value;
+    __asm__ __volatile__("movl %%cr3, %0" : "=r"(value));
+    return value;
+}
+
+static inline void mmu_write_cr3(uint32_t value) {
+    __asm__ __volatile__("movl %0, %%cr3" : : "r"(value) : "memory");
+}
+
+static inline void mmu_invlpg(uint32_t addr) {
+    __asm__ __volatile__("invlpg (%0)" : : "r"(addr) : "memory");
+}
+
+static inline void mmu_wbinvd(void) {
+    __asm__ __volatile__("wbinvd" ::: "memory");
+}
+
+/* Kernel address of direct-mapped physical memory */
+static inline void* mmu_phys_to_virt(uint32_t phys) {
+    return (void*)(phys + KERNEL_VIRTUAL_BASE);
+}
+
+static inline uint32_t mmu_virt_to_phys(const void* virt) {
+    return (uint32_t)virt - KERNEL_VIRTUAL_BASE;
+}
+
+#endif /* REDOS_HOST */
+
+#endif /* MMU_H */
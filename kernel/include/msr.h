@@ -0,0 +1,59 @@
+#ifndef MSR_H
+#define MSR_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+/* Model-specific registers */
+#define MSR_IA32_APIC_BASE 0x1B
+#define MSR_IA32_PAT 0x277
+
+/* IA32_APIC_BASE bits */
+#define APIC_BASE_BSP    (1u << 8)      /* This is the bootstrap processor */
+#define APIC_BASE_ENABLE (1u << 11)     /* Local APIC globally enabled */
+#define APIC_BASE_ADDR   0xFFFFF000u
+
+/* CPUID leaf 1 EDX feature bits */
+#define CPUID_FEAT_EDX_TSC (1u << 4)
+#define CPUID_FEAT_EDX_MSR (1u << 5)
+#define CPUID_FEAT_EDX_APIC (1u << 9)
+#define CPUID_FEAT_EDX_PAT (1u << 16)
+
+/* CPUID leaf 1 ECX feature bits */
+#define CPUID_FEAT_ECX_MONITOR (1u << 3)    /* MONITOR and MWAIT */
+
+/* CPUID leaf 0x80000007 EDX: TSC runs at a constant rate in all states */
+#define CPUID_EXT_LEAF_POWER          0x80000007
+#define CPUID_POWER_EDX_INVARIANT_TSC (1u << 8)
+
+static inline void cpuid(uint32_t leaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+    __asm__ volatile("cpuid"
+                     : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+                     : "a"(leaf), "c"(0));
+}
+
+/* Test a CPUID leaf 1 EDX feature bit */
+static inline bool cpu_has_feature_edx(uint32_t feature) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    return (edx & feature) != 0;
+}
+
+/* Test a CPUID leaf 1 ECX feature bit */
+static inline bool cpu_has_feature_ecx(uint32_t feature) {
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(1, &eax, &ebx, &ecx, &edx);
+    return (ecx & feature) != 0;
+}
+
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t low, high;
+    __asm__ volatile("rdmsr" : "=a"(low), "=d"(high) : "c"(msr));
+    return ((uint64_t)high << 32) | low;
+}
+
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+#endif /* MSR_H */
@@ -8,6 +8,14 @@
 #define KERNEL_VIRTUAL_BASE 0xC0000000
 #define KERNEL_PAGE_NUMBER (KERNEL_VIRTUAL_BASE >> 22)
 
+/* Virtual window used to map device memory such as framebuffers */
+#define MMIO_VIRTUAL_BASE 0xE0000000
+#define MMIO_VIRTUAL_END  0xF0000000
+
+/* Window holding kernel thread stacks, each with an unmapped guard below it */
+#define KSTACK_VIRTUAL_BASE 0xD8000000
+#define KSTACK_VIRTUAL_END  0xDC000000
+
 /* Page size (4KB) */
 #define PAGE_SIZE 4096
 
@@ -15,20 +23,45 @@
 #define PAGE_PRESENT   0x001
 #define PAGE_WRITE     0x002
 #define PAGE_USER      0x004
+#define PAGE_PWT       0x008
+#define PAGE_PCD       0x010
 #define PAGE_ACCESSED  0x020
 #define PAGE_DIRTY     0x040
+#define PAGE_PAT       0x080
 #define PAGE_FRAME     0xFFFFF000
 
+/* PTE bits that select a PAT entry */
+#define PAGE_CACHE_MASK (PAGE_PAT | PAGE_PCD | PAGE_PWT)
+
+/*
+ * Memory types a mapping can ask for. init_pat() programs the PAT so that
+ * each of these is selected by the PWT/PCD bits alone.
+ */
+enum page_cache_type {
+    PAGE_CACHE_WB,          /* Write-back, normal RAM */
+    PAGE_CACHE_WC,          /* Write-combining, framebuffers and streaming buffers */
+    PAGE_CACHE_UC_MINUS,    /* Uncached, may be overridden to WC by the MTRRs */
+    PAGE_CACHE_UC,          /* Strongly uncached, device registers */
+};
+
 /* Page Directory and Page Table typedefs */
 typedef uint32_t page_directory_t[1024];
 typedef uint32_t page_table_t[1024];
 
 /* Paging functions */
 void init_paging(void);
+void paging_init_directory(void);
+void init_pat(void);
+void init_pat_ap(void);
+uint32_t page_cache_flags(enum page_cache_type cache);
 void* kmalloc_physical_page(void);
 void kfree_physical_page(void* addr);
-void map_page_to_frame(void* virtual_addr, void* physical_addr, uint32_t flags);
+void map_page_to_frame(void* virtual_addr, void* physical_addr, uint32_t flags,
+                       enum page_cache_type cache);
 void unmap_page(void* virtual_addr);
+void* map_physical_region(uint32_t physical_addr, uint32_t size, uint32_t flags,
+                          enum page_cache_type cache);
+void set_region_cache_type(void* virtual_addr, uint32_t size, enum page_cache_type cache);
 void* get_physical_address(void* virtual_addr);
 void switch_page_directory(page_directory_t *dir);
 void flush_tlb_entry(uint32_t addr);
@@ -39,11 +72,11 @@ void print_paging_info(void);
 
 /* Inline functions to convert between virtual and physical addresses */
 static inline void* P2V(void* addr) {
-    return (void*)((uint32_t)addr + KERNEL_VIRTUAL_BASE);
+    return (void*)((uintptr_t)addr + KERNEL_VIRTUAL_BASE);
 }
 
 static inline void* V2P(void* addr) {
-    return (void*)((uint32_t)addr - KERNEL_VIRTUAL_BASE);
+    return (void*)((uintptr_t)addr - KERNEL_VIRTUAL_BASE);
 }
 
 #endif /* PAGING_H */
@@ -0,0 +1,22 @@
+#ifndef PIC_H
+#define PIC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Remap both 8259 PICs to vector_base..vector_base+15, all lines masked */
+void pic_init(uint8_t vector_base);
+
+void pic_mask(uint8_t irq);
+void pic_unmask(uint8_t irq);
+
+/* Acknowledge an interrupt so the PIC delivers the next one */
+void pic_send_eoi(uint8_t irq);
+
+/*
+ * Check whether IRQ 7 or 15 was spurious. A spurious IRQ 15 still needs
+ * an EOI to the master, which this function sends.
+ */
+bool pic_is_spurious(uint8_t irq);
+
+#endif /* PIC_H */
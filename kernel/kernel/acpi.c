@@ -0,0 +1,125 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "paging.h"
+#include <kernel/acpi.h>
+#include <kernel/bootinfo.h>
+#include <kernel/debug.h>
+
+/* Most tables the kernel keeps track of */
+#define ACPI_MAX_TABLES 32
+
+static const struct acpi_sdt_header *acpi_tables[ACPI_MAX_TABLES];
+static size_t acpi_table_count;
+
+static bool acpi_checksum_ok(const void *data, size_t length) {
+    const uint8_t *bytes = data;
+    uint8_t sum = 0;
+
+    for (size_t i = 0; i < length; i++) {
+        sum += bytes[i];
+    }
+    return sum == 0;
+}
+
+/**
+ * Map a system description table, whatever its length
+ * @param physical_addr Physical address of the table header
+ * @return Mapped table, or NULL if it could not be mapped or is corrupt
+ */
+static const struct acpi_sdt_header *acpi_map_table(uint32_t physical_addr) {
+    const struct acpi_sdt_header *header =
+        map_physical_region(physical_addr, sizeof(*header), 0, PAGE_CACHE_WB);
+    if (!header) {
+        return NULL;
+    }
+
+    // Map again if the table runs past the page holding its header
+    uint32_t length = header->length;
+    if ((physical_addr & (PAGE_SIZE - 1)) + length > PAGE_SIZE) {
+        header = map_physical_region(physical_addr, length, 0, PAGE_CACHE_WB);
+        if (!header) {
+            return NULL;
+        }
+    }
+
+    if (!acpi_checksum_ok(header, length)) {
+        debug_warning("ACPI table %.4s at 0x%x has a bad checksum", header->signature, physical_addr);
+        return NULL;
+    }
+    return header;
+}
+
+/**
+ * Map the root table and every table it lists
+ * @return true if the ACPI tables are available
+ */
+bool acpi_init(void) {
+    const struct acpi_rsdp *rsdp = (const struct acpi_rsdp*)boot_info.acpi.rsdp;
+
+    if (!boot_info.acpi.present) {
+        debug_warning("No ACPI RSDP from the bootloader");
+        return false;
+    }
+    if (memcmp(rsdp->signature, "RSD PTR ", 8) != 0 || !acpi_checksum_ok(rsdp, 20)) {
+        debug_error("ACPI RSDP is corrupt");
+        return false;
+    }
+
+    // Prefer the XSDT when the firmware has one we can reach
+    bool use_xsdt = rsdp->revision >= 2 &&
+                    boot_info.acpi.length >= sizeof(*rsdp) &&
+                    rsdp->xsdt_address != 0 &&
+                    rsdp->xsdt_address < 0x100000000ULL;
+    uint32_t root_addr = use_xsdt ? (uint32_t)rsdp->xsdt_address : rsdp->rsdt_address;
+    size_t entry_size = use_xsdt ? sizeof(uint64_t) : sizeof(uint32_t);
+
+    const struct acpi_sdt_header *root = acpi_map_table(root_addr);
+    if (!root) {
+        debug_error("Cannot map ACPI %s at 0x%x", use_xsdt ? "XSDT" : "RSDT", root_addr);
+        return false;
+    }
+
+    const uint8_t *entries = (const uint8_t*)(root + 1);
+    size_t count = (root->length - sizeof(*root)) / entry_size;
+
+    acpi_table_count = 0;
+    for (size_t i = 0; i < count && acpi_table_count < ACPI_MAX_TABLES; i++) {
+        uint64_t addr;
+        if (use_xsdt) {
+            memcpy(&addr, entries + i * entry_size, sizeof(uint64_t));
+        } else {
+            uint32_t addr32;
+            memcpy(&addr32, entries + i * entry_size, sizeof(uint32_t));
+            addr = addr32;
+        }
+        if (addr >= 0x100000000ULL) {
+            continue;
+        }
+
+        const struct acpi_sdt_header *table = acpi_map_table((uint32_t)addr);
+        if (table) {
+            acpi_tables[acpi_table_count++] = table;
+            debug_info("ACPI table %.4s at 0x%x, %u bytes", table->signature,
+                       (uint32_t)addr, table->length);
+        }
+    }
+
+    debug_info("ACPI revision %u, %u tables via %s", (unsigned)rsdp->revision,
+               (unsigned)acpi_table_count, use_xsdt ? "XSDT" : "RSDT");
+    return true;
+}
+
+/**
+ * Find a table by its signature
+ * @param signature Four character table signature, e.g. "HPET"
+ * @return Mapped table, or NULL if the firmware does not provide it
+ */
+const struct acpi_sdt_header *acpi_find_table(const char *signature) {
+    for (size_t i = 0; i < acpi_table_count; i++) {
+        if (memcmp(acpi_tables[i]->signature, signature, 4) == 0) {
+            return acpi_tables[i];
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,112 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "interrupts.h"
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/math64.h>
+
+static struct clocksource *clocksource_list;
+static struct clocksource *current_clocksource;
+
+/*
+ * ktime state: cycles_total is the current source's count extended to 64
+ * bits since it was selected, base_ns the time at which that happened.
+ */
+static uint64_t cycle_last;
+static uint64_t cycles_total;
+static uint64_t base_ns;
+
+/**
+ * Pick the largest shift whose multiplier still fits in 32 bits, which
+ * gives the most precise conversion to nanoseconds
+ * @param cs Clocksource with freq_hz set
+ */
+static void clocksource_compute_mult(struct clocksource *cs) {
+    uint32_t shift = 32;
+    uint64_t mult;
+
+    for (;;) {
+        mult = div_u64_u64_approx((NSEC_PER_SEC << shift) + cs->freq_hz / 2, cs->freq_hz);
+        if (mult <= UINT32_MAX || shift == 0) {
+            break;
+        }
+        shift--;
+    }
+
+    cs->mult = (uint32_t)mult;
+    cs->shift = shift;
+}
+
+/**
+ * Register a clocksource
+ * @param cs Clocksource to add, with freq_hz set; must stay valid forever
+ */
+void clocksource_register(struct clocksource *cs) {
+    clocksource_compute_mult(cs);
+    cs->next = clocksource_list;
+    clocksource_list = cs;
+
+    debug_info("Clocksource %s: %llu Hz, mask 0x%llx, rating %d, mult %u shift %u",
+               cs->name, cs->freq_hz, cs->mask, cs->rating, cs->mult, cs->shift);
+}
+
+/**
+ * Switch ktime to the best rated clocksource, keeping time continuous
+ */
+void clocksource_select(void) {
+    struct clocksource *best = NULL;
+
+    for (struct clocksource *cs = clocksource_list; cs; cs = cs->next) {
+        if (!best || cs->rating > best->rating) {
+            best = cs;
+        }
+    }
+    if (!best || best == current_clocksource) {
+        return;
+    }
+
+    uint64_t now_ns = ktime_get_ns();
+    current_clocksource = best;
+    cycle_last = best->read();
+    cycles_total = 0;
+    base_ns = now_ns;
+}
+
+const struct clocksource *clocksource_current(void) {
+    return current_clocksource;
+}
+
+const struct clocksource *clocksource_get(const char *name) {
+    for (struct clocksource *cs = clocksource_list; cs; cs = cs->next) {
+        if (strcmp(cs->name, name) == 0) {
+            return cs;
+        }
+    }
+    return NULL;
+}
+
+uint64_t clocksource_cycles_to_ns(const struct clocksource *cs, uint64_t cycles) {
+    return mul_u64_u32_shr(cycles, cs->mult, cs->shift);
+}
+
+/**
+ * Read the current time
+ * @return Nanoseconds since the first clocksource was selected
+ */
+uint64_t ktime_get_ns(void) {
+    struct clocksource *cs = current_clocksource;
+    if (!cs) {
+        return 0;
+    }
+
+    // The timer interrupt reads the clock too
+    uint32_t flags = irq_save();
+    uint64_t now = cs->read();
+    cycles_total += (now - cycle_last) & cs->mask;
+    cycle_last = now;
+    uint64_t ns = base_ns + mul_u64_u32_shr(cycles_total, cs->mult, cs->shift);
+    irq_restore(flags);
+
+    return ns;
+}
@@ -0,0 +1,68 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "interrupts.h"
+#include <kernel/completion.h>
+#include <kernel/wait.h>
+
+/* complete_all() sets done to this; waits no longer consume it */
+#define COMPLETION_ALL UINT32_MAX
+
+void completion_init(struct completion *completion) {
+    completion->done = 0;
+    wait_queue_init(&completion->wait);
+}
+
+/**
+ * Signal one event
+ * @param completion Completion to signal
+ */
+void complete(struct completion *completion) {
+    uint32_t flags = irq_save();
+    if (completion->done != COMPLETION_ALL) {
+        completion->done++;
+    }
+    wake_up(&completion->wait);
+    irq_restore(flags);
+}
+
+/**
+ * Signal every waiter, now and later
+ * @param completion Completion to signal
+ */
+void complete_all(struct completion *completion) {
+    uint32_t flags = irq_save();
+    completion->done = COMPLETION_ALL;
+    wake_up_all(&completion->wait);
+    irq_restore(flags);
+}
+
+/**
+ * Sleep until an event is available and take it
+ * @param completion Completion to wait on
+ */
+void wait_for_completion(struct completion *completion) {
+    uint32_t flags = irq_save();
+    while (!completion->done) {
+        wait_queue_sleep(&completion->wait);
+    }
+    if (completion->done != COMPLETION_ALL) {
+        completion->done--;
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Take an event if one is available
+ * @param completion Completion to check
+ * @return true if an event was taken
+ */
+bool try_wait_for_completion(struct completion *completion) {
+    uint32_t flags = irq_save();
+    bool taken = completion->done != 0;
+    if (taken && completion->done != COMPLETION_ALL) {
+        completion->done--;
+    }
+    irq_restore(flags);
+    return taken;
+}
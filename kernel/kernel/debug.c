@@ -6,6 +6,8 @@
 #include <stdio.h>
 #include <kernel/tty.h>
 #include <kernel/debug.h>
+#include <kernel/kstat.h>
+#include <kernel/spinlock.h>
 #include "../arch/i386/serial.h"
 
 static int debug_level = DEBUG_LEVEL_INFO;
@@ -15,6 +17,17 @@ static bool debug_initialized = false;
 #define DEBUG_BUFFER_SIZE 1024
 static char debug_buffer[DEBUG_BUFFER_SIZE];
 
+/*
+ * Serializes debug_buffer and keeps messages whole on the outputs. Taken
+ * before the console lock, and callers may already hold the frame or
+ * paging lock, so nothing under it may allocate or map memory. An MCS lock
+ * because every CPU logs through it.
+ */
+DEFINE_MCS_LOCK(debug_lock);
+
+/* Messages written so far, the sequence number of the latest one */
+KSTAT_DEFINE(debug, messages);
+
 static const char* level_prefix[] = {
     "",         /* NONE */
     "[ERROR] ", /* ERROR */
@@ -71,6 +84,15 @@ int debug_get_target(void) {
     return debug_target;
 }
 
+/**
+ * Forget who holds the debug and console locks, so a panic raised while
+ * printing can still print. Only for paths that never return.
+ */
+void debug_break_locks(void) {
+    mcs_lock_break(&debug_lock);
+    terminal_break_lock();
+}
+
 static void debug_write(const char* str) {
     if (debug_target & DEBUG_TARGET_VGA) {
         terminal_writestring(str);
@@ -80,277 +102,6 @@ static void debug_write(const char* str) {
     }
 }
 
-/* Improved vsnprintf implementation */
-int vsnprintf(char* str, size_t size, const char* format, va_list args) {
-    if (size == 0) {
-        return 0;
-    }
-
-    if (size == 1) {
-        str[0] = '\0';
-        return 0;
-    }
-
-    size_t count = 0;
-    size_t output_index = 0;
-
-    while (*format && output_index < size - 1) {
-        if (*format != '%') {
-            str[output_index++] = *format++;
-            count++;
-            continue;
-        }
-
-        // Handle format specifier
-        format++; // Skip '%'
-
-        if (*format == '\0') {
-            break;
-        }
-
-        if (*format == '%') {
-            // Literal '%'
-            str[output_index++] = '%';
-            count++;
-            format++;
-            continue;
-        }
-
-        // Handle format specifiers
-        switch (*format) {
-            case 'd':
-            case 'i': {
-                // Signed integer
-                int value = va_arg(args, int);
-                char buffer[32];
-                bool negative = false;
-
-                if (value < 0) {
-                    negative = true;
-                    value = -value;
-                }
-
-                // Convert to string (reversed)
-                size_t pos = 0;
-                do {
-                    buffer[pos++] = '0' + (value % 10);
-                    value /= 10;
-                } while (value && pos < sizeof(buffer) - 1);
-
-                // Add minus sign if negative
-                if (negative && pos < sizeof(buffer) - 1) {
-                    buffer[pos++] = '-';
-                }
-
-                // Copy to output (in correct order)
-                while (pos > 0 && output_index < size - 1) {
-                    str[output_index++] = buffer[--pos];
-                    count++;
-                }
-                break;
-            }
-
-            case 'u': {
-                // Unsigned integer
-                unsigned int value = va_arg(args, unsigned int);
-                char buffer[32];
-
-                // Convert to string (reversed)
-                size_t pos = 0;
-                do {
-                    buffer[pos++] = '0' + (value % 10);
-                    value /= 10;
-                } while (value && pos < sizeof(buffer) - 1);
-
-                // Copy to output (in correct order)
-                while (pos > 0 && output_index < size - 1) {
-                    str[output_index++] = buffer[--pos];
-                    count++;
-                }
-                break;
-            }
-
-            case 'x': {
-                // Hexadecimal (lowercase)
-                unsigned int value = va_arg(args, unsigned int);
-
-                // Output "0x" prefix
-                if (output_index + 1 < size - 1) {
-                    str[output_index++] = '0';
-                    str[output_index++] = 'x';
-                    count += 2;
-                } else {
-                    break;
-                }
-
-                // Handle zero value specially
-                if (value == 0 && output_index < size - 1) {
-                    str[output_index++] = '0';
-                    count++;
-                    break;
-                }
-
-                char buffer[32];
-
-                // Convert to hex string (reversed)
-                size_t pos = 0;
-                do {
-                    unsigned int digit = value & 0xF;
-                    buffer[pos++] = digit < 10 ? '0' + digit : 'a' + (digit - 10);
-                    value >>= 4;
-                } while (value && pos < sizeof(buffer) - 1);
-
-                // Copy to output (in correct order)
-                while (pos > 0 && output_index < size - 1) {
-                    str[output_index++] = buffer[--pos];
-                    count++;
-                }
-                break;
-            }
-
-            case 'X': {
-                // Hexadecimal (uppercase)
-                unsigned int value = va_arg(args, unsigned int);
-
-                // Output "0x" prefix
-                if (output_index + 1 < size - 1) {
-                    str[output_index++] = '0';
-                    str[output_index++] = 'x';
-                    count += 2;
-                } else {
-                    break;
-                }
-
-                // Handle zero value specially
-                if (value == 0 && output_index < size - 1) {
-                    str[output_index++] = '0';
-                    count++;
-                    break;
-                }
-
-                char buffer[32];
-
-                // Convert to hex string (reversed)
-                size_t pos = 0;
-                do {
-                    unsigned int digit = value & 0xF;
-                    buffer[pos++] = digit < 10 ? '0' + digit : 'A' + (digit - 10);
-                    value >>= 4;
-                } while (value && pos < sizeof(buffer) - 1);
-
-                // Copy to output (in correct order)
-                while (pos > 0 && output_index < size - 1) {
-                    str[output_index++] = buffer[--pos];
-                    count++;
-                }
-                break;
-            }
-
-            case 'p': {
-                // Pointer
-                void* ptr = va_arg(args, void*);
-
-                if (ptr == NULL) {
-                    // Handle NULL pointer
-                    const char* null_str = "(nil)";
-                    size_t len = strlen(null_str);
-                    size_t to_copy = (output_index + len < size - 1) ? len : (size - 1 - output_index);
-
-                    memcpy(&str[output_index], null_str, to_copy);
-                    output_index += to_copy;
-                    count += to_copy;
-                } else {
-                    // Output "0x" prefix
-                    if (output_index + 1 < size - 1) {
-                        str[output_index++] = '0';
-                        str[output_index++] = 'x';
-                        count += 2;
-                    } else {
-                        break;
-                    }
-
-                    unsigned int value = (unsigned int)ptr;
-                    char buffer[32];
-
-                    // Convert to hex string (reversed)
-                    size_t pos = 0;
-                    do {
-                        unsigned int digit = value & 0xF;
-                        buffer[pos++] = digit < 10 ? '0' + digit : 'a' + (digit - 10);
-                        value >>= 4;
-                    } while (value && pos < sizeof(buffer) - 1);
-
-                    // Ensure minimum width of 8 digits for 32-bit pointers
-                    while (pos < 8 && pos < sizeof(buffer) - 1) {
-                        buffer[pos++] = '0';
-                    }
-
-                    // Copy to output (in correct order)
-                    while (pos > 0 && output_index < size - 1) {
-                        str[output_index++] = buffer[--pos];
-                        count++;
-                    }
-                }
-                break;
-            }
-
-            case 's': {
-                // String
-                const char* value = va_arg(args, const char*);
-
-                if (value == NULL) {
-                    value = "(null)";
-                }
-
-                while (*value && output_index < size - 1) {
-                    str[output_index++] = *value++;
-                    count++;
-                }
-                break;
-            }
-
-            case 'c': {
-                // Character
-                char value = (char)va_arg(args, int);
-
-                if (output_index < size - 1) {
-                    str[output_index++] = value;
-                    count++;
-                }
-                break;
-            }
-
-            default:
-                // Unsupported format specifier - output as-is
-                if (output_index < size - 1) {
-                    str[output_index++] = '%';
-                    count++;
-                }
-
-                if (output_index < size - 1) {
-                    str[output_index++] = *format;
-                    count++;
-                }
-                break;
-        }
-
-        format++;
-    }
-
-    // Null-terminate the output
-    str[output_index] = '\0';
-
-    return count;
-}
-
-int snprintf(char* str, size_t size, const char* format, ...) {
-    va_list args;
-    va_start(args, format);
-    int result = vsnprintf(str, size, format, args);
-    va_end(args);
-    return result;
-}
-
 static void debug_format_and_write(int level, const char* format, va_list args) {
     if (level > debug_level) {
         return;
@@ -358,6 +109,8 @@ static void debug_format_and_write(int level, const char* format, va_list args)
 
     const char* prefix = (level >= DEBUG_LEVEL_NONE && level <= DEBUG_LEVEL_TRACE) ?
                          level_prefix[level] : "";
+    struct mcs_node node;
+    uint32_t flags = mcs_lock_irqsave(&debug_lock, &node);
 
     /* Copy prefix to buffer */
     size_t prefix_len = strlen(prefix);
@@ -372,6 +125,7 @@ static void debug_format_and_write(int level, const char* format, va_list args)
                                format, args);
     if (message_len < 0) {
         /* vsnprintf error */
+        mcs_unlock_irqrestore(&debug_lock, &node, flags);
         return;
     }
 
@@ -387,7 +141,9 @@ static void debug_format_and_write(int level, const char* format, va_list args)
     debug_buffer[total_len + 2] = '\0';
 
     /* Output the message - should now avoid duplicate serial output */
+    kstat_inc(debug, messages);
     debug_write(debug_buffer);
+    mcs_unlock_irqrestore(&debug_lock, &node, flags);
 }
 
 /* Debug output functions for different levels */
@@ -443,10 +199,14 @@ void debug_print(const char* format, ...) {
 }
 
 void debug_vprint(const char* format, va_list args) {
+    struct mcs_node node;
+    uint32_t flags = mcs_lock_irqsave(&debug_lock, &node);
+
     /* Format the message */
     int message_len = vsnprintf(debug_buffer, DEBUG_BUFFER_SIZE - 1, format, args);
     if (message_len < 0) {
         /* vsnprintf error */
+        mcs_unlock_irqrestore(&debug_lock, &node, flags);
         return;
     }
 
@@ -458,6 +218,7 @@ void debug_vprint(const char* format, va_list args) {
 
     /* Output the message */
     debug_write(debug_buffer);
+    mcs_unlock_irqrestore(&debug_lock, &node, flags);
 }
 
 /* Improved hex dump implementation */
@@ -0,0 +1,210 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <kernel/debug.h>
+#include <kernel/frame.h>
+#include <kernel/kstat.h>
+#include <kernel/spinlock.h>
+
+#define BITMAP_SIZE (FRAME_COUNT / 32)
+static uint32_t frame_bitmap[BITMAP_SIZE];
+
+/* Guards frame_bitmap; taken under the paging lock */
+DEFINE_SPINLOCK(frame_lock);
+
+KSTAT_DEFINE(frame, allocs);
+KSTAT_DEFINE(frame, frees);
+KSTAT_DEFINE(frame, alloc_failures);
+
+/**
+ * Mark a frame as used in the bitmap
+ * @param frame_addr Physical address of the frame
+ */
+static void set_frame(uint32_t frame_addr) {
+    uint32_t frame = frame_addr / FRAME_SIZE;
+    uint32_t idx = frame / 32;
+    uint32_t off = frame % 32;
+
+    if (idx >= BITMAP_SIZE) {
+        debug_error("set_frame: Frame index %u out of bounds (max %u)", idx, BITMAP_SIZE-1);
+        return;
+    }
+
+    frame_bitmap[idx] |= (1u << off);
+}
+
+/**
+ * Mark a frame as free in the bitmap
+ * @param frame_addr Physical address of the frame
+ */
+static void clear_frame(uint32_t frame_addr) {
+    uint32_t frame = frame_addr / FRAME_SIZE;
+    uint32_t idx = frame / 32;
+    uint32_t off = frame % 32;
+
+    if (idx >= BITMAP_SIZE) {
+        debug_error("clear_frame: Frame index %u out of bounds (max %u)", idx, BITMAP_SIZE-1);
+        return;
+    }
+
+    frame_bitmap[idx] &= ~(1u << off);
+}
+
+/**
+ * Test if a frame is used
+ * @param frame_addr Physical address of the frame
+ * @return Non-zero if the frame is used, 0 otherwise
+ */
+static uint32_t test_frame(uint32_t frame_addr) {
+    uint32_t frame = frame_addr / FRAME_SIZE;
+    uint32_t idx = frame / 32;
+    uint32_t off = frame % 32;
+
+    if (idx >= BITMAP_SIZE) {
+        debug_error("test_frame: Frame index %u out of bounds (max %u)", idx, BITMAP_SIZE-1);
+        return 0;
+    }
+
+    return (frame_bitmap[idx] & (1u << off));
+}
+
+/**
+ * Find the first free frame
+ * @return Frame number or (uint32_t)-1 if no frames are available
+ */
+static uint32_t first_free_frame(void) {
+    for (uint32_t i = 0; i < BITMAP_SIZE; i++) {
+        if (frame_bitmap[i] != 0xFFFFFFFF) {
+            for (uint32_t j = 0; j < 32; j++) {
+                uint32_t bit = 1u << j;
+                if (!(frame_bitmap[i] & bit)) {
+                    return i * 32 + j;
+                }
+            }
+        }
+    }
+
+    debug_error("No free frames available!");
+    return (uint32_t)-1;
+}
+
+/**
+ * Mark every frame as free
+ */
+void frame_init(void) {
+    memset(frame_bitmap, 0, sizeof(frame_bitmap));
+}
+
+/**
+ * Reserve a physical range so it is never handed out
+ * @param start Physical start address
+ * @param end Physical end address, exclusive
+ */
+void frame_reserve_range(uint32_t start, uint32_t end) {
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    for (uint32_t addr = start & ~(FRAME_SIZE - 1); addr < end; addr += FRAME_SIZE) {
+        set_frame(addr);
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/**
+ * Allocate a physical frame
+ * @return Physical address of the allocated frame, or 0 on failure
+ */
+uint32_t frame_alloc(void) {
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    uint32_t frame = first_free_frame();
+    if (frame == (uint32_t)-1) {
+        kstat_inc(frame, alloc_failures);
+        spin_unlock_irqrestore(&frame_lock, flags);
+        return 0;
+    }
+
+    uint32_t frame_addr = frame * FRAME_SIZE;
+    set_frame(frame_addr);
+    kstat_inc(frame, allocs);
+    spin_unlock_irqrestore(&frame_lock, flags);
+
+    debug_debug("Allocated frame at physical address 0x%x", frame_addr);
+    return frame_addr;
+}
+
+/**
+ * Allocate several frames under one acquisition of the frame lock, with a
+ * single pass over the bitmap
+ * @param frames Receives the physical addresses
+ * @param count Frames wanted
+ * @return Frames allocated, fewer than count only when memory runs out
+ */
+uint32_t frame_alloc_batch(uint32_t *frames, uint32_t count) {
+    uint32_t got = 0;
+
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    for (uint32_t i = 0; i < BITMAP_SIZE && got < count; i++) {
+        uint32_t free_bits = ~frame_bitmap[i];
+        while (free_bits && got < count) {
+            uint32_t j = (uint32_t)__builtin_ctz(free_bits);
+            free_bits &= free_bits - 1;
+            frame_bitmap[i] |= 1u << j;
+            frames[got++] = (i * 32 + j) * FRAME_SIZE;
+        }
+    }
+    kstat_add(frame, allocs, got);
+    if (got < count) {
+        kstat_inc(frame, alloc_failures);
+    }
+    spin_unlock_irqrestore(&frame_lock, flags);
+    return got;
+}
+
+/**
+ * Free several frames under one acquisition of the frame lock
+ * @param frames Physical addresses of the frames
+ * @param count Number of frames
+ */
+void frame_free_batch(const uint32_t *frames, uint32_t count) {
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    for (uint32_t i = 0; i < count; i++) {
+        clear_frame(frames[i]);
+    }
+    kstat_add(frame, frees, count);
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/**
+ * Free a physical frame
+ * @param frame_addr Physical address of the frame to free
+ */
+void frame_free(uint32_t frame_addr) {
+    debug_debug("Freeing frame at physical address 0x%x", frame_addr);
+    uint32_t flags = spin_lock_irqsave(&frame_lock);
+    clear_frame(frame_addr);
+    kstat_inc(frame, frees);
+    spin_unlock_irqrestore(&frame_lock, flags);
+}
+
+/**
+ * Check whether a frame is allocated or reserved
+ * @param frame_addr Physical address inside the frame
+ * @return true if the frame is in use
+ */
+bool frame_is_used(uint32_t frame_addr) {
+    return test_frame(frame_addr) != 0;
+}
+
+/**
+ * Count the frames in use
+ * @return Allocated and reserved frames
+ */
+uint32_t frame_used_count(void) {
+    uint32_t used_frames = 0;
+    for (uint32_t i = 0; i < BITMAP_SIZE; i++) {
+        for (uint32_t j = 0; j < 32; j++) {
+            if (frame_bitmap[i] & (1u << j)) {
+                used_frames++;
+            }
+        }
+    }
+    return used_frames;
+}
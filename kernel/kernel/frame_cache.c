@@ -0,0 +1,125 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+#include <interrupts.h>
+#include <kernel/frame.h>
+#include <kernel/kstat.h>
+#include <kernel/percpu.h>
+#include <kernel/smp.h>
+
+/* One CPU's stack of free frames; its own cache lines, so CPUs never share */
+struct frame_cache {
+    uint32_t count;
+    uint32_t frames[FRAME_CACHE_SIZE];  /* Most recently freed, and warmest, last */
+} __attribute__((aligned(64)));
+
+static struct frame_cache caches[SMP_MAX_CPUS];
+
+/*
+ * Watermarks and batch size, in one word read once per call so that a
+ * frame_cache_tune() on another CPU is seen whole or not at all
+ */
+union frame_cache_limits {
+    struct {
+        uint8_t low;
+        uint8_t high;
+        uint8_t batch;
+    };
+    uint32_t word;
+};
+_Static_assert(FRAME_CACHE_SIZE <= 255, "frame cache limits are bytes");
+
+static union frame_cache_limits limits = {
+    { FRAME_CACHE_LOW, FRAME_CACHE_HIGH, FRAME_CACHE_BATCH }
+};
+
+KSTAT_DEFINE(frame_cache, refills);
+KSTAT_DEFINE(frame_cache, drains);
+
+static inline union frame_cache_limits read_limits(void) {
+    return (union frame_cache_limits){ .word = __atomic_load_n(&limits.word, __ATOMIC_RELAXED) };
+}
+
+/**
+ * Allocate a frame from the calling CPU's cache, refilling it if low
+ * @return Physical address of the frame, or 0 when memory is exhausted
+ */
+uint32_t frame_cache_alloc(void) {
+    union frame_cache_limits l = read_limits();
+
+    uint32_t flags = irq_save();
+    struct frame_cache *cache = &caches[this_cpu_read(index)];
+    if (cache->count <= l.low) {
+        cache->count += frame_alloc_batch(&cache->frames[cache->count], l.batch);
+        kstat_inc(frame_cache, refills);
+    }
+
+    uint32_t frame = cache->count ? cache->frames[--cache->count] : 0;
+    irq_restore(flags);
+    return frame;
+}
+
+/**
+ * Return a frame to the calling CPU's cache, draining a batch if full
+ * @param frame_addr Physical address of the frame
+ */
+void frame_cache_free(uint32_t frame_addr) {
+    union frame_cache_limits l = read_limits();
+
+    uint32_t flags = irq_save();
+    struct frame_cache *cache = &caches[this_cpu_read(index)];
+    if (cache->count >= l.high) {
+        // The oldest frames are the coldest, hand those back
+        uint32_t batch = l.batch < cache->count ? l.batch : cache->count;
+        frame_free_batch(cache->frames, batch);
+        cache->count -= batch;
+        memmove(cache->frames, cache->frames + batch, cache->count * sizeof(uint32_t));
+        kstat_inc(frame_cache, drains);
+    }
+
+    cache->frames[cache->count++] = frame_addr;
+    irq_restore(flags);
+}
+
+/**
+ * Change the watermarks and batch size of every CPU's cache
+ * @param low Refill when a cache holds this many frames or fewer
+ * @param high Drain when a cache holds this many frames
+ * @param batch Frames moved by one refill or drain
+ * @return false if the values are inconsistent
+ */
+bool frame_cache_tune(uint32_t low, uint32_t high, uint32_t batch) {
+    if (batch == 0 || low + batch > high || high > FRAME_CACHE_SIZE) {
+        return false;
+    }
+
+    union frame_cache_limits l = { .word = 0 };
+    l.low = (uint8_t)low;
+    l.high = (uint8_t)high;
+    l.batch = (uint8_t)batch;
+    __atomic_store_n(&limits.word, l.word, __ATOMIC_RELAXED);
+    return true;
+}
+
+/**
+ * Empty the calling CPU's cache into the frame allocator
+ */
+void frame_cache_drain(void) {
+    uint32_t flags = irq_save();
+    struct frame_cache *cache = &caches[this_cpu_read(index)];
+    frame_free_batch(cache->frames, cache->count);
+    cache->count = 0;
+    irq_restore(flags);
+}
+
+/**
+ * Count the frames sitting in caches; other CPUs may change theirs meanwhile
+ * @return Frames held by all caches
+ */
+uint32_t frame_cache_count(void) {
+    uint32_t total = 0;
+    for (uint32_t i = 0; i < SMP_MAX_CPUS; i++) {
+        total += __atomic_load_n(&caches[i].count, __ATOMIC_RELAXED);
+    }
+    return total;
+}
@@ -1,77 +1,92 @@
 #include "gdt.h"
 #include <stdio.h>
+#include <kernel/smp.h>
 
 /* Define entries and pointer for GDT */
-struct gdt_entry gdt[3];
+struct gdt_entry gdt[GDT_ENTRIES];
 struct gdt_ptr gp;
 
 /* Define the virtual base address for kernel */
 #define KERNEL_VIRTUAL_BASE 0xC0000000
 
+/* Encode a segment descriptor */
+static void gdt_encode(struct gdt_entry *entry, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
+    entry->base_low = (base & 0xFFFF);
+    entry->base_middle = (base >> 16) & 0xFF;
+    entry->base_high = (base >> 24) & 0xFF;
+    entry->limit_low = (limit & 0xFFFF);
+    entry->granularity = ((limit >> 16) & 0x0F) | (gran & 0xF0);
+    entry->access = access;
+}
+
 /* Set up a GDT entry */
 void gdt_set_entry(int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t gran) {
-    gdt[num].base_low = (base & 0xFFFF);
-    gdt[num].base_middle = (base >> 16) & 0xFF;
-    gdt[num].base_high = (base >> 24) & 0xFF;
-    gdt[num].limit_low = (limit & 0xFFFF);
-    gdt[num].granularity = ((limit >> 16) & 0x0F) | (gran & 0xF0);
-    gdt[num].access = access;
+    gdt_encode(&gdt[num], base, limit, access, gran);
 }
 
-/* Set up the GDT */
-void setup_gdt() {
-    printf("Setting up GDT for higher half kernel...\n");
-
-    /* Set up GDT pointer */
-    gp.limit = (sizeof(struct gdt_entry) * 3) - 1;
-    gp.base = (uint32_t)&gdt;
-
+/* Fill a GDT with the flat kernel segments and a CPU's per-CPU segment */
+void gdt_init_table(struct gdt_entry *table, const void *percpu, uint32_t size) {
     /* NULL descriptor */
-    gdt_set_entry(0, 0, 0, 0, 0);
+    gdt_encode(&table[0], 0, 0, 0, 0);
 
     /* Code segment - covers all 4GB */
-    gdt_set_entry(1, 0, 0xFFFFFFFF, GDT_CODE_SEGMENT_PL0, 0xCF);
+    gdt_encode(&table[1], 0, 0xFFFFFFFF, GDT_CODE_SEGMENT_PL0, 0xCF);
 
     /* Data segment - covers all 4GB */
-    gdt_set_entry(2, 0, 0xFFFFFFFF, GDT_DATA_SEGMENT_PL0, 0xCF);
+    gdt_encode(&table[2], 0, 0xFFFFFFFF, GDT_DATA_SEGMENT_PL0, 0xCF);
+
+    /* Per-CPU data - byte granular, just the CPU's own block */
+    gdt_encode(&table[3], (uint32_t)percpu, size - 1, GDT_DATA_SEGMENT_PL0, 0x40);
+}
 
-    /* Load the GDT */
-    printf("GDT location: %x\n", (uint32_t)&gp);
-    __asm__ __volatile__("lgdt %0" : : "m" (gp));
+/* Load a GDT and reload every segment register from it */
+void gdt_load(struct gdt_entry *table, struct gdt_ptr *ptr) {
+    ptr->limit = (sizeof(struct gdt_entry) * GDT_ENTRIES) - 1;
+    ptr->base = (uint32_t)table;
+    __asm__ __volatile__("lgdt %0" : : "m" (*ptr));
 
     /* Reload segment registers */
     __asm__ __volatile__("movl %0, %%eax\n"
                          "movw %%ax, %%ds\n"
                          "movw %%ax, %%es\n"
                          "movw %%ax, %%fs\n"
-                         "movw %%ax, %%gs\n"
                          "movw %%ax, %%ss\n"
-            : : "r"(GDT_KERNEL_DATA_SEGMENT_SELECTOR));
+                         "movl %1, %%eax\n"
+                         "movw %%ax, %%gs\n"
+            : : "r"(GDT_KERNEL_DATA_SEGMENT_SELECTOR), "r"(GDT_PERCPU_SEGMENT_SELECTOR) : "eax");
 
     /* Far jump to update CS register */
     __asm__ __volatile__("ljmp %0, $1f\n 1:\n" : : "i"(GDT_KERNEL_CODE_SEGMENT_SELECTOR));
+}
+
+/* Set up the GDT */
+void setup_gdt() {
+    /* The bootstrap processor's per-CPU block. Load it before printing:
+       the console counts characters through GS. */
+    gdt_init_table(gdt, smp_cpu(0), sizeof(struct cpu));
+    gdt_load(gdt, &gp);
 
-    printf("GDT loaded successfully. Running self test...\n");
+    printf("GDT for higher half kernel loaded at 0x%x. Running self test...\n", (uint32_t)&gp);
 
     /* Verify that segment registers were loaded correctly */
     unsigned short cs, gs, ds, es, fs, ss;
     __asm__ __volatile__("movw %%cs, %0" : "=r"(cs));
-    printf("CS selector value: %x, expected value: %x\n", cs, GDT_KERNEL_CODE_SEGMENT_SELECTOR);
+    printf("CS selector value: 0x%x, expected value: 0x%x\n", cs, GDT_KERNEL_CODE_SEGMENT_SELECTOR);
 
     __asm__ __volatile__("movw %%gs, %0" : "=r"(gs));
-    printf("GS selector value: %x, expected value: %x\n", gs, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
+    printf("GS selector value: 0x%x, expected value: 0x%x\n", gs, GDT_PERCPU_SEGMENT_SELECTOR);
 
     __asm__ __volatile__("movw %%ds, %0" : "=r"(ds));
-    printf("DS selector value: %x, expected value: %x\n", ds, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
+    printf("DS selector value: 0x%x, expected value: 0x%x\n", ds, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
 
     __asm__ __volatile__("movw %%es, %0" : "=r"(es));
-    printf("ES selector value: %x, expected value: %x\n", es, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
+    printf("ES selector value: 0x%x, expected value: 0x%x\n", es, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
 
     __asm__ __volatile__("movw %%fs, %0" : "=r"(fs));
-    printf("FS selector value: %x, expected value: %x\n", fs, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
+    printf("FS selector value: 0x%x, expected value: 0x%x\n", fs, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
 
     __asm__ __volatile__("movw %%ss, %0" : "=r"(ss));
-    printf("SS selector value: %x, expected value: %x\n", ss, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
+    printf("SS selector value: 0x%x, expected value: 0x%x\n", ss, GDT_KERNEL_DATA_SEGMENT_SELECTOR);
 
     printf("GDT setup and test complete!\n");
 }
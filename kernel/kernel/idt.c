@@ -0,0 +1,102 @@
+#include "idt.h"
+#include "gdt.h"
+#include "interrupts.h"
+#include "pic.h"
+#include <stdio.h>
+#include <stddef.h>
+#include <kernel/debug.h>
+#include <kernel/idle.h>
+#include <kernel/panic.h>
+#include <kernel/percpu.h>
+#include <kernel/sched.h>
+
+/* Define entries and pointer for IDT */
+static struct idt_entry idt[IDT_ENTRIES];
+static struct idt_ptr idtp;
+
+/* Assembly entry points for vectors 0..IDT_STUB_COUNT-1 */
+extern const uint32_t isr_stub_table[IDT_STUB_COUNT];
+extern void lapic_call_stub(void);
+extern void lapic_spurious_stub(void);
+
+static irq_handler_t irq_handlers[IDT_IRQ_COUNT];
+
+/* Counts of interrupts the PIC raised without a real request */
+static uint32_t spurious_irqs;
+
+/* Set up an IDT gate */
+static void idt_set_gate(uint8_t vector, uint32_t handler, uint16_t selector, uint8_t type_attr) {
+    idt[vector].offset_low = handler & 0xFFFF;
+    idt[vector].offset_high = (handler >> 16) & 0xFFFF;
+    idt[vector].selector = selector;
+    idt[vector].zero = 0;
+    idt[vector].type_attr = type_attr;
+}
+
+/* Set up the IDT and remap the PICs; interrupts stay disabled */
+void setup_idt(void) {
+    printf("Setting up IDT...\n");
+
+    for (uint32_t vector = 0; vector < IDT_STUB_COUNT; vector++) {
+        idt_set_gate(vector, isr_stub_table[vector], GDT_KERNEL_CODE_SEGMENT_SELECTOR, IDT_GATE_KERNEL);
+    }
+    idt_set_gate(IDT_LAPIC_CALL, (uint32_t)lapic_call_stub,
+                 GDT_KERNEL_CODE_SEGMENT_SELECTOR, IDT_GATE_KERNEL);
+    idt_set_gate(IDT_LAPIC_SPURIOUS, (uint32_t)lapic_spurious_stub,
+                 GDT_KERNEL_CODE_SEGMENT_SELECTOR, IDT_GATE_KERNEL);
+
+    idtp.limit = sizeof(idt) - 1;
+    idtp.base = (uint32_t)&idt;
+    idt_load();
+
+    pic_init(IDT_IRQ_BASE);
+
+    printf("IDT loaded at 0x%x, IRQs at vectors %u-%u\n",
+           (uint32_t)&idt, IDT_IRQ_BASE, IDT_IRQ_BASE + IDT_IRQ_COUNT - 1);
+}
+
+/* Point this CPU's IDTR at the shared IDT */
+void idt_load(void) {
+    __asm__ __volatile__("lidt %0" : : "m"(idtp));
+}
+
+void irq_register_handler(uint8_t irq, irq_handler_t handler) {
+    if (irq >= IDT_IRQ_COUNT) {
+        debug_error("irq_register_handler: bad IRQ %u", irq);
+        return;
+    }
+
+    uint32_t flags = irq_save();
+    irq_handlers[irq] = handler;
+    pic_unmask(irq);
+    irq_restore(flags);
+}
+
+void interrupt_dispatch(struct interrupt_frame *frame) {
+    // An interrupt that ends a halt is busy time, as is whatever it wakes
+    idle_account();
+
+    if (frame->vector < IDT_EXCEPTIONS) {
+        exception_handler(frame);
+    }
+
+    uint8_t irq = frame->vector - IDT_IRQ_BASE;
+    if (pic_is_spurious(irq)) {
+        spurious_irqs++;
+        return;
+    }
+    this_cpu_inc(irqs);
+
+    // Acknowledge first: a handler may switch away and not come back soon.
+    // Interrupt gates keep IF clear, so the line cannot nest meanwhile.
+    pic_send_eoi(irq);
+
+    if (irq_handlers[irq]) {
+        irq_handlers[irq](frame);
+    } else {
+        debug_warning("Unhandled IRQ %u", irq);
+    }
+
+    // Preempt if the handler woke a thread or ended the time slice
+    sched_irq_exit();
+}
@@ -2,9 +2,29 @@
 #include <stdint.h>
 #include <stdbool.h>
 #include "paging.h"
+#include "interrupts.h"
+#include "../arch/i386/cpu.h"
+#include "../arch/i386/serial.h"
+#include <kernel/acpi.h>
+#include <kernel/bench.h>
+#include <kernel/bootinfo.h>
+#include <kernel/bootprof.h>
+#include <kernel/clocksource.h>
+#include <kernel/completion.h>
+#include <kernel/kstat.h>
+#include <kernel/math64.h>
+#include <kernel/timer.h>
 #include <kernel/tty.h>
 #include <kernel/debug.h>
+#include <kernel/idle.h>
 #include <kernel/panic.h>
+#include <kernel/profiler.h>
+#include <kernel/rcu.h>
+#include <kernel/sched.h>
+#include <kernel/smp.h>
+#include <kernel/spinlock.h>
+#include <kernel/telemetry.h>
+#include <kernel/workqueue.h>
 
 extern uint32_t kernel_virtual_start;
 extern uint32_t kernel_virtual_end;
@@ -32,10 +52,10 @@ static inline int is_higher_half_address(uint32_t addr) {
  */
 void print_kernel_memory_layout(void) {
     printf("Kernel Memory Layout:\n");
-    printf("  Virtual Start:  %x\n", (unsigned)&kernel_virtual_start);
-    printf("  Virtual End:    %x\n", (unsigned)&kernel_virtual_end);
-    printf("  Physical Start: %x\n", (unsigned)&kernel_physical_start);
-    printf("  Physical End:   %x\n", (unsigned)&kernel_physical_end);
+    printf("  Virtual Start:  0x%x\n", (unsigned)&kernel_virtual_start);
+    printf("  Virtual End:    0x%x\n", (unsigned)&kernel_virtual_end);
+    printf("  Physical Start: 0x%x\n", (unsigned)&kernel_physical_start);
+    printf("  Physical End:   0x%x\n", (unsigned)&kernel_physical_end);
     printf("  Virtual Size:   %u KB\n",
         (unsigned)(&kernel_virtual_end - &kernel_virtual_start) / 1024);
 }
@@ -65,20 +85,20 @@ void test_memory_mapping(void) {
     void* page2 = kmalloc_physical_page();
     void* page3 = kmalloc_physical_page();
 
-    printf("  Allocated page 1 at physical: %x, virtual: %x\n",
+    printf("  Allocated page 1 at physical: 0x%x, virtual: 0x%x\n",
         (unsigned)page1, (unsigned)P2V(page1));
-    printf("  Allocated page 2 at physical: %x, virtual: %x\n",
+    printf("  Allocated page 2 at physical: 0x%x, virtual: 0x%x\n",
         (unsigned)page2, (unsigned)P2V(page2));
-    printf("  Allocated page 3 at physical: %x, virtual: %x\n",
+    printf("  Allocated page 3 at physical: 0x%x, virtual: 0x%x\n",
         (unsigned)page3, (unsigned)P2V(page3));
 
     // Choose a test virtual address in user space (not kernel)
     void* test_virt_addr = (void*)0xD0000000;
-    printf("  Mapping virtual %x to physical %x\n",
+    printf("  Mapping virtual 0x%x to physical 0x%x\n",
         (unsigned)test_virt_addr, (unsigned)page1);
 
     // Map the virtual address to the physical page
-    map_page_to_frame(test_virt_addr, page1, PAGE_PRESENT | PAGE_WRITE);
+    map_page_to_frame(test_virt_addr, page1, PAGE_PRESENT | PAGE_WRITE, PAGE_CACHE_WB);
 
     // Test writing to and reading from the mapped memory
     debug_debug("Writing test pattern to mapped memory");
@@ -93,10 +113,10 @@ void test_memory_mapping(void) {
 
     // Read back and verify
     uint32_t read_value = *test_ptr;
-    printf("  Reading back value: %x (expected 0xDEADBEEF)\n", read_value);
+    printf("  Reading back value: 0x%x (expected 0xDEADBEEF)\n", read_value);
 
     if (read_value != 0xDEADBEEF) {
-        debug_error("Memory test failed! Expected 0xDEADBEEF, got %x", read_value);
+        debug_error("Memory test failed! Expected 0xDEADBEEF, got 0x%x", read_value);
     } else {
         debug_info("Memory test passed successfully");
     }
@@ -104,7 +124,7 @@ void test_memory_mapping(void) {
     // Clean up
     debug_debug("Cleaning up test allocations");
     printf("\nCleaning up test allocations:\n");
-    printf("  Unmapping virtual address %x\n", (unsigned)test_virt_addr);
+    printf("  Unmapping virtual address 0x%x\n", (unsigned)test_virt_addr);
     unmap_page(test_virt_addr);
 
     printf("  Freeing physical pages\n");
@@ -113,6 +133,352 @@ void test_memory_mapping(void) {
     kfree_physical_page(page3);
 }
 
+/**
+ * Compare scrolling-heavy console output through the console with writing
+ * directly into the display memory of the same backend
+ */
+void benchmark_terminal_scrolling(void) {
+    const size_t lines = 200;
+    uint64_t console_cycles, direct_cycles;
+
+    terminal_benchmark_scroll(lines, &console_cycles, &direct_cycles);
+    debug_info("Terminal scroll benchmark (%u lines):", (unsigned)lines);
+    debug_info("  Console:       %llu cycles (%llu per line)",
+               console_cycles, console_cycles / lines);
+    debug_info("  Direct:        %llu cycles (%llu per line)",
+               direct_cycles, direct_cycles / lines);
+}
+
+/**
+ * Compare full-screen console fills and scrolls with the display memory
+ * mapped uncached and write-combining
+ */
+void benchmark_console_caching(void) {
+    const size_t passes = 16;
+    struct console_cache_benchmark result;
+
+    terminal_benchmark_cache(passes, &result);
+    debug_info("Console memory type benchmark (%u passes):", (unsigned)passes);
+    debug_info("  Fill   UC: %llu cycles/pass, WC: %llu cycles/pass",
+               result.uc_fill / passes, result.wc_fill / passes);
+    debug_info("  Scroll UC: %llu cycles/pass, WC: %llu cycles/pass",
+               result.uc_scroll / passes, result.wc_scroll / passes);
+}
+
+/* Shared state of the timer test callbacks */
+struct timer_test {
+    struct timer oneshot[4];
+    struct timer periodic;
+    struct timer cancelled;
+    unsigned int periodic_runs;
+    unsigned int remaining;
+};
+
+static void timer_test_oneshot(void *data) {
+    struct timer_test *test = data;
+    test->remaining--;
+}
+
+static void timer_test_periodic(void *data) {
+    struct timer_test *test = data;
+    if (++test->periodic_runs < 5) {
+        timer_add(&test->periodic, test->periodic.expires_ns + 100000000ULL);
+    } else {
+        test->remaining--;
+    }
+}
+
+static void timer_test_cancelled(void *data) {
+    (void)data;
+    debug_error("Cancelled timer fired");
+}
+
+/**
+ * Arm a mix of one-shot, periodic and cancelled timers, sleep until they
+ * have all run, and report how often the CPU was woken to do it
+ */
+void test_timers(void) {
+    static const uint32_t delays_ms[4] = { 10, 25, 250, 600 };
+    static struct timer_test test;
+
+    timer_reset_stats();
+    test.periodic_runs = 0;
+    test.remaining = 5;
+
+    for (int i = 0; i < 4; i++) {
+        timer_init(&test.oneshot[i], timer_test_oneshot, &test);
+        timer_add_after(&test.oneshot[i], delays_ms[i] * 1000000ULL);
+    }
+    timer_init(&test.periodic, timer_test_periodic, &test);
+    timer_add_after(&test.periodic, 100000000ULL);
+    timer_init(&test.cancelled, timer_test_cancelled, &test);
+    timer_add_after(&test.cancelled, 300000000ULL);
+    timer_cancel(&test.cancelled);
+
+    // Sleep until the last timer has run. Interrupts are disabled while
+    // checking, and sti only takes effect after hlt, so no wakeup is lost.
+    for (;;) {
+        interrupts_disable();
+        if (test.remaining == 0) {
+            break;
+        }
+        __asm__ volatile("sti; hlt");
+    }
+    interrupts_enable();
+
+    struct timer_stats stats;
+    timer_get_stats(&stats);
+    uint64_t elapsed_ms = div_u64_u32(ktime_get_ns() - stats.since_ns, 1000000);
+    uint32_t expired = stats.expired ? stats.expired : 1;
+
+    debug_info("Timer test: %u timers expired in %llu ms", stats.expired, elapsed_ms);
+    debug_info("  Wakeups: %u (%llu per second), hardware reprogrammed %u times",
+               stats.wakeups,
+               elapsed_ms ? div_u64_u32((uint64_t)stats.wakeups * 1000, (uint32_t)elapsed_ms) : 0,
+               stats.reprograms);
+    debug_info("  Lateness: mean %llu us, max %llu us",
+               div_u64_u32(stats.late_total_ns, expired * 1000),
+               div_u64_u32(stats.late_max_ns, 1000));
+}
+
+/* Shared state of the thread test */
+struct thread_test {
+    volatile unsigned int sleepers_left;
+    volatile bool stop;
+    volatile uint32_t spins[2];
+    volatile unsigned int spinners_left;
+};
+
+static struct thread_test thread_test;
+
+static void thread_test_sleeper(void *arg) {
+    uint32_t ms = (uint32_t)(uintptr_t)arg;
+    uint64_t start = ktime_get_ns();
+
+    kthread_sleep(ms * 1000000ULL);
+    debug_info("  %s slept %u ms, woke after %llu us", kthread_current()->name, ms,
+               div_u64_u32(ktime_get_ns() - start, 1000));
+    uint32_t flags = irq_save();
+    thread_test.sleepers_left--;
+    irq_restore(flags);
+}
+
+/* Never yields, so only the time slice lets the other spinner run */
+static void thread_test_spinner(void *arg) {
+    volatile uint32_t *spins = arg;
+
+    while (!thread_test.stop) {
+        (*spins)++;
+    }
+    uint32_t flags = irq_save();
+    thread_test.spinners_left--;
+    irq_restore(flags);
+}
+
+/**
+ * Run threads that sleep on the timer wheel, then two that spin without
+ * yielding, and check that the time slice shares the CPU between them
+ */
+void test_threads(void) {
+    static const uint32_t sleeps_ms[3] = { 30, 10, 20 };
+    static const char *const sleeper_names[3] = { "sleeper-30", "sleeper-10", "sleeper-20" };
+
+    debug_info("Thread test: sleepers");
+    thread_test.sleepers_left = 3;
+    for (int i = 0; i < 3; i++) {
+        if (!kthread_create(sleeper_names[i], thread_test_sleeper, (void*)(uintptr_t)sleeps_ms[i])) {
+            thread_test.sleepers_left--;
+        }
+    }
+    while (thread_test.sleepers_left) {
+        kthread_sleep(5000000ULL);
+    }
+
+    thread_test.stop = false;
+    thread_test.spinners_left = 2;
+    const struct kstat *preemptions = kstat_find("sched.preemptions");
+    uint64_t preemptions_before = preemptions ? kstat_read(preemptions) : 0;
+    kthread_create("spinner-a", thread_test_spinner, (void*)&thread_test.spins[0]);
+    kthread_create("spinner-b", thread_test_spinner, (void*)&thread_test.spins[1]);
+    kthread_sleep(100000000ULL);
+    sched_dump();
+    thread_test.stop = true;
+    while (thread_test.spinners_left) {
+        kthread_yield();
+    }
+
+    debug_info("Thread test: spinners counted to %u and %u in 100 ms, %llu preemptions",
+               thread_test.spins[0], thread_test.spins[1],
+               preemptions ? kstat_read(preemptions) - preemptions_before : 0);
+    if (!thread_test.spins[0] || !thread_test.spins[1]) {
+        debug_error("Thread test: a spinner never ran, preemption is broken");
+    }
+}
+
+/* Shared state of the work queue test */
+struct work_test {
+    struct completion done;
+    volatile uint32_t outstanding;  /* Items queued and not yet finished */
+    volatile uint32_t sum;
+    volatile uint32_t failures;
+};
+
+static struct work_test work_test = { COMPLETION_INIT, 0, 0, 0 };
+
+#define WORK_TEST_RANGE 4096
+#define WORK_TEST_LEAF  16
+
+static void work_test_item(void *arg);
+
+/* Queue the numbers first..first+count-1, packed into the argument */
+static void work_test_queue(uint32_t first, uint32_t count) {
+    __atomic_add_fetch(&work_test.outstanding, 1, __ATOMIC_RELAXED);
+    if (!queue_work(work_test_item, (void*)(uintptr_t)(first << 16 | count))) {
+        __atomic_add_fetch(&work_test.failures, 1, __ATOMIC_RELAXED);
+        work_test_item((void*)(uintptr_t)(first << 16 | count));
+    }
+}
+
+/* Sum a small range, or split it in two for other workers to steal */
+static void work_test_item(void *arg) {
+    uint32_t first = (uint32_t)(uintptr_t)arg >> 16;
+    uint32_t count = (uint32_t)(uintptr_t)arg & 0xFFFF;
+
+    if (count > WORK_TEST_LEAF) {
+        work_test_queue(first, count / 2);
+        work_test_queue(first + count / 2, count - count / 2);
+    } else {
+        uint32_t sum = 0;
+        for (uint32_t i = first; i < first + count; i++) {
+            sum += i;
+        }
+        __atomic_add_fetch(&work_test.sum, sum, __ATOMIC_RELAXED);
+    }
+    if (__atomic_sub_fetch(&work_test.outstanding, 1, __ATOMIC_ACQ_REL) == 0) {
+        complete(&work_test.done);
+    }
+}
+
+/**
+ * Sum a range by splitting it across the work queue, so that workers
+ * steal from each other, and check the result
+ */
+void test_workqueue(void) {
+    const uint32_t expected = WORK_TEST_RANGE * (WORK_TEST_RANGE - 1) / 2;
+    uint64_t start = ktime_get_ns();
+
+    work_test_queue(0, WORK_TEST_RANGE);
+    wait_for_completion(&work_test.done);
+
+    debug_info("Work queue test: summed 0..%u in %llu us, %u items did not fit",
+               WORK_TEST_RANGE - 1, div_u64_u32(ktime_get_ns() - start, 1000),
+               work_test.failures);
+    if (work_test.sum != expected) {
+        debug_error("Work queue test: sum %u, expected %u", work_test.sum, expected);
+    }
+    workqueue_dump();
+}
+
+/* Replaced and retired by the RCU test */
+struct rcu_test_config {
+    struct rcu_head rcu;        /* Must stay first */
+    uint32_t version;
+};
+
+static struct rcu_test_config rcu_test_configs[2] = { { { 0, 0 }, 1 }, { { 0, 0 }, 2 } };
+static struct rcu_test_config *rcu_test_current = &rcu_test_configs[0];
+static volatile uint32_t rcu_test_retired;
+
+static void rcu_test_retire(struct rcu_head *head) {
+    rcu_test_retired = ((struct rcu_test_config*)head)->version;
+}
+
+/**
+ * Publish a new copy of a structure, retire the old one with call_rcu()
+ * and check that synchronize_rcu() waits out its callback
+ */
+void test_rcu(void) {
+    rcu_read_lock();
+    uint32_t seen = rcu_dereference(rcu_test_current)->version;
+    rcu_read_unlock();
+
+    struct rcu_test_config *old = rcu_test_current;
+    rcu_assign_pointer(rcu_test_current, &rcu_test_configs[1]);
+    call_rcu(&old->rcu, rcu_test_retire);
+
+    uint64_t start = ktime_get_ns();
+    synchronize_rcu();
+    // Callbacks run in the order queued, so the retire ran before we woke
+    uint64_t elapsed = ktime_get_ns() - start;
+
+    debug_info("RCU test: read version %u, retired version %u, grace period %llu us",
+               seen, rcu_test_retired, div_u64_u32(elapsed, 1000));
+    if (rcu_test_retired != 1) {
+        debug_error("RCU test: retired version %u, expected 1", rcu_test_retired);
+    }
+}
+
+/* How long the serial wait test leaves a reader waiting for input */
+#define SERIAL_WAIT_TEST_NS 100000000ULL
+
+struct serial_wait_test {
+    volatile bool done;
+    bool received;
+    uint64_t cycles;            /* CPU time the reader used */
+};
+
+static void serial_wait_reader(void *arg) {
+    struct serial_wait_test *test = arg;
+    uint8_t byte;
+
+    test->received = serial_read_byte_timeout(SERIAL_COM1_PORT, &byte, SERIAL_WAIT_TEST_NS);
+
+    uint32_t flags = irq_save();
+    struct thread *self = kthread_current();
+    test->cycles = self->cpu_cycles + (rdtsc() - self->run_start);
+    test->done = true;
+    irq_restore(flags);
+}
+
+/**
+ * Leave a thread waiting for serial input that does not come
+ * @param interrupts Whether the reader sleeps on the receive interrupt or polls
+ * @return Share of the CPU the reader used, in percent
+ */
+static uint32_t measure_serial_wait(bool interrupts) {
+    struct serial_wait_test test = { false, false, 0 };
+
+    serial_set_rx_interrupts(interrupts);
+    uint64_t start = rdtsc();
+    if (!kthread_create("serial-wait", serial_wait_reader, &test)) {
+        return 0;
+    }
+    while (!test.done) {
+        kthread_sleep(10000000ULL);
+    }
+    uint64_t elapsed = rdtsc() - start;
+
+    if (test.received) {
+        debug_warning("Serial wait test: input arrived, the figure is low");
+    }
+    // Both well under 2^32 cycles per percent point at any realistic clock
+    uint32_t percent_cycles = (uint32_t)div_u64_u32(elapsed, 100);
+    return percent_cycles ? (uint32_t)div_u64_u32(test.cycles, percent_cycles) : 0;
+}
+
+/**
+ * Compare the CPU a thread waiting for serial input burns when it polls
+ * the UART with what it uses sleeping on the receive interrupt
+ */
+void test_serial_wait(void) {
+    uint32_t polling = measure_serial_wait(false);
+    uint32_t sleeping = measure_serial_wait(true);
+
+    debug_info("Serial wait test: a reader waiting %u ms used %u%% of the CPU polling, "
+               "%u%% sleeping on the receive interrupt",
+               (unsigned)(SERIAL_WAIT_TEST_NS / 1000000), polling, sleeping);
+}
+
 /**
  * Kernel main function
  * Entry point after boot sequence completes
@@ -138,7 +504,7 @@ void kernel_main(void) {
     test_debugging_levels();
 
     // Display kernel main address
-    printf("Kernel Main function called at virtual address %x!\n", (unsigned)&kernel_main);
+    printf("Kernel Main function called at virtual address 0x%x!\n", (unsigned)&kernel_main);
 
     // Check if kernel is running in higher half
     if (is_higher_half_address((unsigned)&kernel_main)) {
@@ -152,10 +518,69 @@ void kernel_main(void) {
     print_kernel_memory_layout();
 
     // Initialize paging (if not already done by boot)
+    bootprof_mark("init_paging");
     init_paging();
     print_paging_info();
 
+    // Text memory is write-only for the console, let the CPU combine stores
+    bootprof_mark("console setup");
+    terminal_use_write_combining();
+
+    // Switch to the graphical console if the bootloader set up a framebuffer
+    if (boot_info.framebuffer.present) {
+        if (terminal_use_framebuffer(&boot_info.framebuffer)) {
+            debug_info("Console moved to the linear framebuffer");
+        } else {
+            debug_warning("Framebuffer unusable, staying in VGA text mode");
+        }
+    }
+
+    // Find the platform timers and start keeping time
+    bootprof_mark("acpi_init");
+    acpi_init();
+    bootprof_mark("time_init");
+    time_init();
+    telemetry_init();
+    idle_init();
+    sched_init();
+    rcu_init();
+    workqueue_init();
+    serial_set_rx_interrupts(true);
+    bootprof_mark("smp_init");
+    smp_init();
+    uint64_t boot_ns = ktime_get_ns();
+    debug_info("ktime_get_ns() = %llu, again %llu ns later", boot_ns, ktime_get_ns() - boot_ns);
+
+    // Timers are ready, start taking interrupts
+    interrupts_enable();
+
+#ifdef REDOS_BENCH
+    // The bench kernel only boots far enough to run the benchmarks
+    bench_run_all();
+#endif
+
+    bootprof_mark("test_timers");
+    test_timers();
+
+    bootprof_mark("test_threads");
+    test_threads();
+
+    bootprof_mark("test_workqueue");
+    test_workqueue();
+
+    bootprof_mark("test_rcu");
+    test_rcu();
+
+    bootprof_mark("test_serial_wait");
+    test_serial_wait();
+
+    // Report what sampling costs, then profile the rest of the boot
+    struct profiler_overhead overhead;
+    profiler_measure_overhead(PROFILER_HZ, PROFILER_BACKTRACE, &overhead);
+    profiler_start(PROFILER_HZ, PROFILER_BACKTRACE);
+
     // Test memory allocation and mapping
+    bootprof_mark("test_memory_mapping");
     test_memory_mapping();
 
     // Display updated paging info
@@ -165,7 +590,13 @@ void kernel_main(void) {
     debug_info("Memory dump of kernel start area");
     debug_hex_dump(&kernel_virtual_start, 128);
 
+    // Measure console scrolling cost
+    bootprof_mark("console benchmarks");
+    benchmark_terminal_scrolling();
+    benchmark_console_caching();
+
     // Test debug output target switching
+    bootprof_mark("debug target tests");
     debug_info("Testing debug output targets");
     debug_set_target(DEBUG_TARGET_VGA);
     debug_info("This message should only appear on VGA (not in serial log)");
@@ -174,6 +605,17 @@ void kernel_main(void) {
     debug_set_target(DEBUG_TARGET_ALL);
     debug_info("This message should appear in both VGA and serial log");
 
+    // Where the boot time went
+    profiler_stop();
+    profiler_dump();
+    bootprof_report();
+    kstat_dump();
+#ifdef KERNEL_LOCKSTAT
+    lockstat_dump();
+#endif
+    smp_dump();
+    telemetry_update();
+
     // Final boot success message
     debug_info("RedOS successfully booted in higher half mode!");
     printf("\nRedOS successfully booted in higher half mode!\n");
@@ -0,0 +1,91 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <interrupts.h>
+#include <kernel/debug.h>
+#include <kernel/kstat.h>
+#include <kernel/smp.h>
+
+/* End of the .kstat section, from the linker script */
+extern struct kstat __kstat_end[];
+
+/**
+ * @return Number of counters in the registry
+ */
+size_t kstat_count(void) {
+    return (size_t)(__kstat_end - __kstat_start);
+}
+
+/**
+ * Get a counter by position
+ * @param index Position in link order
+ * @return The counter, or NULL if index is out of range
+ */
+const struct kstat *kstat_at(size_t index) {
+    return index < kstat_count() ? &__kstat_start[index] : NULL;
+}
+
+/**
+ * Find a counter by name
+ * @param name Full name, e.g. "frame.allocs"
+ * @return The counter, or NULL if there is none
+ */
+const struct kstat *kstat_find(const char *name) {
+    for (struct kstat *stat = __kstat_start; stat < __kstat_end; stat++) {
+        if (strcmp(stat->name, name) == 0) {
+            return stat;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Read a counter. Another CPU's slot is read without stopping it, so a
+ * counter it is bumping right now may be caught between the add and the adc.
+ * @param stat Counter from the registry
+ * @return Sum of every CPU's slot
+ */
+uint64_t kstat_read(const struct kstat *stat) {
+    size_t slot = (size_t)(stat - __kstat_start);
+    uint64_t value = 0;
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        value += ((volatile uint64_t *)smp_cpu(i)->kstats)[slot];
+    }
+    return value;
+}
+
+/**
+ * Zero every counter on every CPU
+ */
+void kstat_reset(void) {
+    uint32_t flags = irq_save();
+    for (uint32_t i = 0; i < smp_cpu_count(); i++) {
+        memset(smp_cpu(i)->kstats, 0, kstat_count() * sizeof(uint64_t));
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Print every counter, sorted by name so related counters stay together
+ * whatever order the linker placed them in
+ */
+void kstat_dump(void) {
+    const struct kstat *last = NULL;
+    size_t count = kstat_count();
+
+    // Selection by name: the registry is small and has no room to sort in
+    for (size_t printed = 0; printed < count; printed++) {
+        const struct kstat *next = NULL;
+        for (const struct kstat *stat = __kstat_start; stat < __kstat_end; stat++) {
+            if ((!last || strcmp(stat->name, last->name) > 0) &&
+                (!next || strcmp(stat->name, next->name) < 0)) {
+                next = stat;
+            }
+        }
+        if (!next) {
+            break;
+        }
+        debug_info("kstat: %-28s %llu", next->name, kstat_read(next));
+        last = next;
+    }
+}
@@ -0,0 +1,46 @@
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/ksyms.h>
+
+/* Weak so the first link pass, which has no table yet, still links */
+extern const struct ksym_table ksym_table __attribute__((weak));
+
+/**
+ * Find the function holding an address by binary search
+ * @param addr Code address
+ * @param offset If not NULL, set to the distance from the function start
+ * @return Function name, or NULL if unknown
+ */
+const char *ksym_lookup(uintptr_t addr, uint32_t *offset) {
+    const struct ksym_table *table = &ksym_table;
+
+    if (!table || table->count == 0 ||
+        addr < table->addresses[0] || addr >= table->end) {
+        return NULL;
+    }
+
+    // Last symbol at or below addr
+    uint32_t low = 0;
+    uint32_t high = table->count;
+    while (high - low > 1) {
+        uint32_t mid = low + (high - low) / 2;
+        if (table->addresses[mid] <= addr) {
+            low = mid;
+        } else {
+            high = mid;
+        }
+    }
+
+    if (offset) {
+        *offset = addr - table->addresses[low];
+    }
+    return table->names + table->name_offsets[low];
+}
+
+/**
+ * @return Number of symbols in the table
+ */
+size_t ksym_count(void) {
+    const struct ksym_table *table = &ksym_table;
+    return table ? table->count : 0;
+}
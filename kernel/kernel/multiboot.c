@@ -1,7 +1,9 @@
 #include "multiboot2.h"
 #include <stdio.h>
 #include <stdint.h>
+#include <string.h>
 #include <kernel/tty.h>
+#include <kernel/bootinfo.h>
 
 /* Define the virtual base address for kernel */
 #define KERNEL_VIRTUAL_BASE 0xC0000000
@@ -11,21 +13,63 @@ static inline void* P2V(void* addr) {
     return (void*)((uint32_t) addr + KERNEL_VIRTUAL_BASE);
 }
 
+/* Boot information kept for the rest of the kernel */
+struct boot_info boot_info;
+
+/* Record the framebuffer the bootloader set up for us */
+static void save_framebuffer(const struct multiboot_tag_framebuffer *tag) {
+    struct boot_framebuffer *fb = &boot_info.framebuffer;
+
+    fb->present = true;
+    fb->address = tag->common.framebuffer_addr;
+    fb->pitch = tag->common.framebuffer_pitch;
+    fb->width = tag->common.framebuffer_width;
+    fb->height = tag->common.framebuffer_height;
+    fb->bpp = tag->common.framebuffer_bpp;
+    fb->type = tag->common.framebuffer_type;
+
+    if (fb->type == MULTIBOOT_FRAMEBUFFER_TYPE_RGB) {
+        fb->red_position = tag->framebuffer_red_field_position;
+        fb->red_size = tag->framebuffer_red_mask_size;
+        fb->green_position = tag->framebuffer_green_field_position;
+        fb->green_size = tag->framebuffer_green_mask_size;
+        fb->blue_position = tag->framebuffer_blue_field_position;
+        fb->blue_size = tag->framebuffer_blue_mask_size;
+    }
+}
+
+/* Keep the RSDP; an ACPI 2.0 copy replaces an ACPI 1.0 one */
+static void save_acpi_rsdp(const struct multiboot_tag *tag, bool extended) {
+    struct boot_acpi *acpi = &boot_info.acpi;
+    uint32_t length = tag->size - sizeof(struct multiboot_tag);
+
+    if (acpi->present && !extended) {
+        return;
+    }
+    if (length > BOOT_ACPI_RSDP_SIZE) {
+        length = BOOT_ACPI_RSDP_SIZE;
+    }
+
+    memcpy(acpi->rsdp, ((const struct multiboot_tag_new_acpi*)tag)->rsdp, length);
+    acpi->length = length;
+    acpi->present = true;
+}
+
 /* Function to validate multiboot information */
 void validate_boot(unsigned long magic, unsigned long addr) {
     struct multiboot_tag *tag;
     unsigned size;
 
-    printf("Validating multiboot information at virtual address %x\n", addr);
+    printf("Validating multiboot information at virtual address 0x%lx\n", addr);
 
     if (magic != MULTIBOOT2_BOOTLOADER_MAGIC) {
-        printf("Invalid magic number: %x (expected %x)\n",
+        printf("Invalid magic number: 0x%x (expected 0x%x)\n",
             (unsigned)magic, MULTIBOOT2_BOOTLOADER_MAGIC);
         return;
     }
 
     if (addr & 7) {
-        printf("Unaligned multiboot info pointer: %x\n", addr);
+        printf("Unaligned multiboot info pointer: 0x%lx\n", addr);
         return;
     }
 
@@ -33,7 +77,7 @@ void validate_boot(unsigned long magic, unsigned long addr) {
     if (addr < KERNEL_VIRTUAL_BASE) {
         printf("Multiboot info pointer appears to be a physical address, converting...\n");
         addr += KERNEL_VIRTUAL_BASE;
-        printf("Converted to virtual address: %x\n", addr);
+        printf("Converted to virtual address: 0x%lx\n", addr);
     }
 
     size = *(unsigned*)addr;
@@ -43,7 +87,7 @@ void validate_boot(unsigned long magic, unsigned long addr) {
          tag->type != MULTIBOOT_TAG_TYPE_END;
          tag = (struct multiboot_tag*)((multiboot_uint8_t*)tag + ((tag->size + 7) & ~7))) {
 
-        printf("Tag %x, Size %x\n", tag->type, tag->size);
+        printf("Tag 0x%x, Size 0x%x\n", tag->type, tag->size);
 
         switch (tag->type) {
             case MULTIBOOT_TAG_TYPE_CMDLINE:
@@ -57,7 +101,7 @@ void validate_boot(unsigned long magic, unsigned long addr) {
                 break;
 
             case MULTIBOOT_TAG_TYPE_MODULE:
-                printf("Module at %x-%x. Command line %s\n",
+                printf("Module at 0x%x-0x%x. Command line %s\n",
                        ((struct multiboot_tag_module*)tag)->mod_start,
                        ((struct multiboot_tag_module*)tag)->mod_end,
                        ((struct multiboot_tag_module*)tag)->cmdline);
@@ -70,12 +114,33 @@ void validate_boot(unsigned long magic, unsigned long addr) {
                 break;
 
             case MULTIBOOT_TAG_TYPE_BOOTDEV:
-                printf("Boot device %x,%d,%d\n",
+                printf("Boot device 0x%x,%d,%d\n",
                        ((struct multiboot_tag_bootdev*)tag)->biosdev,
                        ((struct multiboot_tag_bootdev*)tag)->slice,
                        ((struct multiboot_tag_bootdev*)tag)->part);
                 break;
 
+            case MULTIBOOT_TAG_TYPE_FRAMEBUFFER: {
+                struct multiboot_tag_framebuffer *fb = (struct multiboot_tag_framebuffer*)tag;
+                printf("Framebuffer at 0x%llx: %ux%u, %u bpp, pitch %u, type %u\n",
+                       fb->common.framebuffer_addr,
+                       fb->common.framebuffer_width,
+                       fb->common.framebuffer_height,
+                       (unsigned)fb->common.framebuffer_bpp,
+                       fb->common.framebuffer_pitch,
+                       (unsigned)fb->common.framebuffer_type);
+                save_framebuffer(fb);
+                break;
+            }
+
+            case MULTIBOOT_TAG_TYPE_ACPI_OLD:
+            case MULTIBOOT_TAG_TYPE_ACPI_NEW:
+                printf("ACPI %s RSDP, %u bytes\n",
+                       tag->type == MULTIBOOT_TAG_TYPE_ACPI_NEW ? "2.0" : "1.0",
+                       tag->size - (unsigned)sizeof(struct multiboot_tag));
+                save_acpi_rsdp(tag, tag->type == MULTIBOOT_TAG_TYPE_ACPI_NEW);
+                break;
+
             case MULTIBOOT_TAG_TYPE_MMAP: {
                 multiboot_memory_map_t *mmap;
                 printf("Memory map:\n");
@@ -84,11 +149,9 @@ void validate_boot(unsigned long magic, unsigned long addr) {
                      (multiboot_uint8_t*)mmap < (multiboot_uint8_t*)tag + tag->size;
                      mmap = (multiboot_memory_map_t*)((unsigned long)mmap + ((struct multiboot_tag_mmap*)tag)->entry_size)) {
 
-                    printf("  Region: base=%x%08x, length=%x%08x, type=%d\n",
-                           (unsigned)(mmap->addr >> 32),
-                           (unsigned)(mmap->addr & 0xffffffff),
-                           (unsigned)(mmap->len >> 32),
-                           (unsigned)(mmap->len & 0xffffffff),
+                    printf("  Region: base=0x%016llx, length=0x%016llx, type=%u\n",
+                           mmap->addr,
+                           mmap->len,
                            (unsigned)mmap->type);
                 }
                 break;
@@ -97,6 +160,6 @@ void validate_boot(unsigned long magic, unsigned long addr) {
     }
 
     tag = (struct multiboot_tag*)((multiboot_uint8_t*)tag + ((tag->size + 7) & ~7));
-    printf("Total multiboot info size: %d bytes\n", (unsigned)tag - addr);
+    printf("Total multiboot info size: %lu bytes\n", (unsigned long)tag - addr);
     printf("Multiboot validation complete!\n");
 }
@@ -0,0 +1,112 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "interrupts.h"
+#include <kernel/debug.h>
+#include <kernel/kstat.h>
+#include <kernel/mutex.h>
+#include <kernel/sched.h>
+#include <kernel/wait.h>
+
+KSTAT_DEFINE(mutex, contended);
+
+void mutex_init(struct mutex *mutex) {
+    mutex->state = MUTEX_UNLOCKED;
+    mutex->owner = NULL;
+    wait_queue_init(&mutex->wait);
+}
+
+/**
+ * Take a mutex
+ * @param mutex Mutex to lock
+ */
+void mutex_lock(struct mutex *mutex) {
+    uint32_t expected = MUTEX_UNLOCKED;
+    if (!__atomic_compare_exchange_n(&mutex->state, &expected, MUTEX_LOCKED, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        // Mark it contended so the holder wakes us, then sleep until a swap
+        // finds it free. With interrupts off the holder cannot unlock
+        // between the swap and the sleep.
+        kstat_inc(mutex, contended);
+        uint32_t flags = irq_save();
+        while (__atomic_exchange_n(&mutex->state, MUTEX_CONTENDED, __ATOMIC_ACQUIRE) !=
+               MUTEX_UNLOCKED) {
+            wait_queue_sleep(&mutex->wait);
+        }
+        irq_restore(flags);
+    }
+    mutex->owner = kthread_current();
+}
+
+/**
+ * Take a mutex if it is free
+ * @param mutex Mutex to lock
+ * @return true if it was taken
+ */
+bool mutex_trylock(struct mutex *mutex) {
+    uint32_t expected = MUTEX_UNLOCKED;
+    if (!__atomic_compare_exchange_n(&mutex->state, &expected, MUTEX_LOCKED, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+    mutex->owner = kthread_current();
+    return true;
+}
+
+/**
+ * Release a mutex, waking a waiter if there may be one
+ * @param mutex Mutex to unlock
+ */
+void mutex_unlock(struct mutex *mutex) {
+    if (mutex->owner != kthread_current()) {
+        debug_error("mutex_unlock: %s does not hold the mutex", kthread_current()->name);
+    }
+    mutex->owner = NULL;
+    if (__atomic_exchange_n(&mutex->state, MUTEX_UNLOCKED, __ATOMIC_RELEASE) == MUTEX_CONTENDED) {
+        wake_up(&mutex->wait);
+    }
+}
+
+void sem_init(struct semaphore *sem, uint32_t count) {
+    sem->count = count;
+    wait_queue_init(&sem->wait);
+}
+
+/**
+ * Take a unit, sleeping until one is available
+ * @param sem Semaphore to take from
+ */
+void sem_down(struct semaphore *sem) {
+    uint32_t flags = irq_save();
+    while (sem->count == 0) {
+        wait_queue_sleep(&sem->wait);
+    }
+    sem->count--;
+    irq_restore(flags);
+}
+
+/**
+ * Take a unit if one is available
+ * @param sem Semaphore to take from
+ * @return true if a unit was taken
+ */
+bool sem_try_down(struct semaphore *sem) {
+    uint32_t flags = irq_save();
+    bool taken = sem->count != 0;
+    if (taken) {
+        sem->count--;
+    }
+    irq_restore(flags);
+    return taken;
+}
+
+/**
+ * Return a unit and wake a waiter for it
+ * @param sem Semaphore to give to
+ */
+void sem_up(struct semaphore *sem) {
+    uint32_t flags = irq_save();
+    sem->count++;
+    wake_up(&sem->wait);
+    irq_restore(flags);
+}
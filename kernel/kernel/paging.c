@@ -1,9 +1,13 @@
 #include "paging.h"
+#include "mmu.h"
 #include <stdio.h>
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
 #include <kernel/debug.h>
+#include <kernel/frame.h>
+#include <kernel/kstat.h>
+#include <kernel/spinlock.h>
 
 extern uint32_t kernel_physical_start;
 extern uint32_t kernel_physical_end;
@@ -13,107 +17,22 @@ extern uint32_t kernel_virtual_end;
 static page_directory_t *kernel_page_directory;
 static page_directory_t *current_page_directory;
 
-#define TOTAL_MEMORY_MB 64
-#define TOTAL_FRAMES (TOTAL_MEMORY_MB * 1024 * 1024 / PAGE_SIZE)
-#define BITMAP_SIZE (TOTAL_FRAMES / 32)
-static uint32_t frame_bitmap[BITMAP_SIZE];
+/* Next free virtual address in the device mapping window */
+static uint32_t next_mmio_address = MMIO_VIRTUAL_BASE;
 
-/**
- * Mark a frame as used in the bitmap
- * @param frame_addr Physical address of the frame
- */
-static void set_frame(uint32_t frame_addr) {
-    uint32_t frame = frame_addr / PAGE_SIZE;
-    uint32_t idx = frame / 32;
-    uint32_t off = frame % 32;
-
-    if (idx >= BITMAP_SIZE) {
-        debug_error("set_frame: Frame index %u out of bounds (max %u)", idx, BITMAP_SIZE-1);
-        return;
-    }
-
-    frame_bitmap[idx] |= (1 << off);
-}
-
-/**
- * Mark a frame as free in the bitmap
- * @param frame_addr Physical address of the frame
- */
-static void clear_frame(uint32_t frame_addr) {
-    uint32_t frame = frame_addr / PAGE_SIZE;
-    uint32_t idx = frame / 32;
-    uint32_t off = frame % 32;
-
-    if (idx >= BITMAP_SIZE) {
-        debug_error("clear_frame: Frame index %u out of bounds (max %u)", idx, BITMAP_SIZE-1);
-        return;
-    }
-
-    frame_bitmap[idx] &= ~(1 << off);
-}
-
-/**
- * Test if a frame is used
- * @param frame_addr Physical address of the frame
- * @return Non-zero if the frame is used, 0 otherwise
+/*
+ * Guards the page tables, current_page_directory and next_mmio_address.
+ * Lock order: paging_lock, frame_lock, debug_lock, tty_lock.
  */
-static uint32_t test_frame(uint32_t frame_addr) {
-    uint32_t frame = frame_addr / PAGE_SIZE;
-    uint32_t idx = frame / 32;
-    uint32_t off = frame % 32;
-
-    if (idx >= BITMAP_SIZE) {
-        debug_error("test_frame: Frame index %u out of bounds (max %u)", idx, BITMAP_SIZE-1);
-        return 0;
-    }
+DEFINE_SPINLOCK(paging_lock);
 
-    return (frame_bitmap[idx] & (1 << off));
-}
-
-/**
- * Find the first free frame
- * @return Frame number or (uint32_t)-1 if no frames are available
- */
-static uint32_t first_free_frame() {
-    for (uint32_t i = 0; i < BITMAP_SIZE; i++) {
-        if (frame_bitmap[i] != 0xFFFFFFFF) {
-            for (uint32_t j = 0; j < 32; j++) {
-                uint32_t bit = 1 << j;
-                if (!(frame_bitmap[i] & bit)) {
-                    return i * 32 + j;
-                }
-            }
-        }
-    }
-
-    debug_error("No free frames available!");
-    return (uint32_t)-1;
-}
-
-/**
- * Allocate a physical frame
- * @return Physical address of the allocated frame, or 0 on failure
- */
-static uint32_t alloc_frame() {
-    uint32_t frame = first_free_frame();
-    if (frame == (uint32_t)-1) {
-        return 0;
-    }
-
-    uint32_t frame_addr = frame * PAGE_SIZE;
-    debug_debug("Allocated frame at physical address %x", frame_addr);
-    set_frame(frame_addr);
-    return frame_addr;
-}
-
-/**
- * Free a physical frame
- * @param frame_addr Physical address of the frame to free
- */
-static void free_frame(uint32_t frame_addr) {
-    debug_debug("Freeing frame at physical address %x", frame_addr);
-    clear_frame(frame_addr);
-}
+KSTAT_DEFINE(paging, page_allocs);
+KSTAT_DEFINE(paging, page_frees);
+KSTAT_DEFINE(paging, maps);
+KSTAT_DEFINE(paging, unmaps);
+KSTAT_DEFINE(paging, tlb_flushes);
+KSTAT_DEFINE(paging, cr3_loads);
+KSTAT_DEFINE(paging, page_tables);
 
 /**
  * Get the page table for a virtual address
@@ -123,76 +42,77 @@ static void free_frame(uint32_t frame_addr) {
  */
 static page_table_t* get_page_table(uint32_t virt_addr, bool create) {
     uint32_t pdindex = virt_addr >> 22;
-    uint32_t *page_table_addr;
+    uint32_t page_table_addr;
 
     // Check if the page table already exists
     if ((*current_page_directory)[pdindex] & PAGE_PRESENT) {
-        page_table_addr = (uint32_t*)((*current_page_directory)[pdindex] & PAGE_FRAME);
-        debug_trace("Using existing page table at physical %x for address %x",
-                   (unsigned)page_table_addr, virt_addr);
-        return (page_table_t*)P2V(page_table_addr);
+        page_table_addr = (*current_page_directory)[pdindex] & PAGE_FRAME;
+        debug_trace("Using existing page table at physical 0x%x for address 0x%x",
+                   page_table_addr, virt_addr);
+        return (page_table_t*)mmu_phys_to_virt(page_table_addr);
     }
 
     if (create) {
-        page_table_addr = (uint32_t*)alloc_frame();
+        page_table_addr = frame_alloc();
         if (!page_table_addr) {
-            debug_error("Failed to allocate page table for address %x", virt_addr);
+            debug_error("Failed to allocate page table for address 0x%x", virt_addr);
             return NULL;
         }
 
         // Clear the new page table
-        memset(P2V(page_table_addr), 0, PAGE_SIZE);
+        memset(mmu_phys_to_virt(page_table_addr), 0, PAGE_SIZE);
 
         // Add the page table to the page directory
-        (*current_page_directory)[pdindex] = (uint32_t)page_table_addr | PAGE_PRESENT | PAGE_WRITE;
-        debug_trace("Created new page table at physical %x for address %x",
-                   (unsigned)page_table_addr, virt_addr);
-        return (page_table_t*)P2V(page_table_addr);
+        (*current_page_directory)[pdindex] = page_table_addr | PAGE_PRESENT | PAGE_WRITE;
+        kstat_inc(paging, page_tables);
+        debug_trace("Created new page table at physical 0x%x for address 0x%x",
+                   page_table_addr, virt_addr);
+        return (page_table_t*)mmu_phys_to_virt(page_table_addr);
     }
 
     return NULL;
 }
 
+/**
+ * Take over the page directory CR3 points at
+ */
+void paging_init_directory(void) {
+    uint32_t cr3_value = mmu_read_cr3();
+
+    kernel_page_directory = (page_directory_t*)mmu_phys_to_virt(cr3_value);
+    current_page_directory = kernel_page_directory;
+
+    // Set up recursive page directory entry - allows the page directory to map itself
+    // at the highest 4MB of virtual memory
+    (*kernel_page_directory)[1023] = cr3_value | PAGE_PRESENT | PAGE_WRITE;
+
+    // Update the page directory
+    mmu_write_cr3(cr3_value);
+}
+
 /**
  * Initialize the paging system
  */
 void init_paging(void) {
     printf("Initializing paging system...\n");
 
-    // Clear the frame bitmap
-    memset(frame_bitmap, 0, sizeof(frame_bitmap));
+    // Start with every frame free
+    frame_init();
 
     // Mark the first 1MB as used (reserved for BIOS, etc.)
-    for (uint32_t addr = 0; addr < 0x100000; addr += PAGE_SIZE) {
-        set_frame(addr);
-    }
+    frame_reserve_range(0, 0x100000);
 
     // Mark kernel physical memory as used
-    uint32_t kernel_start = (uint32_t)&kernel_physical_start;
-    uint32_t kernel_end = (uint32_t)&kernel_physical_end;
-    printf("Marking kernel physical memory as used: %x - %x\n", kernel_start, kernel_end);
-
-    for (uint32_t addr = kernel_start; addr < kernel_end; addr += PAGE_SIZE) {
-        set_frame(addr);
-    }
-
-    // Get the current page directory from CR3
-    uint32_t cr3_value;
-    __asm__ __volatile__("movl %%cr3, %0" : "=r"(cr3_value));
-
-    // Convert to virtual address
-    kernel_page_directory = (page_directory_t*)P2V((void*)cr3_value);
-    current_page_directory = kernel_page_directory;
-
-    printf("Current page directory at physical: %x, virtual: %x\n",
-        cr3_value, (uint32_t)kernel_page_directory);
+    uint32_t kernel_start = (uint32_t)(uintptr_t)&kernel_physical_start;
+    uint32_t kernel_end = (uint32_t)(uintptr_t)&kernel_physical_end;
+    printf("Marking kernel physical memory as used: 0x%x - 0x%x\n", kernel_start, kernel_end);
+    frame_reserve_range(kernel_start, kernel_end);
 
-    // Set up recursive page directory entry - allows the page directory to map itself
-    // at the highest 4MB of virtual memory
-    (*kernel_page_directory)[1023] = (uint32_t)V2P(kernel_page_directory) | PAGE_PRESENT | PAGE_WRITE;
+    paging_init_directory();
+    printf("Current page directory at physical: 0x%x, virtual: 0x%x\n",
+        mmu_read_cr3(), (uint32_t)(uintptr_t)kernel_page_directory);
 
-    // Update the page directory
-    __asm__ __volatile__("movl %0, %%cr3" : : "r"(cr3_value));
+    init_pat();
 
     debug_info("Paging system initialized successfully");
     printf("Paging system initialized!\n");
@@ -203,14 +123,14 @@ void init_paging(void) {
  * @return Physical address of the allocated page, or NULL on failure
  */
 void* kmalloc_physical_page(void) {
-    uint32_t frame = alloc_frame();
+    uint32_t frame = frame_cache_alloc();
     if (!frame) {
         return NULL;
     }
 
-    void* virt_addr = P2V((void*)frame);
-    memset(virt_addr, 0, PAGE_SIZE);
-    return (void*)frame;
+    memset(mmu_phys_to_virt(frame), 0, PAGE_SIZE);
+    kstat_inc(paging, page_allocs);
+    return (void*)(uintptr_t)frame;
 }
 
 /**
@@ -222,7 +142,8 @@ void kfree_physical_page(void* addr) {
         return;
     }
 
-    free_frame((uint32_t)addr);
+    frame_cache_free((uint32_t)(uintptr_t)addr);
+    kstat_inc(paging, page_frees);
 }
 
 /**
@@ -230,25 +151,32 @@ void kfree_physical_page(void* addr) {
  * @param virtual_addr Virtual address to map
  * @param physical_addr Physical address to map to
  * @param flags Page flags (PAGE_PRESENT, PAGE_WRITE, etc.)
+ * @param cache Memory type of the mapping
  */
-void map_page_to_frame(void* virtual_addr, void* physical_addr, uint32_t flags) {
-    uint32_t virt_addr = (uint32_t)virtual_addr;
-    uint32_t phys_addr = (uint32_t)physical_addr;
+void map_page_to_frame(void* virtual_addr, void* physical_addr, uint32_t flags,
+                       enum page_cache_type cache) {
+    uint32_t virt_addr = (uint32_t)(uintptr_t)virtual_addr;
+    uint32_t phys_addr = (uint32_t)(uintptr_t)physical_addr;
     uint32_t ptindex = (virt_addr >> 12) & 0x3FF;
 
-    debug_debug("Mapping virtual %x to physical %x with flags %x",
+    debug_debug("Mapping virtual 0x%x to physical 0x%x with flags 0x%x",
                virt_addr, phys_addr, flags);
 
+    uint32_t irq_flags = spin_lock_irqsave(&paging_lock);
     page_table_t *table = get_page_table(virt_addr, true);
     if (!table) {
-        debug_error("Failed to get page table for virtual address %x", virt_addr);
+        spin_unlock_irqrestore(&paging_lock, irq_flags);
+        debug_error("Failed to get page table for virtual address 0x%x", virt_addr);
         return;
     }
 
-    (*table)[ptindex] = (phys_addr & PAGE_FRAME) | (flags & 0xFFF) | PAGE_PRESENT;
+    (*table)[ptindex] = (phys_addr & PAGE_FRAME) | (flags & 0xFFF & ~PAGE_CACHE_MASK) |
+                        page_cache_flags(cache) | PAGE_PRESENT;
     flush_tlb_entry(virt_addr);
+    kstat_inc(paging, maps);
+    spin_unlock_irqrestore(&paging_lock, irq_flags);
 
-    debug_trace("Mapped virtual %x to physical %x (PD idx: %u, PT idx: %u)",
+    debug_trace("Mapped virtual 0x%x to physical 0x%x (PD idx: %u, PT idx: %u)",
                virt_addr, phys_addr, virt_addr >> 22, ptindex);
 }
 
@@ -257,32 +185,104 @@ void map_page_to_frame(void* virtual_addr, void* physical_addr, uint32_t flags)
  * @param virtual_addr Virtual address to unmap
  */
 void unmap_page(void* virtual_addr) {
-    uint32_t virt_addr = (uint32_t)virtual_addr;
+    uint32_t virt_addr = (uint32_t)(uintptr_t)virtual_addr;
     uint32_t ptindex = (virt_addr >> 12) & 0x3FF;
 
-    debug_debug("Unmapping virtual address %x", virt_addr);
+    debug_debug("Unmapping virtual address 0x%x", virt_addr);
 
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
     page_table_t *table = get_page_table(virt_addr, false);
     if (!table) {
-        debug_warning("Page table not found for virtual address %x", virt_addr);
+        spin_unlock_irqrestore(&paging_lock, flags);
+        debug_warning("Page table not found for virtual address 0x%x", virt_addr);
         return;
     }
 
     // Clear the page table entry
     (*table)[ptindex] = 0;
     flush_tlb_entry(virt_addr);
+    kstat_inc(paging, unmaps);
+    spin_unlock_irqrestore(&paging_lock, flags);
 
-    debug_trace("Unmapped virtual address %x (PD idx: %u, PT idx: %u)",
+    debug_trace("Unmapped virtual address 0x%x (PD idx: %u, PT idx: %u)",
                virt_addr, virt_addr >> 22, ptindex);
 }
 
+/**
+ * Map a range of physical memory (e.g. a device framebuffer) into the
+ * kernel's device mapping window
+ * @param physical_addr Physical start address, need not be page aligned
+ * @param size Size of the range in bytes
+ * @param flags Page flags (PAGE_WRITE, etc.)
+ * @param cache Memory type of the mapping
+ * @return Virtual address corresponding to physical_addr, or NULL if the
+ *         window is exhausted
+ */
+void* map_physical_region(uint32_t physical_addr, uint32_t size, uint32_t flags,
+                          enum page_cache_type cache) {
+    uint32_t offset = physical_addr & (PAGE_SIZE - 1);
+    uint32_t first_frame = physical_addr - offset;
+    uint32_t pages = (offset + size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    // Claim the window range under the lock; mapping it needs no more care
+    uint32_t irq_flags = spin_lock_irqsave(&paging_lock);
+    uint32_t virt_base = next_mmio_address;
+    bool fits = pages <= (MMIO_VIRTUAL_END - virt_base) / PAGE_SIZE;
+    if (fits) {
+        next_mmio_address += pages * PAGE_SIZE;
+    }
+    spin_unlock_irqrestore(&paging_lock, irq_flags);
+
+    if (!fits) {
+        debug_error("map_physical_region: no room to map %u pages at 0x%x", pages, physical_addr);
+        return NULL;
+    }
+
+    for (uint32_t i = 0; i < pages; i++) {
+        map_page_to_frame((void*)(uintptr_t)(virt_base + i * PAGE_SIZE),
+                          (void*)(uintptr_t)(first_frame + i * PAGE_SIZE), flags, cache);
+    }
+
+    debug_info("Mapped physical 0x%x-0x%x at virtual 0x%x",
+               first_frame, first_frame + pages * PAGE_SIZE - 1, virt_base);
+    return (void*)(uintptr_t)(virt_base + offset);
+}
+
+/**
+ * Change the memory type of pages that are already mapped
+ * @param virtual_addr Start of the range, need not be page aligned
+ * @param size Size of the range in bytes
+ * @param cache New memory type
+ */
+void set_region_cache_type(void* virtual_addr, uint32_t size, enum page_cache_type cache) {
+    uint32_t start = (uint32_t)(uintptr_t)virtual_addr & PAGE_FRAME;
+    uint32_t end = (uint32_t)(uintptr_t)virtual_addr + size;
+    uint32_t bits = page_cache_flags(cache);
+
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
+    for (uint32_t addr = start; addr < end; addr += PAGE_SIZE) {
+        page_table_t *table = get_page_table(addr, false);
+        uint32_t *entry = table ? &(*table)[(addr >> 12) & 0x3FF] : NULL;
+        if (!entry || !(*entry & PAGE_PRESENT)) {
+            debug_warning("set_region_cache_type: 0x%x is not mapped", addr);
+            continue;
+        }
+        *entry = (*entry & ~PAGE_CACHE_MASK) | bits;
+        flush_tlb_entry(addr);
+    }
+    spin_unlock_irqrestore(&paging_lock, flags);
+
+    // Drop lines cached under the old type
+    mmu_wbinvd();
+}
+
 /**
  * Get the physical address for a virtual address
  * @param virtual_addr Virtual address
  * @return Physical address or NULL if not mapped
  */
 void* get_physical_address(void* virtual_addr) {
-    uint32_t virt_addr = (uint32_t)virtual_addr;
+    uint32_t virt_addr = (uint32_t)(uintptr_t)virtual_addr;
     uint32_t ptindex = (virt_addr >> 12) & 0x3FF;
 
     page_table_t *table = get_page_table(virt_addr, false);
@@ -296,7 +296,7 @@ void* get_physical_address(void* virtual_addr) {
 
     uint32_t frame_addr = (*table)[ptindex] & PAGE_FRAME;
     uint32_t offset = virt_addr & 0xFFF;
-    return (void*)(frame_addr + offset);
+    return (void*)(uintptr_t)(frame_addr + offset);
 }
 
 /**
@@ -304,10 +304,13 @@ void* get_physical_address(void* virtual_addr) {
  * @param dir Pointer to the new page directory
  */
 void switch_page_directory(page_directory_t *dir) {
+    uint32_t flags = spin_lock_irqsave(&paging_lock);
     current_page_directory = dir;
-    __asm__ __volatile__("movl %0, %%cr3" : : "r"((uint32_t)V2P(dir)));
-    debug_debug("Switched to page directory at virtual %x, physical %x",
-               (unsigned)dir, (unsigned)V2P(dir));
+    mmu_write_cr3(mmu_virt_to_phys(dir));
+    kstat_inc(paging, cr3_loads);
+    spin_unlock_irqrestore(&paging_lock, flags);
+    debug_debug("Switched to page directory at virtual 0x%x, physical 0x%x",
+               (unsigned)(uintptr_t)dir, mmu_virt_to_phys(dir));
 }
 
 /**
@@ -315,17 +318,15 @@ void switch_page_directory(page_directory_t *dir) {
  * @param addr Virtual address to flush
  */
 void flush_tlb_entry(uint32_t addr) {
-    __asm__ __volatile__("invlpg (%0)" : : "r"(addr) : "memory");
+    mmu_invlpg(addr);
+    kstat_inc(paging, tlb_flushes);
 }
 
 /**
  * Enable paging
  */
 void enable_paging(void) {
-    uint32_t cr0;
-    __asm__ __volatile__("movl %%cr0, %0" : "=r"(cr0));
-    cr0 |= 0x80000000;
-    __asm__ __volatile__("movl %0, %%cr0" : : "r"(cr0));
+    mmu_write_cr0(mmu_read_cr0() | CR0_PG);
     debug_info("Paging enabled");
 }
 
@@ -333,10 +334,7 @@ void enable_paging(void) {
  * Disable paging
  */
 void disable_paging(void) {
-    uint32_t cr0;
-    __asm__ __volatile__("movl %%cr0, %0" : "=r"(cr0));
-    cr0 &= ~0x80000000;
-    __asm__ __volatile__("movl %0, %%cr0" : : "r"(cr0));
+    mmu_write_cr0(mmu_read_cr0() & ~CR0_PG);
     debug_info("Paging disabled");
 }
 
@@ -345,9 +343,7 @@ void disable_paging(void) {
  * @return true if paging is enabled, false otherwise
  */
 bool is_paging_enabled(void) {
-    uint32_t cr0;
-    __asm__ __volatile__("movl %%cr0, %0" : "=r"(cr0));
-    return (cr0 & 0x80000000) != 0;
+    return (mmu_read_cr0() & CR0_PG) != 0;
 }
 
 /**
@@ -357,26 +353,18 @@ void print_paging_info(void) {
     printf("Paging Information:\n");
     printf("  Paging enabled: %s\n", is_paging_enabled() ? "YES" : "NO");
 
-    uint32_t cr3_value;
-    __asm__ __volatile__("movl %%cr3, %0" : "=r"(cr3_value));
-    printf("  Page Directory (CR3): %x (Physical)\n", cr3_value);
-    printf("  Page Directory Virtual: %x\n", (uint32_t)current_page_directory);
-
-    uint32_t used_frames = 0;
-    for (uint32_t i = 0; i < BITMAP_SIZE; i++) {
-        for (uint32_t j = 0; j < 32; j++) {
-            if (frame_bitmap[i] & (1 << j)) {
-                used_frames++;
-            }
-        }
-    }
+    uint32_t cr3_value = mmu_read_cr3();
+    printf("  Page Directory (CR3): 0x%x (Physical)\n", cr3_value);
+    printf("  Page Directory Virtual: 0x%x\n", (uint32_t)(uintptr_t)current_page_directory);
+
+    uint32_t used_frames = frame_used_count();
 
     printf("  Used physical frames: %u/%u (%u KB)\n",
-        used_frames, TOTAL_FRAMES, used_frames * PAGE_SIZE / 1024);
+        used_frames, FRAME_COUNT, used_frames * PAGE_SIZE / 1024);
     printf("  Free physical frames: %u/%u (%u KB)\n",
-        TOTAL_FRAMES - used_frames, TOTAL_FRAMES,
-        (TOTAL_FRAMES - used_frames) * PAGE_SIZE / 1024);
+        FRAME_COUNT - used_frames, FRAME_COUNT,
+        (FRAME_COUNT - used_frames) * PAGE_SIZE / 1024);
 
-    debug_trace("Page directory at physical %x, virtual %x",
-               cr3_value, (unsigned)current_page_directory);
+    debug_trace("Page directory at physical 0x%x, virtual 0x%x",
+               cr3_value, (unsigned)(uintptr_t)current_page_directory);
 }
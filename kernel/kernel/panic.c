@@ -1,7 +1,11 @@
 #include <stdio.h>
 #include <stdarg.h>
 #include <stdint.h>
+#include <interrupts.h>
+#include <kernel/backtrace.h>
 #include <kernel/debug.h>
+#include <kernel/ksyms.h>
+#include <kernel/panic.h>
 
 /* Function to dump registers for debugging (called by panic handlers) */
 void dump_registers(void) {
@@ -39,18 +43,27 @@ void dump_registers(void) {
 
     /* Print register values */
     debug_error("Register dump:");
-    debug_error("EAX: %x    EBX: %x    ECX: %x    EDX: %x", eax, ebx, ecx, edx);
-    debug_error("ESI: %x    EDI: %x    EBP: %x    ESP: %x", esi, edi, ebp, esp);
-    debug_error("EIP: %x    EFLAGS: %x", eip, eflags);
-    debug_error("CR0: %x    CR2: %x    CR3: %x    CR4: %x", cr0, cr2, cr3, cr4);
+    debug_error("EAX: 0x%08x    EBX: 0x%08x    ECX: 0x%08x    EDX: 0x%08x", eax, ebx, ecx, edx);
+    debug_error("ESI: 0x%08x    EDI: 0x%08x    EBP: 0x%08x    ESP: 0x%08x", esi, edi, ebp, esp);
+    uint32_t offset;
+    const char* symbol = ksym_lookup(eip, &offset);
+    if (symbol) {
+        debug_error("EIP: 0x%08x    EFLAGS: 0x%08x    (%s+0x%x)", eip, eflags, symbol, offset);
+    } else {
+        debug_error("EIP: 0x%08x    EFLAGS: 0x%08x", eip, eflags);
+    }
+    debug_error("CR0: 0x%08x    CR2: 0x%08x    CR3: 0x%08x    CR4: 0x%08x", cr0, cr2, cr3, cr4);
 }
 
-/* Kernel panic handler - prints message and halts */
+/* Print the panic report with a backtrace from eip/ebp, then halt */
 __attribute__((noreturn))
-void panic(const char* message) {
+static void panic_halt(const char* message, uint32_t eip, uint32_t ebp) {
     /* Disable interrupts */
     __asm__ volatile("cli");
 
+    /* The panic may have interrupted a message; print through it anyway */
+    debug_break_locks();
+
     /* Print panic message to all available outputs */
     debug_set_target(DEBUG_TARGET_ALL);
 
@@ -62,8 +75,9 @@ void panic(const char* message) {
     /* Print the panic message */
     debug_error("PANIC: %s", message);
 
-    /* Dump registers to aid debugging */
+    /* Dump registers and the call chain to aid debugging */
     dump_registers();
+    backtrace_print(eip, ebp);
 
     /* Print system halt message */
     debug_error("System halted.");
@@ -78,6 +92,15 @@ void panic(const char* message) {
     __builtin_unreachable();
 }
 
+/* Kernel panic handler - prints message and halts */
+__attribute__((noreturn))
+void panic(const char* message) {
+    /* The backtrace starts here, in panic() itself */
+    uint32_t eip;
+    __asm__ volatile ("1: movl $1b, %0" : "=r"(eip));
+    panic_halt(message, eip, (uint32_t)__builtin_frame_address(0));
+}
+
 /* Kernel panic handler with formatted message */
 __attribute__((noreturn))
 void panicf(const char* format, ...) {
@@ -95,7 +118,7 @@ void panicf(const char* format, ...) {
 
 /* Handler for unhandled exceptions */
 __attribute__((noreturn))
-void exception_handler(uint32_t exception_number, uint32_t error_code) {
+void exception_handler(const struct interrupt_frame* frame) {
     /* Define exception names */
     static const char* exception_names[] = {
         "Divide Error",
@@ -124,11 +147,15 @@ void exception_handler(uint32_t exception_number, uint32_t error_code) {
         "Reserved", "Reserved", "Reserved", "Reserved", "Reserved"
     };
 
-    /* Call panic with the exception information */
+    /* Panic with the exception information, backtracing from the faulting code */
+    char message[128];
+    uint32_t exception_number = frame->vector;
     if (exception_number < sizeof(exception_names) / sizeof(exception_names[0])) {
-        panicf("Exception %d (%s), Error Code: %x",
-              exception_number, exception_names[exception_number], error_code);
+        snprintf(message, sizeof(message), "Exception %u (%s), Error Code: 0x%x",
+                 exception_number, exception_names[exception_number], frame->error_code);
     } else {
-        panicf("Unknown Exception %d, Error Code: %x", exception_number, error_code);
+        snprintf(message, sizeof(message), "Unknown Exception %u, Error Code: 0x%x",
+                 exception_number, frame->error_code);
     }
+    panic_halt(message, frame->eip, frame->ebp);
 }
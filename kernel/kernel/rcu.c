@@ -0,0 +1,182 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/completion.h>
+#include <kernel/kstat.h>
+#include <kernel/percpu.h>
+#include <kernel/rcu.h>
+#include <kernel/smp.h>
+#include <kernel/spinlock.h>
+#include <kernel/timer.h>
+
+/*
+ * Callbacks move through three lists: queued by call_rcu(), waiting for
+ * the grace period in progress, and done. Only one grace period runs at a
+ * time; callbacks queued during it wait for the next one, which starts as
+ * soon as it ends.
+ */
+static struct rcu_head* queued;
+static struct rcu_head** queued_tail = &queued;
+static struct rcu_head* waiting;
+static struct rcu_head* done;
+static struct rcu_head** done_tail = &done;
+
+/* Number of the grace period in progress, or of the last one */
+static uint32_t gp_seq;
+static bool gp_active;
+
+static struct timer poll_timer;
+DEFINE_SPINLOCK(rcu_lock);
+
+KSTAT_DEFINE(rcu, grace_periods);
+KSTAT_DEFINE(rcu, callbacks);
+
+/* Record that this CPU is outside any reader */
+static inline void note_quiescent_state(void) {
+    this_cpu_write(rcu_qs_seq, __atomic_load_n(&gp_seq, __ATOMIC_ACQUIRE));
+}
+
+/* Whether every online CPU has been quiescent since gp_seq started */
+static bool all_cpus_quiescent(void) {
+    for (uint32_t index = 0; index < smp_cpu_count(); index++) {
+        const struct cpu *cpu = smp_cpu(index);
+        if (!__atomic_load_n(&cpu->online, __ATOMIC_ACQUIRE) || cpu->rcu_idle) {
+            continue;
+        }
+        if (__atomic_load_n(&cpu->rcu_qs_seq, __ATOMIC_ACQUIRE) != gp_seq) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/**
+ * End the grace period if it is over and start the next one if callbacks
+ * are queued for it. Called with rcu_lock held.
+ * @return true if callbacks are left waiting or queued
+ */
+static bool advance(void) {
+    if (gp_active && all_cpus_quiescent()) {
+        gp_active = false;
+        kstat_inc(rcu, grace_periods);
+        *done_tail = waiting;
+        while (*done_tail) {
+            done_tail = &(*done_tail)->next;
+        }
+        waiting = NULL;
+    }
+
+    if (!gp_active && queued) {
+        waiting = queued;
+        queued = NULL;
+        queued_tail = &queued;
+        __atomic_store_n(&gp_seq, gp_seq + 1, __ATOMIC_RELEASE);
+        gp_active = true;
+    }
+    return gp_active;
+}
+
+/**
+ * Advance the grace period and run whatever callbacks it made ready
+ */
+static void process_callbacks(void) {
+    uint32_t flags = spin_lock_irqsave(&rcu_lock);
+    bool pending = advance();
+    struct rcu_head *ready = done;
+    done = NULL;
+    done_tail = &done;
+    if (pending && !timer_pending(&poll_timer)) {
+        timer_add_after(&poll_timer, RCU_POLL_NS);
+    }
+    spin_unlock_irqrestore(&rcu_lock, flags);
+
+    while (ready) {
+        struct rcu_head *next = ready->next;
+        ready->func(ready);
+        kstat_inc(rcu, callbacks);
+        ready = next;
+    }
+}
+
+/* Keeps grace periods moving while the CPU is too busy to idle */
+static void poll_expired(void *data) {
+    (void)data;
+    // Readers hold off preemption, so a thread interrupted with the count
+    // at zero was outside them: a quiescent state without a switch
+    if (this_cpu_read(preempt_count) == 0) {
+        note_quiescent_state();
+    }
+    process_callbacks();
+}
+
+void rcu_init(void) {
+    timer_init(&poll_timer, poll_expired, NULL);
+}
+
+/**
+ * Queue a callback for after the next grace period
+ * @param head Embedded in the object the callback frees
+ * @param func Callback, passed head
+ */
+void call_rcu(struct rcu_head *head, rcu_callback_t func) {
+    head->next = NULL;
+    head->func = func;
+
+    uint32_t flags = spin_lock_irqsave(&rcu_lock);
+    *queued_tail = head;
+    queued_tail = &head->next;
+    advance();
+    if (!timer_pending(&poll_timer)) {
+        timer_add_after(&poll_timer, RCU_POLL_NS);
+    }
+    spin_unlock_irqrestore(&rcu_lock, flags);
+}
+
+struct rcu_synchronize {
+    struct rcu_head head;       /* Must stay first */
+    struct completion done;
+};
+
+static void wake_synchronize(struct rcu_head *head) {
+    complete(&((struct rcu_synchronize*)head)->done);
+}
+
+/**
+ * Wait for a grace period. Sleeping is itself a quiescent state for the
+ * caller's CPU, so with the other CPUs idle this ends at the first switch.
+ */
+void synchronize_rcu(void) {
+    struct rcu_synchronize sync;
+    completion_init(&sync.done);
+    call_rcu(&sync.head, wake_synchronize);
+    wait_for_completion(&sync.done);
+}
+
+/**
+ * A thread switch: the thread going off the CPU was not in a reader
+ */
+void rcu_note_context_switch(void) {
+    note_quiescent_state();
+}
+
+/**
+ * Idle loop housekeeping: the idle thread is never in a reader, so note
+ * that and run ready callbacks
+ */
+void rcu_idle_work(void) {
+    note_quiescent_state();
+    if (__atomic_load_n(&gp_active, __ATOMIC_RELAXED) || __atomic_load_n(&done, __ATOMIC_RELAXED)) {
+        process_callbacks();
+    }
+}
+
+void rcu_idle_enter(void) {
+    note_quiescent_state();
+    this_cpu_write(rcu_idle, true);
+}
+
+void rcu_idle_exit(void) {
+    this_cpu_write(rcu_idle, false);
+    // Grace periods must see us busy before we read anything they protect
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
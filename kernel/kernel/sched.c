@@ -0,0 +1,624 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include "../arch/i386/cpu.h"
+#include "interrupts.h"
+#include "paging.h"
+#include <kernel/debug.h>
+#include <kernel/frame.h>
+#include <kernel/idle.h>
+#include <kernel/kstat.h>
+#include <kernel/math64.h>
+#include <kernel/panic.h>
+#include <kernel/percpu.h>
+#include <kernel/rcu.h>
+#include <kernel/sched.h>
+#include <kernel/timer.h>
+
+/* Each stack slot is the stack plus an unmapped guard of the same size */
+#define KSTACK_SLOT_SIZE   (2 * KTHREAD_STACK_SIZE)
+#define KSTACK_SLOTS       ((KSTACK_VIRTUAL_END - KSTACK_VIRTUAL_BASE) / KSTACK_SLOT_SIZE)
+
+/* Defined in switch.S */
+struct thread* switch_to(struct thread* prev, struct thread* next);
+void kthread_trampoline(void);
+
+/* Boot stack from boot.S, which the main thread keeps */
+extern char boot_stack_bottom[];
+extern char boot_stack[];
+
+static struct thread main_thread = {
+    .state = THREAD_RUNNING,
+    .name = "main",
+    .base_priority = SCHED_PRIORITY_DEFAULT,
+    .priority = SCHED_PRIORITY_DEFAULT,
+    .stack_base = (uint32_t)boot_stack_bottom + KERNEL_VIRTUAL_BASE,
+    .stack_top = (uint32_t)boot_stack + KERNEL_VIRTUAL_BASE,
+};
+
+static struct thread* idle_thread;
+static struct thread* all_threads = &main_thread;
+static uint32_t next_thread_id = 1;
+
+/*
+ * One FIFO per priority, with bit n of run_bitmap set while level n is not
+ * empty, so the most urgent runnable thread is a bsf away. The idle thread
+ * is never queued.
+ */
+static struct thread* run_heads[SCHED_PRIORITIES];
+static struct thread* run_tails[SCHED_PRIORITIES];
+static uint32_t run_bitmap;
+
+/* Threads that exited, waiting for their stacks to be freed */
+static struct thread* dead_threads;
+
+/*
+ * Kernel stack window slots in use. Threads only run on the bootstrap
+ * processor, so disabling interrupts is enough to update it.
+ */
+static uint32_t stack_slots[KSTACK_SLOTS / 32];
+static struct timer slice_timer;
+static volatile bool slice_over;
+
+KSTAT_DEFINE(sched, switches);
+KSTAT_DEFINE(sched, preemptions);
+KSTAT_DEFINE(sched, slice_expiries);
+KSTAT_DEFINE(sched, boosts);
+KSTAT_DEFINE(sched, threads_created);
+
+static void enqueue(struct thread* thread) {
+    uint8_t priority = thread->priority;
+
+    thread->state = THREAD_RUNNABLE;
+    thread->next = NULL;
+    if (run_tails[priority]) {
+        run_tails[priority]->next = thread;
+    } else {
+        run_heads[priority] = thread;
+        run_bitmap |= 1u << priority;
+    }
+    run_tails[priority] = thread;
+}
+
+static struct thread* dequeue(void) {
+    if (!run_bitmap) {
+        return NULL;
+    }
+
+    uint32_t priority = (uint32_t)__builtin_ctz(run_bitmap);
+    struct thread* thread = run_heads[priority];
+    run_heads[priority] = thread->next;
+    if (!run_heads[priority]) {
+        run_tails[priority] = NULL;
+        run_bitmap &= ~(1u << priority);
+    }
+    thread->next = NULL;
+    return thread;
+}
+
+/* Take a runnable thread off the middle of its queue */
+static void dequeue_thread(struct thread* thread) {
+    uint8_t priority = thread->priority;
+    struct thread* prev = NULL;
+
+    for (struct thread* t = run_heads[priority]; t; prev = t, t = t->next) {
+        if (t != thread) {
+            continue;
+        }
+        if (prev) {
+            prev->next = t->next;
+        } else {
+            run_heads[priority] = t->next;
+        }
+        if (run_tails[priority] == t) {
+            run_tails[priority] = prev;
+        }
+        if (!run_heads[priority]) {
+            run_bitmap &= ~(1u << priority);
+        }
+        t->next = NULL;
+        return;
+    }
+}
+
+/* True if a queued thread is at least as urgent as the given level */
+static inline bool queued_at_or_above(uint8_t priority) {
+    return (run_bitmap & ((2u << priority) - 1)) != 0;
+}
+
+/* Time-slice only while something as urgent is waiting for the CPU */
+static void update_slice_timer(void) {
+    struct thread* self = this_cpu_read(current);
+
+    if (self != idle_thread && queued_at_or_above(self->priority)) {
+        if (!timer_pending(&slice_timer)) {
+            timer_add_after(&slice_timer, SCHED_SLICE_NS);
+        }
+    } else {
+        timer_cancel(&slice_timer);
+    }
+}
+
+static void slice_expired(void* data) {
+    (void)data;
+    slice_over = true;
+    this_cpu_write(need_resched, true);
+}
+
+static void sleep_expired(void* data) {
+    sched_wakeup(data);
+}
+
+/*
+ * Pick the next thread and switch to it. Called with interrupts disabled;
+ * the caller has already set current->state if it is not to run again.
+ */
+static void schedule(void) {
+    struct thread* prev = this_cpu_read(current);
+    uint64_t now = rdtsc();
+
+    // Preemption only gets here with the count at zero, so a sleep or
+    // yield that left it raised could be inside an RCU read-side section
+    if (this_cpu_read(preempt_count) != 0) {
+        debug_error("schedule: %s switched out with preemption disabled", prev->name);
+    }
+    rcu_note_context_switch();
+
+    prev->cpu_cycles += now - prev->run_start;
+    prev->run_start = now;
+
+    if (prev->state == THREAD_RUNNING && prev != idle_thread) {
+        if (slice_over) {
+            // Used its whole slice: give back a level of boost
+            kstat_inc(sched, slice_expiries);
+            if (prev->priority < prev->base_priority) {
+                prev->priority++;
+            }
+        }
+        if (this_cpu_read(need_resched)) {
+            kstat_inc(sched, preemptions);
+        }
+        enqueue(prev);
+    }
+    this_cpu_write(need_resched, false);
+    slice_over = false;
+
+    struct thread* next = dequeue();
+    if (!next) {
+        next = idle_thread;
+    }
+
+    // A new slice for whoever runs next
+    timer_cancel(&slice_timer);
+    next->state = THREAD_RUNNING;
+    if (next == prev) {
+        update_slice_timer();
+        return;
+    }
+
+    if (prev == idle_thread) {
+        prev->state = THREAD_RUNNABLE;
+    }
+    this_cpu_write(current, next);
+    next->run_start = now;
+    next->switches++;
+    kstat_inc(sched, switches);
+    this_cpu_inc(context_switches);
+    update_slice_timer();
+
+    prev = switch_to(prev, next);
+
+    // Running as current again; prev is whoever ran before us
+    if (prev->state == THREAD_DEAD) {
+        prev->next = dead_threads;
+        dead_threads = prev;
+    }
+}
+
+/*
+ * Ask for a switch if thread is more urgent than the running one. Takes
+ * effect on the way out of the interrupt, or now if interrupts were
+ * enabled, which means the caller is a thread.
+ */
+static void preempt_check(struct thread* thread, uint32_t flags) {
+    struct thread* self = this_cpu_read(current);
+
+    if (self == idle_thread || thread->priority < self->priority) {
+        this_cpu_write(need_resched, true);
+        if ((flags & EFLAGS_IF) && this_cpu_read(preempt_count) == 0) {
+            schedule();
+        }
+    } else {
+        update_slice_timer();
+    }
+}
+
+/**
+ * Allocate and map a stack in the kernel stack window
+ * @return Lowest address of the stack, or 0 if out of memory or slots
+ */
+uint32_t kstack_alloc(void) {
+    // Claim the slot before mapping it: the caller may be preempted, and
+    // another thread must not map over the same pages meanwhile
+    uint32_t flags = irq_save();
+    uint32_t slot = 0;
+    while (slot < KSTACK_SLOTS && (stack_slots[slot / 32] & (1u << (slot % 32)))) {
+        slot++;
+    }
+    if (slot == KSTACK_SLOTS) {
+        irq_restore(flags);
+        return 0;
+    }
+    stack_slots[slot / 32] |= 1u << (slot % 32);
+    irq_restore(flags);
+
+    // The lower half of the slot stays unmapped as the guard
+    uint32_t base = KSTACK_VIRTUAL_BASE + slot * KSTACK_SLOT_SIZE + KTHREAD_STACK_SIZE;
+    for (uint32_t offset = 0; offset < KTHREAD_STACK_SIZE; offset += PAGE_SIZE) {
+        uint32_t frame = frame_alloc();
+        if (!frame) {
+            while (offset > 0) {
+                offset -= PAGE_SIZE;
+                frame_free((uint32_t)(uintptr_t)get_physical_address((void*)(base + offset)));
+                unmap_page((void*)(base + offset));
+            }
+            flags = irq_save();
+            stack_slots[slot / 32] &= ~(1u << (slot % 32));
+            irq_restore(flags);
+            return 0;
+        }
+        map_page_to_frame((void*)(base + offset), (void*)frame, PAGE_PRESENT | PAGE_WRITE,
+                          PAGE_CACHE_WB);
+    }
+    return base;
+}
+
+/**
+ * Unmap a stack from kstack_alloc() and free its frames
+ * @param base Lowest address of the stack
+ */
+void kstack_free(uint32_t base) {
+    uint32_t slot = (base - KSTACK_VIRTUAL_BASE) / KSTACK_SLOT_SIZE;
+
+    for (uint32_t offset = 0; offset < KTHREAD_STACK_SIZE; offset += PAGE_SIZE) {
+        frame_free((uint32_t)(uintptr_t)get_physical_address((void*)(base + offset)));
+        unmap_page((void*)(base + offset));
+    }
+
+    // Only once it is unmapped may kstack_alloc() hand the slot out again
+    uint32_t flags = irq_save();
+    stack_slots[slot / 32] &= ~(1u << (slot % 32));
+    irq_restore(flags);
+}
+
+/* Free the stacks of threads that have exited */
+static void reap_dead_threads(void) {
+    uint32_t flags = irq_save();
+    struct thread* dead = dead_threads;
+    dead_threads = NULL;
+    irq_restore(flags);
+
+    while (dead) {
+        struct thread* next = dead->next;
+
+        flags = irq_save();
+        for (struct thread** link = &all_threads; *link; link = &(*link)->all_next) {
+            if (*link == dead) {
+                *link = dead->all_next;
+                break;
+            }
+        }
+        irq_restore(flags);
+
+        // The struct lives at the top of the stack, so it goes with it
+        kstack_free(dead->stack_base);
+        dead = next;
+    }
+}
+
+static void idle_loop(void* arg) {
+    (void)arg;
+
+    for (;;) {
+        reap_dead_threads();
+        rcu_idle_work();
+        // Anything that becomes runnable preempts us on the way out of the
+        // interrupt that woke it
+        interrupts_disable();
+        cpu_idle(NULL);
+    }
+}
+
+/**
+ * Runs on a new thread's stack after its first switch_to()
+ * @param prev Thread that ran before it
+ */
+__attribute__((noreturn))
+void kthread_start(struct thread* prev) {
+    if (prev->state == THREAD_DEAD) {
+        prev->next = dead_threads;
+        dead_threads = prev;
+    }
+    interrupts_enable();
+
+    struct thread* self = this_cpu_read(current);
+    self->fn(self->arg);
+    kthread_exit();
+}
+
+/**
+ * Create a kernel thread
+ * @param name Name shown by sched_dump(), truncated to fit
+ * @param fn Function the thread runs
+ * @param arg Argument passed to fn
+ * @return The new thread, or NULL if out of memory
+ */
+struct thread* kthread_create(const char* name, kthread_fn_t fn, void* arg) {
+    reap_dead_threads();
+
+    uint32_t base = kstack_alloc();
+    if (!base) {
+        debug_error("kthread_create: no stack for thread %s", name);
+        return NULL;
+    }
+
+    // Keep the thread itself at the top of its stack
+    uint32_t top = base + KTHREAD_STACK_SIZE;
+    struct thread* thread = (struct thread*)(top - sizeof(struct thread));
+    memset(thread, 0, sizeof(*thread));
+
+    size_t length = strlen(name);
+    if (length >= KTHREAD_NAME_SIZE) {
+        length = KTHREAD_NAME_SIZE - 1;
+    }
+    memcpy(thread->name, name, length);
+    thread->stack_base = base;
+    thread->stack_top = (uint32_t)thread;
+    thread->fn = fn;
+    thread->arg = arg;
+    thread->base_priority = SCHED_PRIORITY_DEFAULT;
+    thread->priority = SCHED_PRIORITY_DEFAULT;
+    timer_init(&thread->sleep_timer, sleep_expired, thread);
+
+    // What switch_to() pops: edi, esi, ebx, ebp, then the return address
+    uint32_t* sp = (uint32_t*)thread;
+    *--sp = 0;                                  /* Return address of the trampoline */
+    *--sp = (uint32_t)kthread_trampoline;
+    *--sp = 0;                                  /* ebp, ends backtraces */
+    *--sp = 0;                                  /* ebx */
+    *--sp = 0;                                  /* esi */
+    *--sp = 0;                                  /* edi */
+    thread->esp = (uint32_t)sp;
+
+    uint32_t flags = irq_save();
+    thread->id = next_thread_id++;
+    thread->all_next = all_threads;
+    all_threads = thread;
+    enqueue(thread);
+    kstat_inc(sched, threads_created);
+    if (idle_thread) {
+        preempt_check(thread, flags);
+    }
+    irq_restore(flags);
+
+    return thread;
+}
+
+/**
+ * Give the CPU to the other runnable threads
+ */
+void kthread_yield(void) {
+    uint32_t flags = irq_save();
+    // Yielding is what CPU-bound threads do; without this a boosted thread
+    // would pick itself again
+    struct thread* self = this_cpu_read(current);
+    self->priority = self->base_priority;
+    schedule();
+    irq_restore(flags);
+}
+
+/**
+ * Sleep on the timer wheel
+ * @param ns Nanoseconds to sleep for
+ */
+void kthread_sleep(uint64_t ns) {
+    uint32_t flags = irq_save();
+    struct thread* self = this_cpu_read(current);
+    self->state = THREAD_SLEEPING;
+    timer_add_after(&self->sleep_timer, ns);
+    schedule();
+    irq_restore(flags);
+}
+
+/**
+ * Sleep with no timeout, for wait primitives built on sched_wakeup()
+ */
+void kthread_block(void) {
+    struct thread* self = this_cpu_read(current);
+    self->state = THREAD_SLEEPING;
+    schedule();
+}
+
+/**
+ * Sleep until sched_wakeup() or the timeout, whichever comes first
+ * @param ns Longest to sleep for
+ */
+void kthread_block_timeout(uint64_t ns) {
+    struct thread* self = this_cpu_read(current);
+    self->state = THREAD_SLEEPING;
+    timer_add_after(&self->sleep_timer, ns);
+    schedule();
+}
+
+/**
+ * Sleep forever, leaving the CPU to the other threads and the idle loop
+ */
+void kthread_park(void) {
+    interrupts_disable();
+    for (;;) {
+        kthread_block();
+    }
+}
+
+/**
+ * End the calling thread
+ */
+void kthread_exit(void) {
+    interrupts_disable();
+    struct thread* self = this_cpu_read(current);
+    if (self == &main_thread || self == idle_thread) {
+        panic("kthread_exit: main and idle threads cannot exit");
+    }
+    self->state = THREAD_DEAD;
+    schedule();
+    __builtin_unreachable();
+}
+
+/**
+ * Change the base priority of a thread
+ * @param thread Thread to change
+ * @param priority New base priority, 0 the most urgent
+ */
+void kthread_set_priority(struct thread* thread, uint8_t priority) {
+    if (priority >= SCHED_PRIORITIES) {
+        priority = SCHED_PRIORITIES - 1;
+    }
+
+    uint32_t flags = irq_save();
+    thread->base_priority = priority;
+    if (thread->state == THREAD_RUNNABLE && thread != idle_thread) {
+        dequeue_thread(thread);
+        thread->priority = priority;
+        enqueue(thread);
+        preempt_check(thread, flags);
+    } else {
+        thread->priority = priority;
+        if (thread == this_cpu_read(current) && queued_at_or_above(priority) && (flags & EFLAGS_IF)) {
+            // Something queued is now more urgent than the caller
+            schedule();
+        }
+    }
+    irq_restore(flags);
+}
+
+struct thread* kthread_current(void) {
+    struct thread* thread = this_cpu_read(current);
+
+    // Before sched_init() the boot code is already the main thread
+    return thread ? thread : &main_thread;
+}
+
+/**
+ * Make a sleeping thread runnable, with a priority boost
+ * @param thread Thread to wake; threads that are not asleep are left alone
+ */
+void sched_wakeup(struct thread* thread) {
+    uint32_t flags = irq_save();
+
+    if (thread->state == THREAD_SLEEPING) {
+        timer_cancel(&thread->sleep_timer);
+
+        // Blocked before its slice ran out, so favour it a little more
+        uint8_t ceiling = thread->base_priority > SCHED_BOOST_MAX ?
+                          thread->base_priority - SCHED_BOOST_MAX : 0;
+        if (thread->priority > ceiling) {
+            thread->priority--;
+            kstat_inc(sched, boosts);
+        }
+
+        enqueue(thread);
+        preempt_check(thread, flags);
+    }
+
+    irq_restore(flags);
+}
+
+/**
+ * Switch threads on the way out of an interrupt if a wakeup or the end of
+ * a time slice asked for it. Interrupts are still disabled here.
+ */
+void sched_irq_exit(void) {
+    if (this_cpu_read(need_resched) && this_cpu_read(preempt_count) == 0) {
+        schedule();
+    }
+}
+
+/**
+ * Take a preemption that preempt_disable() held off. With interrupts
+ * disabled it waits for the next interrupt exit instead.
+ */
+void sched_preempt(void) {
+    uint32_t flags = irq_save();
+    if ((flags & EFLAGS_IF) && this_cpu_read(need_resched) && this_cpu_read(preempt_count) == 0) {
+        schedule();
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Set up the main and idle threads
+ */
+void sched_init(void) {
+    this_cpu_write(current, &main_thread);
+    timer_init(&slice_timer, slice_expired, NULL);
+
+    idle_thread = kthread_create("idle", idle_loop, NULL);
+    if (!idle_thread) {
+        panic("sched_init: cannot create the idle thread");
+    }
+
+    // The idle thread only runs when nothing else can
+    uint32_t flags = irq_save();
+    dequeue_thread(idle_thread);
+    idle_thread->state = THREAD_RUNNABLE;
+    idle_thread->base_priority = SCHED_PRIORITIES - 1;
+    idle_thread->priority = SCHED_PRIORITIES - 1;
+    main_thread.run_start = rdtsc();
+    irq_restore(flags);
+
+    debug_info("Scheduler ready: %u priorities, %u KB stacks, %u ms time slice",
+               SCHED_PRIORITIES, KTHREAD_STACK_SIZE / 1024, (unsigned)(SCHED_SLICE_NS / 1000000));
+}
+
+/**
+ * Print every thread with its priority and the CPU time it has used
+ */
+void sched_dump(void) {
+    static const char* const state_names[] = {
+        [THREAD_RUNNING] = "running",
+        [THREAD_RUNNABLE] = "runnable",
+        [THREAD_SLEEPING] = "sleeping",
+        [THREAD_DEAD] = "dead",
+    };
+
+    uint32_t flags = irq_save();
+
+    // Charge the running thread up to now so the shares add up
+    uint64_t now = rdtsc();
+    struct thread* self = this_cpu_read(current);
+    self->cpu_cycles += now - self->run_start;
+    self->run_start = now;
+
+    uint64_t total = 0;
+    for (struct thread* thread = all_threads; thread; thread = thread->all_next) {
+        total += thread->cpu_cycles;
+    }
+
+    // Scale both sides down until the total fits the 32-bit divisor
+    unsigned int shift = 0;
+    while ((total >> shift) > 0xFFFFFFFFULL) {
+        shift++;
+    }
+    uint32_t divisor = (uint32_t)(total >> shift);
+
+    debug_info("Threads (id, name, state, priority/base, switches, CPU cycles, share):");
+    for (struct thread* thread = all_threads; thread; thread = thread->all_next) {
+        uint32_t permille = divisor ?
+            (uint32_t)div_u64_u32((thread->cpu_cycles >> shift) * 1000, divisor) : 0;
+        debug_info("  %3u %-16s %-9s %2u/%-2u %8llu %14llu %3u.%u%%", thread->id, thread->name,
+                   state_names[thread->state], thread->priority, thread->base_priority,
+                   thread->switches, thread->cpu_cycles, permille / 10, permille % 10);
+    }
+    irq_restore(flags);
+}
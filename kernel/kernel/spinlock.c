@@ -0,0 +1,169 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <kernel/debug.h>
+#include <kernel/math64.h>
+#include <kernel/spinlock.h>
+
+/**
+ * Queue on an MCS lock and spin until it is handed to us
+ * @param lock Lock to take
+ * @param node Queue node, valid until the matching mcs_unlock()
+ */
+void mcs_lock(struct mcs_lock *lock, struct mcs_node *node) {
+    node->next = NULL;
+    node->locked = true;
+
+    struct mcs_node *prev = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+#ifdef KERNEL_LOCKSTAT
+    uint64_t wait_start = prev ? lockstat_now() : 0;
+#endif
+    if (prev) {
+        // Link in behind the previous waiter and spin on our own flag
+        __atomic_store_n(&prev->next, node, __ATOMIC_RELEASE);
+        while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE)) {
+            cpu_relax();
+        }
+    }
+#ifdef KERNEL_LOCKSTAT
+    lockstat_acquired(lock->class, prev != NULL, wait_start);
+    lock->acquired = lockstat_now();
+#endif
+}
+
+/**
+ * Take an MCS lock only if it is free
+ * @param lock Lock to take
+ * @param node Queue node, valid until the matching mcs_unlock()
+ * @return true if the lock was taken
+ */
+bool mcs_trylock(struct mcs_lock *lock, struct mcs_node *node) {
+    struct mcs_node *expected = NULL;
+
+    node->next = NULL;
+    node->locked = true;
+    if (!__atomic_compare_exchange_n(&lock->tail, &expected, node, false,
+                                     __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+        return false;
+    }
+#ifdef KERNEL_LOCKSTAT
+    lockstat_acquired(lock->class, false, 0);
+    lock->acquired = lockstat_now();
+#endif
+    return true;
+}
+
+/**
+ * Release an MCS lock, passing it to the next queued waiter if any
+ * @param lock Lock to release
+ * @param node Node it was taken with
+ */
+void mcs_unlock(struct mcs_lock *lock, struct mcs_node *node) {
+#ifdef KERNEL_LOCKSTAT
+    lockstat_release(lock->class, lock->acquired);
+#endif
+    struct mcs_node *next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+    if (!next) {
+        // Nobody behind us: empty the queue, unless a waiter just joined
+        struct mcs_node *expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, NULL, false,
+                                        __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+        // It swapped the tail but has not linked itself in yet
+        while (!(next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE))) {
+            cpu_relax();
+        }
+    }
+    __atomic_store_n(&next->locked, false, __ATOMIC_RELEASE);
+}
+
+#ifdef KERNEL_LOCKSTAT
+
+/* Bounds of the .lockstat section, from the linker script */
+extern struct lock_class __lockstat_start[];
+extern struct lock_class __lockstat_end[];
+
+/**
+ * Count an acquisition
+ * @param class Class of the lock just taken
+ * @param contended Whether the lock was held or queued on when we asked
+ * @param wait_start TSC when waiting began, if contended
+ */
+void lockstat_acquired(struct lock_class *class, bool contended, uint64_t wait_start) {
+    __atomic_fetch_add(&class->acquisitions, 1, __ATOMIC_RELAXED);
+    if (contended) {
+        __atomic_fetch_add(&class->contended, 1, __ATOMIC_RELAXED);
+        __atomic_fetch_add(&class->spin_cycles, lockstat_now() - wait_start, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Account the time a lock was held
+ * @param class Class of the lock about to be released
+ * @param acquired TSC when it was taken
+ */
+void lockstat_release(struct lock_class *class, uint64_t acquired) {
+    uint64_t held = lockstat_now() - acquired;
+    __atomic_fetch_add(&class->hold_cycles, held, __ATOMIC_RELAXED);
+
+    uint64_t max = __atomic_load_n(&class->max_hold_cycles, __ATOMIC_RELAXED);
+    while (held > max &&
+           !__atomic_compare_exchange_n(&class->max_hold_cycles, &max, held, true,
+                                        __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+    }
+}
+
+/**
+ * @return Number of lock classes
+ */
+uint32_t lockstat_count(void) {
+    return (uint32_t)(__lockstat_end - __lockstat_start);
+}
+
+/**
+ * Get a lock class by position
+ * @param index Position in link order
+ * @return The class, or NULL if index is out of range
+ */
+const struct lock_class *lockstat_at(uint32_t index) {
+    return index < lockstat_count() ? &__lockstat_start[index] : NULL;
+}
+
+/**
+ * Zero every lock class
+ */
+void lockstat_reset(void) {
+    for (struct lock_class *class = __lockstat_start; class < __lockstat_end; class++) {
+        __atomic_store_n(&class->acquisitions, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&class->contended, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&class->spin_cycles, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&class->hold_cycles, 0, __ATOMIC_RELAXED);
+        __atomic_store_n(&class->max_hold_cycles, 0, __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * Print every lock class. The counts are read without stopping other
+ * CPUs, so a class in use may be a few acquisitions out of step.
+ */
+void lockstat_dump(void) {
+    debug_info("Lock classes (acquired, contended, avg spin, avg hold, max hold; cycles):");
+    for (struct lock_class *class = __lockstat_start; class < __lockstat_end; class++) {
+        uint64_t acquisitions = __atomic_load_n(&class->acquisitions, __ATOMIC_RELAXED);
+        uint64_t contended = __atomic_load_n(&class->contended, __ATOMIC_RELAXED);
+        uint64_t spin = __atomic_load_n(&class->spin_cycles, __ATOMIC_RELAXED);
+        uint64_t hold = __atomic_load_n(&class->hold_cycles, __ATOMIC_RELAXED);
+        uint64_t max_hold = __atomic_load_n(&class->max_hold_cycles, __ATOMIC_RELAXED);
+        if (acquisitions == 0) {
+            debug_info("  %-24s unused", class->name);
+            continue;
+        }
+
+        debug_info("  %-24s %10llu %10llu %8llu %8llu %10llu", class->name, acquisitions,
+                   contended, div_u64_u64_approx(spin, contended),
+                   div_u64_u64_approx(hold, acquisitions), max_hold);
+    }
+}
+
+#endif /* KERNEL_LOCKSTAT */
@@ -0,0 +1,301 @@
+#include <stddef.h>
+#include <stdint.h>
+#include "interrupts.h"
+#include <kernel/clockevent.h>
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/math64.h>
+#include <kernel/timer.h>
+
+/*
+ * Hierarchical timing wheel. Level L has 64 slots, each covering 64^L wheel
+ * ticks. A timer goes on the lowest level where its expiry is less than 64
+ * slots of that level ahead of wheel_clk, so inserting and cancelling are a
+ * list push and unlink plus one bit in the level's occupancy bitmap. When
+ * wheel_clk reaches the start of a higher-level slot, its timers cascade
+ * down a level. Expiries beyond the top level are parked in its last slot
+ * and re-queued when they cascade.
+ *
+ * The bitmaps give the next tick at which anything happens without
+ * walking the slots, and only that tick is programmed into the hardware.
+ * With no timers pending the hardware is left idle.
+ */
+#define WHEEL_BITS   6
+#define WHEEL_SIZE   (1 << WHEEL_BITS)
+#define WHEEL_MASK   (WHEEL_SIZE - 1)
+#define WHEEL_LEVELS 4
+
+#define LEVEL_SHIFT(level) ((level) * WHEEL_BITS)
+
+#define NO_TICK UINT64_MAX
+
+static struct timer *wheel[WHEEL_LEVELS][WHEEL_SIZE];
+static uint64_t wheel_occupied[WHEEL_LEVELS];
+static uint64_t wheel_clk;          /* Next tick to be processed */
+
+static struct clock_event_device *event_device;
+static uint64_t programmed_tick = NO_TICK;
+static bool in_timer_interrupt;
+
+static struct timer_stats stats;
+
+static inline uint64_t ktime_to_tick(uint64_t ns) {
+    return div_u64_u32(ns, TIMER_TICK_NS);
+}
+
+/* Place a timer in the wheel relative to wheel_clk */
+static void enqueue_timer(struct timer *timer) {
+    uint64_t expires = timer->expires < wheel_clk ? wheel_clk : timer->expires;
+    unsigned int level;
+
+    for (level = 0; level < WHEEL_LEVELS; level++) {
+        unsigned int shift = LEVEL_SHIFT(level);
+        if ((expires >> shift) - (wheel_clk >> shift) < WHEEL_SIZE) {
+            break;
+        }
+    }
+    if (level == WHEEL_LEVELS) {
+        level = WHEEL_LEVELS - 1;
+        expires = ((wheel_clk >> LEVEL_SHIFT(level)) + WHEEL_MASK) << LEVEL_SHIFT(level);
+    }
+
+    unsigned int slot = (expires >> LEVEL_SHIFT(level)) & WHEEL_MASK;
+    struct timer **head = &wheel[level][slot];
+
+    timer->next = *head;
+    if (timer->next) {
+        timer->next->pprev = &timer->next;
+    }
+    timer->pprev = head;
+    *head = timer;
+    wheel_occupied[level] |= 1ULL << slot;
+}
+
+/* Unlink a timer from whatever list it is on */
+static void dequeue_timer(struct timer *timer) {
+    struct timer **link = timer->pprev;
+
+    *link = timer->next;
+    if (timer->next) {
+        timer->next->pprev = link;
+    } else if (link >= &wheel[0][0] && link < &wheel[0][0] + WHEEL_LEVELS * WHEEL_SIZE) {
+        // Was the only timer in a wheel slot
+        size_t index = link - &wheel[0][0];
+        wheel_occupied[index / WHEEL_SIZE] &= ~(1ULL << (index % WHEEL_SIZE));
+    }
+
+    timer->next = NULL;
+    timer->pprev = NULL;
+}
+
+/* Move a slot's timers onto a private list headed at *list */
+static void detach_slot(unsigned int level, unsigned int slot, struct timer **list) {
+    *list = wheel[level][slot];
+    if (*list) {
+        (*list)->pprev = list;
+    }
+    wheel[level][slot] = NULL;
+    wheel_occupied[level] &= ~(1ULL << slot);
+}
+
+/* Earliest tick at which the wheel has work, or NO_TICK if it is empty */
+static uint64_t next_event_tick(void) {
+    uint64_t best = NO_TICK;
+
+    for (unsigned int level = 0; level < WHEEL_LEVELS; level++) {
+        uint64_t occupied = wheel_occupied[level];
+        if (!occupied) {
+            continue;
+        }
+
+        // First slot of this level that starts at or after wheel_clk
+        unsigned int shift = LEVEL_SHIFT(level);
+        uint64_t base = (wheel_clk + (1ULL << shift) - 1) >> shift;
+        unsigned int start = base & WHEEL_MASK;
+        uint64_t rotated = start ? (occupied >> start) | (occupied << (WHEEL_SIZE - start)) : occupied;
+        uint64_t tick = (base + ctz_u64(rotated)) << shift;
+
+        if (tick < best) {
+            best = tick;
+        }
+    }
+    return best;
+}
+
+/* Cascade and expire everything due at tick wheel_clk */
+static void process_tick(uint64_t now_ns) {
+    uint64_t tick = wheel_clk;
+    struct timer *list;
+    struct timer *timer;
+
+    for (unsigned int level = WHEEL_LEVELS - 1; level > 0; level--) {
+        unsigned int shift = LEVEL_SHIFT(level);
+        if (tick & ((1ULL << shift) - 1)) {
+            continue;
+        }
+        detach_slot(level, (tick >> shift) & WHEEL_MASK, &list);
+        while ((timer = list)) {
+            dequeue_timer(timer);
+            enqueue_timer(timer);
+        }
+    }
+
+    detach_slot(0, tick & WHEEL_MASK, &list);
+    wheel_clk = tick + 1;
+
+    while ((timer = list)) {
+        dequeue_timer(timer);
+        if (timer->expires > tick) {
+            // Parked in the top level's last slot, not due yet
+            enqueue_timer(timer);
+            continue;
+        }
+
+        uint64_t late = now_ns > timer->expires_ns ? now_ns - timer->expires_ns : 0;
+        stats.expired++;
+        stats.late_total_ns += late;
+        if (late > stats.late_max_ns) {
+            stats.late_max_ns = late;
+        }
+
+        timer->function(timer->data);
+    }
+}
+
+/* Run every timer that is due, skipping over empty stretches of the wheel */
+static void run_expired_timers(void) {
+    uint64_t now_ns = ktime_get_ns();
+    uint64_t now = ktime_to_tick(now_ns);
+
+    while (wheel_clk <= now) {
+        uint64_t next = next_event_tick();
+        if (next > now) {
+            wheel_clk = now + 1;
+            break;
+        }
+        wheel_clk = next;
+        process_tick(now_ns);
+    }
+}
+
+/* Arm the hardware for the next tick with work, if there is one */
+static void program_next_event(void) {
+    uint64_t next = next_event_tick();
+    if (!event_device || next == NO_TICK || next == programmed_tick) {
+        return;
+    }
+
+    uint64_t now_ns = ktime_get_ns();
+    uint64_t when_ns = next * TIMER_TICK_NS;
+    uint64_t delta_ns = when_ns > now_ns ? when_ns - now_ns : 0;
+
+    // Round up so the interrupt never arrives before the tick has started
+    uint64_t ticks = mul_u64_u32_shr(delta_ns, event_device->mult, event_device->shift) + 1;
+    if (ticks < event_device->min_delta_ticks) {
+        ticks = event_device->min_delta_ticks;
+    } else if (ticks > event_device->max_delta_ticks) {
+        ticks = event_device->max_delta_ticks;
+    }
+
+    event_device->set_next_event((uint32_t)ticks);
+    programmed_tick = next;
+    stats.reprograms++;
+}
+
+void clockevent_register(struct clock_event_device *dev) {
+    uint32_t shift = 32;
+    uint64_t mult;
+
+    for (;;) {
+        mult = div_u64_u32((uint64_t)dev->freq_hz << shift, NSEC_PER_SEC);
+        if (mult <= UINT32_MAX || shift == 0) {
+            break;
+        }
+        shift--;
+    }
+    dev->mult = (uint32_t)mult;
+    dev->shift = shift;
+
+    uint32_t flags = irq_save();
+    event_device = dev;
+    programmed_tick = NO_TICK;
+    program_next_event();
+    irq_restore(flags);
+
+    debug_info("Clock event device %s: %u Hz, %u-%u ticks per event", dev->name,
+               dev->freq_hz, dev->min_delta_ticks, dev->max_delta_ticks);
+}
+
+void clockevent_interrupt(void) {
+    stats.wakeups++;
+
+    // One-shot hardware: nothing is armed until we program it again
+    programmed_tick = NO_TICK;
+    in_timer_interrupt = true;
+    run_expired_timers();
+    in_timer_interrupt = false;
+    program_next_event();
+}
+
+void timer_init(struct timer *timer, timer_fn_t function, void *data) {
+    timer->next = NULL;
+    timer->pprev = NULL;
+    timer->expires_ns = 0;
+    timer->expires = 0;
+    timer->function = function;
+    timer->data = data;
+}
+
+void timer_add(struct timer *timer, uint64_t expires_ns) {
+    uint32_t flags = irq_save();
+
+    if (timer_pending(timer)) {
+        dequeue_timer(timer);
+    }
+
+    // After a long idle stretch wheel_clk lags behind; catch it up when
+    // nothing is due in between so the new timer lands on a low level
+    uint64_t now = ktime_to_tick(ktime_get_ns());
+    if (wheel_clk < now && next_event_tick() >= now) {
+        wheel_clk = now;
+    }
+
+    timer->expires_ns = expires_ns;
+    timer->expires = ktime_to_tick(expires_ns + TIMER_TICK_NS - 1);
+    enqueue_timer(timer);
+
+    if (!in_timer_interrupt && timer->expires < programmed_tick) {
+        program_next_event();
+    }
+
+    irq_restore(flags);
+}
+
+void timer_add_after(struct timer *timer, uint64_t delay_ns) {
+    timer_add(timer, ktime_get_ns() + delay_ns);
+}
+
+bool timer_cancel(struct timer *timer) {
+    uint32_t flags = irq_save();
+    bool pending = timer_pending(timer);
+
+    // The hardware stays armed; an interrupt with nothing due is harmless
+    if (pending) {
+        dequeue_timer(timer);
+    }
+
+    irq_restore(flags);
+    return pending;
+}
+
+void timer_get_stats(struct timer_stats *out) {
+    uint32_t flags = irq_save();
+    *out = stats;
+    irq_restore(flags);
+}
+
+void timer_reset_stats(void) {
+    uint32_t flags = irq_save();
+    stats = (struct timer_stats){ .since_ns = ktime_get_ns() };
+    irq_restore(flags);
+}
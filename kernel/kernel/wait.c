@@ -0,0 +1,104 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "interrupts.h"
+#include <kernel/kstat.h>
+#include <kernel/sched.h>
+#include <kernel/wait.h>
+
+/* A sleeping thread, linked from its own stack */
+struct wait_queue_entry {
+    struct thread* thread;
+    struct wait_queue_entry* next;
+    bool woken;
+};
+
+KSTAT_DEFINE(wait, sleeps);
+KSTAT_DEFINE(wait, timeouts);
+
+void wait_queue_init(struct wait_queue *queue) {
+    queue->head = NULL;
+}
+
+static void enqueue(struct wait_queue *queue, struct wait_queue_entry *entry) {
+    struct wait_queue_entry **link = &queue->head;
+    while (*link) {
+        link = &(*link)->next;
+    }
+    *link = entry;
+}
+
+/* Unlink an entry that timed out before anyone woke it */
+static void dequeue(struct wait_queue *queue, struct wait_queue_entry *entry) {
+    for (struct wait_queue_entry **link = &queue->head; *link; link = &(*link)->next) {
+        if (*link == entry) {
+            *link = entry->next;
+            return;
+        }
+    }
+}
+
+/**
+ * Sleep until wake_up() picks us; interrupts are disabled throughout
+ * @param queue Queue to sleep on
+ */
+void wait_queue_sleep(struct wait_queue *queue) {
+    struct wait_queue_entry entry = { kthread_current(), NULL, false };
+    enqueue(queue, &entry);
+    kstat_inc(wait, sleeps);
+
+    // The waker unlinks us before waking us; anything else is spurious
+    while (!entry.woken) {
+        kthread_block();
+    }
+}
+
+/**
+ * Sleep until woken or until the timeout; interrupts are disabled throughout
+ * @param queue Queue to sleep on
+ * @param ns Longest to sleep for
+ * @return true if woken, false if the timeout came first
+ */
+bool wait_queue_sleep_timeout(struct wait_queue *queue, uint64_t ns) {
+    struct wait_queue_entry entry = { kthread_current(), NULL, false };
+    enqueue(queue, &entry);
+    kstat_inc(wait, sleeps);
+
+    kthread_block_timeout(ns);
+    if (!entry.woken) {
+        dequeue(queue, &entry);
+        kstat_inc(wait, timeouts);
+        return false;
+    }
+    return true;
+}
+
+/**
+ * Wake the oldest waiter
+ * @param queue Queue to wake from
+ */
+void wake_up(struct wait_queue *queue) {
+    uint32_t flags = irq_save();
+    struct wait_queue_entry *entry = queue->head;
+    if (entry) {
+        queue->head = entry->next;
+        entry->woken = true;
+        sched_wakeup(entry->thread);
+    }
+    irq_restore(flags);
+}
+
+/**
+ * Wake every waiter
+ * @param queue Queue to wake from
+ */
+void wake_up_all(struct wait_queue *queue) {
+    uint32_t flags = irq_save();
+    while (queue->head) {
+        struct wait_queue_entry *entry = queue->head;
+        queue->head = entry->next;
+        entry->woken = true;
+        sched_wakeup(entry->thread);
+    }
+    irq_restore(flags);
+}
@@ -0,0 +1,300 @@
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "../arch/i386/cpu.h"
+#include "interrupts.h"
+#include <kernel/clocksource.h>
+#include <kernel/debug.h>
+#include <kernel/kstat.h>
+#include <kernel/math64.h>
+#include <kernel/sched.h>
+#include <kernel/spinlock.h>
+#include <kernel/workqueue.h>
+
+struct work_item {
+    work_fn_t fn;
+    void* arg;
+    uint64_t queued;            /* TSC when queued, for the latency figures */
+};
+
+/*
+ * Chase-Lev deque over a fixed ring. top and bottom only grow; items
+ * top..bottom-1 are present. The owner works at the bottom, thieves take
+ * from the top, and the two only race for the last item, which they settle
+ * with a compare-and-swap on top.
+ */
+struct work_deque {
+    uint32_t top;
+    uint32_t bottom;
+    struct work_item items[WORK_DEQUE_SIZE];
+};
+
+struct worker {
+    struct work_deque deque;
+    struct thread* thread;
+    bool idle;                  /* Blocked waiting for work */
+    uint32_t index;
+    uint64_t executed;
+    uint64_t stolen;            /* Items taken from other workers */
+    uint64_t latency_cycles;    /* Queue to start, all items run */
+    uint64_t max_latency_cycles;
+};
+
+static struct worker workers[WORKQUEUE_WORKERS];
+static uint32_t worker_count;
+
+/* Work queued from outside the pool, oldest at inject_head */
+static struct work_item inject_items[WORK_INJECT_SIZE];
+static uint32_t inject_head;
+static uint32_t inject_tail;
+DEFINE_SPINLOCK(inject_lock);
+
+KSTAT_DEFINE(workqueue, queued);
+KSTAT_DEFINE(workqueue, injected);
+KSTAT_DEFINE(workqueue, steals);
+KSTAT_DEFINE(workqueue, steal_races);
+KSTAT_DEFINE(workqueue, full);
+
+/**
+ * Push on the bottom of the caller's own deque
+ * @return false if the deque is full
+ */
+static bool deque_push(struct work_deque *deque, const struct work_item *item) {
+    uint32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    uint32_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    if (bottom - top >= WORK_DEQUE_SIZE) {
+        return false;
+    }
+    deque->items[bottom % WORK_DEQUE_SIZE] = *item;
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELEASE);
+    return true;
+}
+
+/**
+ * Pop the newest item of the caller's own deque
+ * @return false if it was empty or a thief took the last item
+ */
+static bool deque_pop(struct work_deque *deque, struct work_item *item) {
+    uint32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+    // Thieves must see the smaller bottom before we read top
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if ((int32_t)(bottom - top) < 0) {
+        __atomic_store_n(&deque->bottom, top, __ATOMIC_RELAXED);
+        return false;
+    }
+
+    *item = deque->items[bottom % WORK_DEQUE_SIZE];
+    if (bottom != top) {
+        return true;
+    }
+
+    // The last item: whoever moves top first gets it
+    bool won = __atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+                                           __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return won;
+}
+
+/**
+ * Take the oldest item of another worker's deque
+ * @return false if it was empty or another thread got there first
+ */
+static bool deque_steal(struct work_deque *deque, struct work_item *item) {
+    uint32_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    uint32_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+    if ((int32_t)(bottom - top) <= 0) {
+        return false;
+    }
+
+    // The owner cannot reuse this slot while top still points at it
+    *item = deque->items[top % WORK_DEQUE_SIZE];
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        kstat_inc(workqueue, steal_races);
+        return false;
+    }
+    return true;
+}
+
+static inline bool deque_empty(const struct work_deque *deque) {
+    return (int32_t)(__atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE) -
+                     __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE)) <= 0;
+}
+
+/**
+ * Take the oldest item of the shared queue
+ * @return false if it was empty
+ */
+static bool inject_take(struct work_item *item) {
+    uint32_t flags = spin_lock_irqsave(&inject_lock);
+    bool found = inject_head != inject_tail;
+    if (found) {
+        *item = inject_items[inject_head++ % WORK_INJECT_SIZE];
+    }
+    spin_unlock_irqrestore(&inject_lock, flags);
+    return found;
+}
+
+/**
+ * Try every other worker's deque, starting after our own
+ * @return true if something was stolen
+ */
+static bool steal_any(struct worker *self, struct work_item *item) {
+    for (uint32_t i = 1; i < worker_count; i++) {
+        struct worker *victim = &workers[(self->index + i) % worker_count];
+        if (deque_steal(&victim->deque, item)) {
+            self->stolen++;
+            kstat_inc(workqueue, steals);
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Whether a sleeping worker would find something; interrupts are off */
+static bool work_pending(void) {
+    if (inject_head != inject_tail) {
+        return true;
+    }
+    for (uint32_t i = 0; i < worker_count; i++) {
+        if (!deque_empty(&workers[i].deque)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+/* Wake one sleeping worker, if any; interrupts are off */
+static void wake_idle_worker(void) {
+    for (uint32_t i = 0; i < worker_count; i++) {
+        if (workers[i].idle) {
+            workers[i].idle = false;
+            sched_wakeup(workers[i].thread);
+            return;
+        }
+    }
+}
+
+static void run_item(struct worker *self, const struct work_item *item) {
+    uint64_t latency = rdtsc() - item->queued;
+    self->latency_cycles += latency;
+    if (latency > self->max_latency_cycles) {
+        self->max_latency_cycles = latency;
+    }
+    self->executed++;
+    item->fn(item->arg);
+}
+
+static void worker_loop(void *arg) {
+    struct worker *self = arg;
+    struct work_item item;
+
+    for (;;) {
+        if (deque_pop(&self->deque, &item) || inject_take(&item) || steal_any(self, &item)) {
+            run_item(self, &item);
+            continue;
+        }
+
+        // Nothing anywhere. queue_work() runs with interrupts off, so it
+        // cannot slip in between the check and the sleep.
+        uint32_t flags = irq_save();
+        if (!work_pending()) {
+            self->idle = true;
+            while (self->idle) {
+                kthread_block();
+            }
+        }
+        irq_restore(flags);
+    }
+}
+
+/**
+ * Queue fn(arg) for a worker thread
+ * @param fn Work function
+ * @param arg Passed to fn
+ * @return false if the queue was full
+ */
+bool queue_work(work_fn_t fn, void *arg) {
+    struct work_item item = { fn, arg, rdtsc() };
+    bool queued = false;
+
+    uint32_t flags = irq_save();
+    // Only a worker in thread context may touch its own deque; an
+    // interrupt handler could have caught it halfway through a pop
+    struct thread *self = kthread_current();
+    if (flags & EFLAGS_IF) {
+        for (uint32_t i = 0; i < worker_count; i++) {
+            if (workers[i].thread == self) {
+                queued = deque_push(&workers[i].deque, &item);
+                break;
+            }
+        }
+    }
+    if (!queued) {
+        spin_lock(&inject_lock);
+        if (inject_tail - inject_head < WORK_INJECT_SIZE) {
+            inject_items[inject_tail++ % WORK_INJECT_SIZE] = item;
+            queued = true;
+            kstat_inc(workqueue, injected);
+        }
+        spin_unlock(&inject_lock);
+    }
+
+    if (queued) {
+        kstat_inc(workqueue, queued);
+        wake_idle_worker();
+    } else {
+        kstat_inc(workqueue, full);
+    }
+    irq_restore(flags);
+    return queued;
+}
+
+/**
+ * Start the worker pool
+ */
+void workqueue_init(void) {
+    for (uint32_t i = 0; i < WORKQUEUE_WORKERS; i++) {
+        static const char digits[] = "0123456789abcdef";
+        char name[] = "worker-0";
+        name[7] = digits[i % 16];
+
+        struct worker *worker = &workers[i];
+        worker->index = i;
+        // Counted only once thread is set, for wake_idle_worker()
+        uint32_t flags = irq_save();
+        worker->thread = kthread_create(name, worker_loop, worker);
+        if (!worker->thread) {
+            irq_restore(flags);
+            break;
+        }
+        worker_count++;
+        irq_restore(flags);
+    }
+    debug_info("Work queue: %u workers, %u-item deques", worker_count, WORK_DEQUE_SIZE);
+}
+
+/**
+ * Print what each worker has run and stolen and how long items waited
+ * between queue_work() and starting to run
+ */
+void workqueue_dump(void) {
+    const struct clocksource *tsc = clocksource_get("tsc");
+
+    debug_info("Workers (executed, stolen, avg wait, max wait; %s):", tsc ? "ns" : "cycles");
+    for (uint32_t i = 0; i < worker_count; i++) {
+        const struct worker *worker = &workers[i];
+        uint64_t wait = div_u64_u64_approx(worker->latency_cycles, worker->executed);
+        uint64_t max_wait = worker->max_latency_cycles;
+        if (tsc) {
+            wait = clocksource_cycles_to_ns(tsc, wait);
+            max_wait = clocksource_cycles_to_ns(tsc, max_wait);
+        }
+        debug_info("  %-10s %10llu %8llu %10llu %10llu", worker->thread->name, worker->executed,
+                   worker->stolen, wait, max_wait);
+    }
+}
@@ -2,7 +2,9 @@
 #define _STDIO_H 1
 
 #include <sys/cdefs.h>
+#include <stdarg.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #define EOF (-1)
 
@@ -11,6 +13,9 @@ extern "C" {
 #endif
 
 int printf(const char* __restrict, ...);
+int vprintf(const char* __restrict, va_list);
+int snprintf(char*, size_t, const char*, ...);
+int vsnprintf(char*, size_t, const char*, va_list);
 int putchar(int);
 int puts(const char*);
 
@@ -0,0 +1,431 @@
+#include <limits.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "format.h"
+
+/* Flags parsed from a conversion specification */
+#define FLAG_LEFT  0x01 /* '-': left-justify within the field */
+#define FLAG_PLUS  0x02 /* '+': always print a sign */
+#define FLAG_SPACE 0x04 /* ' ': space in place of a '+' sign */
+#define FLAG_ALT   0x08 /* '#': alternate form (0x prefix, leading 0) */
+#define FLAG_ZERO  0x10 /* '0': pad with zeros instead of spaces */
+
+/* Length modifiers */
+enum format_length {
+    LENGTH_NONE,
+    LENGTH_HH,
+    LENGTH_H,
+    LENGTH_L,
+    LENGTH_LL,
+    LENGTH_J,
+    LENGTH_Z,
+    LENGTH_T,
+};
+
+/* Large enough for a 64-bit value in octal (22 digits) */
+#define NUMBER_BUFFER_SIZE 24
+
+/* Two ASCII digits for every value 0..99, so decimal conversion emits pairs */
+static const char digit_pairs[200] =
+    "00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+    "40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char hex_lower[16] = "0123456789abcdef";
+static const char hex_upper[16] = "0123456789ABCDEF";
+
+static const char pad_spaces[16] = "                ";
+static const char pad_zeros[16] = "0000000000000000";
+
+static inline void copy_pair(char* dst, uint32_t pair) {
+    dst[0] = digit_pairs[pair * 2];
+    dst[1] = digit_pairs[pair * 2 + 1];
+}
+
+/*
+ * Divide a 64-bit value in place by a 32-bit divisor and return the
+ * remainder. On i386 this is two divl instructions instead of a call into
+ * libgcc's __udivmoddi4.
+ */
+static inline uint32_t div64_u32(uint64_t* value, uint32_t divisor) {
+#if defined(__i386__)
+    uint32_t high = (uint32_t)(*value >> 32);
+    uint32_t low = (uint32_t)*value;
+    uint32_t quotient_high = high / divisor;
+    uint32_t quotient_low, remainder;
+
+    high %= divisor;
+    __asm__ ("divl %4"
+             : "=a"(quotient_low), "=d"(remainder)
+             : "a"(low), "d"(high), "rm"(divisor));
+    *value = ((uint64_t)quotient_high << 32) | quotient_low;
+    return remainder;
+#else
+    uint32_t remainder = (uint32_t)(*value % divisor);
+    *value /= divisor;
+    return remainder;
+#endif
+}
+
+/*
+ * Convert to decimal, filling backwards from end. 64-bit values are split
+ * into 8-digit chunks so the bulk of the work is 32-bit arithmetic, where
+ * the compiler turns the divisions by 100 into multiplications.
+ */
+static char* format_decimal(char* end, uint64_t value) {
+    char* p = end;
+
+    while (value > UINT32_MAX) {
+        uint32_t chunk = div64_u32(&value, 100000000u);
+        for (int i = 0; i < 4; i++) {
+            p -= 2;
+            copy_pair(p, chunk % 100);
+            chunk /= 100;
+        }
+    }
+
+    uint32_t v = (uint32_t)value;
+    while (v >= 100) {
+        p -= 2;
+        copy_pair(p, v % 100);
+        v /= 100;
+    }
+
+    if (v >= 10) {
+        p -= 2;
+        copy_pair(p, v);
+    } else {
+        *--p = (char)('0' + v);
+    }
+    return p;
+}
+
+/* Convert to hexadecimal with shifts and masks, filling backwards from end */
+static char* format_hex(char* end, uint64_t value, const char* digits) {
+    char* p = end;
+    uint32_t low = (uint32_t)value;
+    uint32_t high = (uint32_t)(value >> 32);
+
+    if (high) {
+        for (int i = 0; i < 8; i++) {
+            *--p = digits[low & 0xF];
+            low >>= 4;
+        }
+        low = high;
+    }
+
+    do {
+        *--p = digits[low & 0xF];
+        low >>= 4;
+    } while (low);
+    return p;
+}
+
+/* Convert to octal, filling backwards from end */
+static char* format_octal(char* end, uint64_t value) {
+    char* p = end;
+    do {
+        *--p = (char)('0' + (value & 7));
+        value >>= 3;
+    } while (value);
+    return p;
+}
+
+/* Emit count copies of a padding character from a 16-byte pattern */
+static void emit_padding(format_emit_t emit, void* ctx, const char* pattern, size_t count) {
+    while (count > 0) {
+        size_t chunk = count < 16 ? count : 16;
+        emit(ctx, pattern, chunk);
+        count -= chunk;
+    }
+}
+
+/*
+ * Emit a field of the given length, honouring width and the '-' flag.
+ * prefix/zeros are only used by numeric conversions.
+ */
+static size_t emit_field(format_emit_t emit, void* ctx, int flags, size_t width,
+                         const char* prefix, size_t prefix_len, size_t zeros,
+                         const char* body, size_t body_len) {
+    size_t length = prefix_len + zeros + body_len;
+    size_t fill = width > length ? width - length : 0;
+
+    if (fill && !(flags & FLAG_LEFT)) {
+        if (flags & FLAG_ZERO) {
+            zeros += fill;
+        } else {
+            emit_padding(emit, ctx, pad_spaces, fill);
+        }
+    }
+    if (prefix_len) {
+        emit(ctx, prefix, prefix_len);
+    }
+    emit_padding(emit, ctx, pad_zeros, zeros);
+    if (body_len) {
+        emit(ctx, body, body_len);
+    }
+    if (fill && (flags & FLAG_LEFT)) {
+        emit_padding(emit, ctx, pad_spaces, fill);
+    }
+
+    return length + fill;
+}
+
+int vformat(format_emit_t emit, void* ctx, const char* format, va_list args) {
+    size_t written = 0;
+
+    while (*format != '\0') {
+        if (*format != '%') {
+            /* Emit the literal run up to the next conversion in one call */
+            size_t amount = 1;
+            while (format[amount] && format[amount] != '%') {
+                amount++;
+            }
+            emit(ctx, format, amount);
+            written += amount;
+            format += amount;
+            continue;
+        }
+
+        const char* spec_begun_at = format++;
+
+        if (*format == '%') {
+            emit(ctx, format, 1);
+            written++;
+            format++;
+            continue;
+        }
+
+        /* Flags */
+        int flags = 0;
+        for (;; format++) {
+            if (*format == '-') {
+                flags |= FLAG_LEFT;
+            } else if (*format == '+') {
+                flags |= FLAG_PLUS;
+            } else if (*format == ' ') {
+                flags |= FLAG_SPACE;
+            } else if (*format == '#') {
+                flags |= FLAG_ALT;
+            } else if (*format == '0') {
+                flags |= FLAG_ZERO;
+            } else {
+                break;
+            }
+        }
+
+        /* Field width */
+        size_t width = 0;
+        if (*format == '*') {
+            int arg = va_arg(args, int);
+            if (arg < 0) {
+                flags |= FLAG_LEFT;
+                width = (size_t)0 - (size_t)arg;
+            } else {
+                width = (size_t)arg;
+            }
+            format++;
+        } else {
+            while (*format >= '0' && *format <= '9') {
+                width = width * 10 + (size_t)(*format++ - '0');
+            }
+        }
+
+        /* Precision (-1 when not given) */
+        int precision = -1;
+        if (*format == '.') {
+            format++;
+            if (*format == '*') {
+                int arg = va_arg(args, int);
+                precision = arg < 0 ? -1 : arg;
+                format++;
+            } else {
+                precision = 0;
+                while (*format >= '0' && *format <= '9') {
+                    precision = precision * 10 + (*format++ - '0');
+                }
+            }
+        }
+
+        /* Length modifier */
+        enum format_length length = LENGTH_NONE;
+        switch (*format) {
+            case 'h':
+                format++;
+                length = LENGTH_H;
+                if (*format == 'h') {
+                    format++;
+                    length = LENGTH_HH;
+                }
+                break;
+            case 'l':
+                format++;
+                length = LENGTH_L;
+                if (*format == 'l') {
+                    format++;
+                    length = LENGTH_LL;
+                }
+                break;
+            case 'j':
+                format++;
+                length = LENGTH_J;
+                break;
+            case 'z':
+                format++;
+                length = LENGTH_Z;
+                break;
+            case 't':
+                format++;
+                length = LENGTH_T;
+                break;
+        }
+
+        if (flags & FLAG_LEFT) {
+            flags &= ~FLAG_ZERO;
+        }
+
+        char conversion = *format;
+        if (conversion == '\0') {
+            /* Truncated specification - emit it verbatim */
+            size_t amount = (size_t)(format - spec_begun_at);
+            emit(ctx, spec_begun_at, amount);
+            written += amount;
+            break;
+        }
+        format++;
+
+        if (conversion == 'c') {
+            char c = (char)va_arg(args, int);
+            written += emit_field(emit, ctx, flags & ~FLAG_ZERO, width, NULL, 0, 0, &c, 1);
+            continue;
+        }
+
+        if (conversion == 's') {
+            const char* str = va_arg(args, const char*);
+            if (str == NULL) {
+                str = "(null)";
+            }
+            size_t len = 0;
+            while (str[len] && (precision < 0 || len < (size_t)precision)) {
+                len++;
+            }
+            written += emit_field(emit, ctx, flags & ~FLAG_ZERO, width, NULL, 0, 0, str, len);
+            continue;
+        }
+
+        /* Numeric conversions */
+        uint64_t value;
+        char sign = 0;
+        const char* digits = hex_lower;
+
+        switch (conversion) {
+            case 'd':
+            case 'i': {
+                int64_t svalue;
+                switch (length) {
+                    case LENGTH_HH: svalue = (signed char)va_arg(args, int); break;
+                    case LENGTH_H:  svalue = (short)va_arg(args, int); break;
+                    case LENGTH_L:  svalue = va_arg(args, long); break;
+                    case LENGTH_LL: svalue = va_arg(args, long long); break;
+                    case LENGTH_J:  svalue = va_arg(args, intmax_t); break;
+                    case LENGTH_Z:
+                    case LENGTH_T:  svalue = va_arg(args, ptrdiff_t); break;
+                    default:        svalue = va_arg(args, int); break;
+                }
+                if (svalue < 0) {
+                    sign = '-';
+                    value = (uint64_t)0 - (uint64_t)svalue;
+                } else {
+                    sign = (flags & FLAG_PLUS) ? '+' : (flags & FLAG_SPACE) ? ' ' : 0;
+                    value = (uint64_t)svalue;
+                }
+                break;
+            }
+
+            case 'u':
+            case 'o':
+            case 'x':
+            case 'X':
+                switch (length) {
+                    case LENGTH_HH: value = (unsigned char)va_arg(args, unsigned int); break;
+                    case LENGTH_H:  value = (unsigned short)va_arg(args, unsigned int); break;
+                    case LENGTH_L:  value = va_arg(args, unsigned long); break;
+                    case LENGTH_LL: value = va_arg(args, unsigned long long); break;
+                    case LENGTH_J:  value = va_arg(args, uintmax_t); break;
+                    case LENGTH_Z:  value = va_arg(args, size_t); break;
+                    case LENGTH_T:  value = (size_t)va_arg(args, ptrdiff_t); break;
+                    default:        value = va_arg(args, unsigned int); break;
+                }
+                if (conversion == 'X') {
+                    digits = hex_upper;
+                }
+                break;
+
+            case 'p': {
+                void* ptr = va_arg(args, void*);
+                if (ptr == NULL) {
+                    written += emit_field(emit, ctx, flags & ~FLAG_ZERO, width, NULL, 0, 0, "(nil)", 5);
+                    continue;
+                }
+                value = (uintptr_t)ptr;
+                flags |= FLAG_ALT;
+                if (precision < 0) {
+                    precision = (int)(sizeof(void*) * 2);
+                }
+                conversion = 'x';
+                break;
+            }
+
+            default: {
+                /* Unsupported conversion - emit the specification verbatim */
+                size_t amount = (size_t)(format - spec_begun_at);
+                emit(ctx, spec_begun_at, amount);
+                written += amount;
+                continue;
+            }
+        }
+
+        char buffer[NUMBER_BUFFER_SIZE];
+        char* end = buffer + sizeof(buffer);
+        char* start;
+
+        if (conversion == 'x' || conversion == 'X') {
+            start = format_hex(end, value, digits);
+        } else if (conversion == 'o') {
+            start = format_octal(end, value);
+        } else {
+            start = format_decimal(end, value);
+        }
+
+        size_t body_len = (size_t)(end - start);
+        size_t zeros = 0;
+
+        if (precision >= 0) {
+            /* An explicit precision disables zero padding */
+            flags &= ~FLAG_ZERO;
+            if (precision == 0 && value == 0) {
+                body_len = 0;
+            } else if ((size_t)precision > body_len) {
+                zeros = (size_t)precision - body_len;
+            }
+        }
+
+        char prefix[2];
+        size_t prefix_len = 0;
+
+        if (sign) {
+            prefix[prefix_len++] = sign;
+        } else if ((flags & FLAG_ALT) && value != 0 && (conversion == 'x' || conversion == 'X')) {
+            prefix[prefix_len++] = '0';
+            prefix[prefix_len++] = conversion;
+        } else if ((flags & FLAG_ALT) && conversion == 'o' && zeros == 0 &&
+                   (body_len == 0 || *start != '0')) {
+            zeros = 1;
+        }
+
+        written += emit_field(emit, ctx, flags, width, prefix, prefix_len, zeros,
+                              start + ((size_t)(end - start) - body_len), body_len);
+    }
+
+    return written > INT_MAX ? -1 : (int)written;
+}
@@ -0,0 +1,24 @@
+#ifndef _LIBC_STDIO_FORMAT_H
+#define _LIBC_STDIO_FORMAT_H
+
+#include <stdarg.h>
+#include <stddef.h>
+
+/*
+ * Output callback used by the formatting engine. It receives the formatted
+ * text in spans (literal runs, padding, converted numbers) rather than one
+ * byte at a time, so sinks can copy or write whole runs at once.
+ */
+typedef void (*format_emit_t)(void* ctx, const char* data, size_t length);
+
+/*
+ * Shared formatting engine behind printf, vsnprintf and the debug logger.
+ *
+ * Supports the flags "-+ #0", field width and precision (including '*'),
+ * the length modifiers hh, h, l, ll, j, z and t, and the conversions
+ * d i u o x X c s p %. Returns the number of characters produced, or -1 if
+ * that count would not fit in an int.
+ */
+int vformat(format_emit_t emit, void* ctx, const char* format, va_list args);
+
+#endif /* _LIBC_STDIO_FORMAT_H */
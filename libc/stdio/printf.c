@@ -3,6 +3,11 @@
 #include <stdarg.h>
 #include <stdio.h>
 #include <string.h>
+#include "format.h"
+
+#if defined(__is_libc)
+#include "../../kernel/include/kernel/tty.h"
+#endif
 
 extern void serial_com1_write_byte(unsigned char byte);
 static bool serial_output_enabled = false;
@@ -13,239 +18,65 @@ void printf_enable_serial(bool enable) {
 
 extern bool terminal_is_serial_enabled(void);
 
-static bool print(const char *data, size_t length) {
-    const unsigned char *bytes = (const unsigned char *) data;
-    for (size_t i = 0; i < length; i++) {
-        if (putchar(bytes[i]) == EOF)
-            return false;
-        if (serial_output_enabled && !terminal_is_serial_enabled()) {
+/* Size of the staging buffer formatted output is collected in */
+#define PRINTF_BUFFER_SIZE 128
+
+struct printf_buffer {
+    char data[PRINTF_BUFFER_SIZE];
+    size_t used;
+};
+
+static void print(const char *data, size_t length) {
+#if defined(__is_libc)
+    terminal_write(data, length);
+#endif
+    if (serial_output_enabled && !terminal_is_serial_enabled()) {
+        const unsigned char *bytes = (const unsigned char *) data;
+        for (size_t i = 0; i < length; i++) {
             if (bytes[i] == '\n') {
                 serial_com1_write_byte('\r');
             }
             serial_com1_write_byte(bytes[i]);
         }
     }
-    return true;
 }
 
-/* Helper function to convert integer to string */
-static int itoa(char *str, int num, int base) {
-    int i = 0;
-    bool is_negative = false;
-
-    /* Handle 0 explicitly */
-    if (num == 0) {
-        str[i++] = '0';
-        str[i] = '\0';
-        return i;
-    }
-
-    /* Handle negative numbers only for base 10 */
-    if (num < 0 && base == 10) {
-        is_negative = true;
-        num = -num;
-    }
-
-    /* Process individual digits */
-    while (num != 0) {
-        int rem = num % base;
-        str[i++] = (rem < 10) ? (rem + '0') : (rem - 10 + 'A');
-        num = num / base;
+static void printf_flush(struct printf_buffer *buffer) {
+    if (buffer->used) {
+        print(buffer->data, buffer->used);
+        buffer->used = 0;
     }
-
-    /* If negative, append '-' */
-    if (is_negative)
-        str[i++] = '-';
-
-    /* Reverse the string */
-    int start = 0;
-    int end = i - 1;
-    while (start < end) {
-        char temp = str[start];
-        str[start] = str[end];
-        str[end] = temp;
-        start++;
-        end--;
-    }
-
-    str[i] = '\0';
-    return i;
 }
 
-/* Helper function to convert unsigned integer to string */
-static int utoa(char *str, unsigned int num, int base) {
-    int i = 0;
+/* Collect spans from the formatter and hand them to the terminal in bulk */
+static void printf_emit(void *ctx, const char *data, size_t length) {
+    struct printf_buffer *buffer = ctx;
 
-    /* Handle 0 explicitly */
-    if (num == 0) {
-        str[i++] = '0';
-        str[i] = '\0';
-        return i;
+    if (length > PRINTF_BUFFER_SIZE - buffer->used) {
+        printf_flush(buffer);
+        if (length >= PRINTF_BUFFER_SIZE) {
+            print(data, length);
+            return;
+        }
     }
 
-    /* Process individual digits */
-    while (num != 0) {
-        int rem = num % base;
-        str[i++] = (rem < 10) ? (rem + '0') : (rem - 10 + 'A');
-        num = num / base;
-    }
+    memcpy(buffer->data + buffer->used, data, length);
+    buffer->used += length;
+}
 
-    /* Reverse the string */
-    int start = 0;
-    int end = i - 1;
-    while (start < end) {
-        char temp = str[start];
-        str[start] = str[end];
-        str[end] = temp;
-        start++;
-        end--;
-    }
+int vprintf(const char *restrict format, va_list parameters) {
+    struct printf_buffer buffer;
+    buffer.used = 0;
 
-    str[i] = '\0';
-    return i;
+    int written = vformat(printf_emit, &buffer, format, parameters);
+    printf_flush(&buffer);
+    return written;
 }
 
 int printf(const char *restrict format, ...) {
     va_list parameters;
     va_start(parameters, format);
-    int written = 0;
-
-    while (*format != '\0') {
-        size_t maxrem = INT_MAX - written;
-
-        if (format[0] != '%' || format[1] == '%') {
-            if (format[0] == '%')
-                format++;
-            size_t amount = 1;
-            while (format[amount] && format[amount] != '%')
-                amount++;
-            if (maxrem < amount) {
-                return -1;
-            }
-            if (!print(format, amount))
-                return -1;
-            format += amount;
-            written += amount;
-            continue;
-        }
-
-        const char *format_begun_at = format++;
-
-        if (*format == 'c') {
-            format++;
-            char c = (char) va_arg(parameters, int);
-            if (!maxrem) {
-                return -1;
-            }
-            if (!print(&c, sizeof(c)))
-                return -1;
-            written++;
-        } else if (*format == 's') {
-            format++;
-            const char *str = va_arg(parameters, const char*);
-            if (str == NULL) {
-                str = "(null)";
-            }
-            size_t len = strlen(str);
-            if (maxrem < len) {
-                return -1;
-            }
-            if (!print(str, len))
-                return -1;
-            written += len;
-        } else if (*format == 'd' || *format == 'i') {
-            format++;
-            int num = va_arg(parameters, int);
-
-            char num_str[32];
-            int len = itoa(num_str, num, 10);
-
-            if (maxrem < (size_t)len) {
-                return -1;
-            }
-            if (!print(num_str, len))
-                return -1;
-            written += len;
-        } else if (*format == 'u') {
-            format++;
-            unsigned int num = va_arg(parameters, unsigned int);
-
-            char num_str[32];
-            int len = utoa(num_str, num, 10);
-
-            if (maxrem < (size_t)len) {
-                return -1;
-            }
-            if (!print(num_str, len))
-                return -1;
-            written += len;
-        } else if (*format == 'x' || *format == 'X') {
-            format++;
-            unsigned int num = va_arg(parameters, unsigned int);
-
-            char prefix[2] = {'0', 'x'};
-            if (maxrem < 2) {
-                return -1;
-            }
-            if (!print(prefix, 2))
-                return -1;
-            written += 2;
-
-            char num_str[32];
-            int len = utoa(num_str, num, 16);
-
-            if (maxrem < (size_t)len + 2) {
-                return -1;
-            }
-            if (!print(num_str, len))
-                return -1;
-            written += len;
-        } else if (*format == 'p') {
-            format++;
-            void *ptr = va_arg(parameters, void*);
-
-            if (ptr == NULL) {
-                const char *nil = "(nil)";
-                size_t len = strlen(nil);
-                if (maxrem < len) {
-                    return -1;
-                }
-                if (!print(nil, len))
-                    return -1;
-                written += len;
-            } else {
-                char prefix[2] = {'0', 'x'};
-                if (maxrem < 2) {
-                    return -1;
-                }
-                if (!print(prefix, 2))
-                    return -1;
-                written += 2;
-
-                unsigned int ptr_val = (unsigned int)ptr;
-                char num_str[32];
-                int len = utoa(num_str, ptr_val, 16);
-
-                if (maxrem < (size_t)len + 2) {
-                    return -1;
-                }
-                if (!print(num_str, len))
-                    return -1;
-                written += len;
-            }
-        } else {
-            format = format_begun_at;
-            size_t len = strlen(format);
-            if (maxrem < len) {
-                return -1;
-            }
-            if (!print(format, len))
-                return -1;
-            written += len;
-            format += len;
-        }
-    }
-
+    int written = vprintf(format, parameters);
     va_end(parameters);
     return written;
 }
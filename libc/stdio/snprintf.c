@@ -0,0 +1,10 @@
+#include <stdarg.h>
+#include <stdio.h>
+
+int snprintf(char* str, size_t size, const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    int result = vsnprintf(str, size, format, args);
+    va_end(args);
+    return result;
+}
@@ -0,0 +1,39 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include "format.h"
+
+struct snprintf_buffer {
+    char* data;
+    size_t capacity; /* Bytes available for characters, excluding the terminator */
+    size_t used;
+};
+
+static void snprintf_emit(void* ctx, const char* data, size_t length) {
+    struct snprintf_buffer* buffer = ctx;
+    size_t room = buffer->capacity - buffer->used;
+
+    if (length > room) {
+        length = room;
+    }
+    memcpy(buffer->data + buffer->used, data, length);
+    buffer->used += length;
+}
+
+/*
+ * Format into str, writing at most size bytes including the terminator.
+ * Returns the length the full output would have had, as in C99.
+ */
+int vsnprintf(char* str, size_t size, const char* format, va_list args) {
+    struct snprintf_buffer buffer;
+    buffer.data = str;
+    buffer.capacity = size ? size - 1 : 0;
+    buffer.used = 0;
+
+    int result = vformat(snprintf_emit, &buffer, format, args);
+
+    if (size) {
+        str[buffer.used] = '\0';
+    }
+    return result;
+}
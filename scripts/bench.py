@@ -0,0 +1,165 @@
+#!/usr/bin/env python3
+"""Run the RedOS bench kernel and compare its results against a baseline.
+
+Boot the bench ISO headless, collect the results and compare them:
+
+    bench.py --iso redos-bench.iso --log bench.log --results bench.json \\
+             --baseline benchmarks/baseline.json
+
+Without --iso an existing serial log is parsed. --update-baseline stores
+the new results as the baseline instead of comparing against it.
+"""
+
+import argparse
+import json
+import os
+import re
+import shutil
+import subprocess
+import sys
+
+RESULT_RE = re.compile(r"bench-result: (\{.*\})")
+META_RE = re.compile(r"bench-meta: (\{.*\})")
+DONE_RE = re.compile(r"bench-done: (\w+)")
+
+# QEMU exits with (value << 1) | 1 when the guest writes value to isa-debug-exit
+QEMU_EXIT_SUCCESS = (0 << 1) | 1
+
+
+def run_qemu(iso, log, timeout, qemu_args):
+    if os.path.exists(log):
+        os.remove(log)
+    command = ["qemu-system-i386", "-cdrom", iso, "-display", "none",
+               "-serial", "file:" + log, "-no-reboot",
+               "-device", "isa-debug-exit,iobase=0xf4,iosize=0x04"] + qemu_args
+    try:
+        status = subprocess.run(command, timeout=timeout).returncode
+    except subprocess.TimeoutExpired:
+        print("error: bench kernel did not exit within %d seconds" % timeout, file=sys.stderr)
+        return False
+    if status != QEMU_EXIT_SUCCESS:
+        print("error: bench kernel exited with status %d" % status, file=sys.stderr)
+        return False
+    return True
+
+
+def parse_log(text):
+    meta = {}
+    results = {}
+    done = None
+    for line in text.splitlines():
+        match = META_RE.search(line)
+        if match:
+            meta = json.loads(match.group(1))
+            results = {}  # A new run starts over
+            continue
+        match = RESULT_RE.search(line)
+        if match:
+            result = json.loads(match.group(1))
+            results[result.pop("name")] = result
+            continue
+        match = DONE_RE.search(line)
+        if match:
+            done = match.group(1)
+    return meta, results, done
+
+
+def cycles_to_ns(cycles, tsc_hz):
+    return cycles * 1e9 / tsc_hz if tsc_hz else None
+
+
+def print_results(results, meta):
+    tsc_hz = meta.get("tsc_hz", 0)
+    print("%-24s %10s %10s %10s %12s" % ("benchmark", "min", "median", "p99", "median ns"))
+    for name in sorted(results):
+        r = results[name]
+        ns = cycles_to_ns(r["median"], tsc_hz)
+        print("%-24s %10d %10d %10d %12s" % (name, r["min"], r["median"], r["p99"],
+                                             "-" if ns is None else "%.0f" % ns))
+    print("(cycles; timing overhead of %s cycles subtracted)" % meta.get("overhead", "?"))
+
+
+def compare(results, baseline, threshold):
+    """Print the change of each median; return the names that regressed."""
+    regressions = []
+    print()
+    print("%-24s %12s %12s %9s" % ("benchmark", "baseline", "current", "change"))
+    for name in sorted(set(results) | set(baseline)):
+        if name not in baseline:
+            print("%-24s %12s %12d %9s" % (name, "-", results[name]["median"], "new"))
+            continue
+        if name not in results:
+            print("%-24s %12d %12s %9s" % (name, baseline[name]["median"], "-", "missing"))
+            continue
+        old = baseline[name]["median"]
+        new = results[name]["median"]
+        change = 100.0 * (new - old) / old if old else 0.0
+        flag = ""
+        if change > threshold:
+            flag = "  REGRESSION"
+            regressions.append(name)
+        elif change < -threshold:
+            flag = "  faster"
+        print("%-24s %12d %12d %+8.1f%%%s" % (name, old, new, change, flag))
+    return regressions
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--iso", help="boot this bench ISO in QEMU first")
+    parser.add_argument("--log", default="bench.log", help="serial log of the bench kernel")
+    parser.add_argument("--results", default="bench.json", help="where to write the results")
+    parser.add_argument("--baseline", help="baseline results to compare against")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="median slowdown in percent that counts as a regression")
+    parser.add_argument("--update-baseline", action="store_true",
+                        help="store the results as the new baseline")
+    parser.add_argument("--timeout", type=int, default=300,
+                        help="seconds to wait for the bench kernel (default 300)")
+    parser.add_argument("--qemu-arg", action="append", default=[],
+                        help="extra QEMU argument, may be repeated")
+    args = parser.parse_args()
+
+    if args.iso and not run_qemu(args.iso, args.log, args.timeout, args.qemu_arg):
+        return 1
+
+    try:
+        with open(args.log, errors="replace") as f:
+            meta, results, done = parse_log(f.read())
+    except OSError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+    if done != "ok" or not results:
+        print("error: no complete benchmark run in %s" % args.log, file=sys.stderr)
+        return 1
+
+    with open(args.results, "w") as f:
+        json.dump({"meta": meta, "benchmarks": results}, f, indent=2, sort_keys=True)
+        f.write("\n")
+    print_results(results, meta)
+    print("Results written to %s" % args.results)
+
+    if not args.baseline:
+        return 0
+    if args.update_baseline:
+        os.makedirs(os.path.dirname(os.path.abspath(args.baseline)), exist_ok=True)
+        shutil.copyfile(args.results, args.baseline)
+        print("Baseline updated: %s" % args.baseline)
+        return 0
+    if not os.path.exists(args.baseline):
+        print("No baseline at %s yet, store one with --update-baseline" % args.baseline)
+        return 0
+
+    with open(args.baseline) as f:
+        baseline = json.load(f)["benchmarks"]
+    regressions = compare(results, baseline, args.threshold)
+    if regressions:
+        print("%d benchmark(s) regressed by more than %.0f%%: %s" %
+              (len(regressions), args.threshold, ", ".join(regressions)))
+        return 1
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
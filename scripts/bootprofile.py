@@ -0,0 +1,117 @@
+#!/usr/bin/env python3
+"""Summarize the boot phase profile RedOS prints on the serial port.
+
+Either parse an existing serial log:
+
+    bootprofile.py serial.log
+
+or boot an ISO headless, wait for the profile and summarize it:
+
+    bootprofile.py --iso redos.iso --log bootprofile.log [--timeout 30]
+"""
+
+import argparse
+import os
+import re
+import subprocess
+import sys
+import time
+
+PHASE_RE = re.compile(r"bootprof: (?P<name>.+?)\s+(?P<cycles>\d+) cycles\s+(?P<us>\d+|-) us")
+TOTAL_PHASE = "total"
+BEFORE_KERNEL_PHASE = "firmware and bootloader"
+
+
+def parse_profile(text):
+    """Return [(name, cycles, us or None)] for the last profile in text."""
+    phases = []
+    for line in text.splitlines():
+        match = PHASE_RE.search(line)
+        if not match:
+            continue
+        name = match.group("name")
+        if name == BEFORE_KERNEL_PHASE:
+            phases = []  # A new boot starts a new profile
+        us = match.group("us")
+        phases.append((name, int(match.group("cycles")), None if us == "-" else int(us)))
+    return phases
+
+
+def run_qemu(iso, log, timeout, qemu_args):
+    """Boot the ISO until the profile is complete or the timeout expires."""
+    if os.path.exists(log):
+        os.remove(log)
+    command = ["qemu-system-i386", "-cdrom", iso, "-display", "none",
+               "-serial", "file:" + log, "-no-reboot"] + qemu_args
+    qemu = subprocess.Popen(command)
+    deadline = time.monotonic() + timeout
+    try:
+        while time.monotonic() < deadline and qemu.poll() is None:
+            time.sleep(0.5)
+            if os.path.exists(log):
+                with open(log, errors="replace") as f:
+                    phases = parse_profile(f.read())
+                if phases and phases[-1][0] == TOTAL_PHASE:
+                    return
+        print("warning: no complete boot profile after %d seconds" % timeout, file=sys.stderr)
+    finally:
+        if qemu.poll() is None:
+            qemu.terminate()
+            qemu.wait()
+
+
+def print_summary(phases):
+    total = next((p for p in phases if p[0] == TOTAL_PHASE), None)
+    kernel = [p for p in phases if p[0] not in (TOTAL_PHASE, BEFORE_KERNEL_PHASE)]
+    before = next((p for p in phases if p[0] == BEFORE_KERNEL_PHASE), None)
+    total_cycles = total[1] if total else sum(p[1] for p in kernel)
+
+    def us(value):
+        return "-" if value is None else "%d" % value
+
+    print("%-26s %14s %12s %7s" % ("phase", "cycles", "us", "share"))
+    for name, cycles, micros in kernel:
+        share = 100.0 * cycles / total_cycles if total_cycles else 0.0
+        print("%-26s %14d %12s %6.1f%%" % (name, cycles, us(micros), share))
+    if total:
+        print("%-26s %14d %12s" % ("kernel total", total[1], us(total[2])))
+    if before:
+        print("%-26s %14d %12s" % ("before multiboot_entry", before[1], us(before[2])))
+
+    print()
+    print("Slowest phases:")
+    for name, cycles, micros in sorted(kernel, key=lambda p: p[1], reverse=True)[:5]:
+        print("  %-24s %12s us" % (name, us(micros)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", nargs="?", help="serial log holding a boot profile")
+    parser.add_argument("--iso", help="boot this ISO in QEMU first")
+    parser.add_argument("--timeout", type=int, default=30,
+                        help="seconds to wait for the profile (default 30)")
+    parser.add_argument("--qemu-arg", action="append", default=[],
+                        help="extra QEMU argument, may be repeated")
+    args = parser.parse_args()
+
+    log = args.log or "bootprofile.log"
+    if args.iso:
+        run_qemu(args.iso, log, args.timeout, args.qemu_arg)
+
+    try:
+        with open(log, errors="replace") as f:
+            phases = parse_profile(f.read())
+    except OSError as e:
+        print("error: %s" % e, file=sys.stderr)
+        return 1
+    if not phases:
+        print("error: no boot profile in %s" % log, file=sys.stderr)
+        return 1
+
+    print_summary(phases)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
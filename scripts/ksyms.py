@@ -0,0 +1,100 @@
+#!/usr/bin/env python3
+"""Generate the kernel symbol table linked into the second pass of redos.kernel.
+
+    ksyms.py [--nm NM] redos-nosyms.kernel ksyms_table.S
+    ksyms.py [--nm NM] --verify redos.kernel ksyms_table.S
+
+The first form reads the function symbols of the first-pass image and writes
+an assembly file holding them sorted by address: an address array, an array
+of offsets into a string pool, and the pool. The table goes at the end of
+.rodata, after .text, so linking it in leaves every function where it was.
+The second form checks that against the final image.
+"""
+
+import argparse
+import subprocess
+import sys
+
+# nm types of symbols that name code
+CODE_TYPES = "tTwW"
+
+
+def read_symbols(kernel, nm):
+    """Return ([(address, name)] sorted by address, end of the last function)."""
+    output = subprocess.run([nm, "-n", "-S", "--defined-only", kernel], check=True,
+                            capture_output=True, text=True).stdout
+    by_address = {}
+    end = 0
+    for line in output.splitlines():
+        fields = line.split()
+        if len(fields) == 4:
+            address, size, kind, name = fields
+            size = int(size, 16)
+        elif len(fields) == 3:
+            address, kind, name = fields
+            size = 0
+        else:
+            continue
+        if kind not in CODE_TYPES or name.startswith(".L"):
+            continue
+        address = int(address, 16)
+        end = max(end, address + size)
+        # Where names share an address prefer a sized function over a
+        # linker-script label, then a global name over a local one
+        rank = (size > 0, kind.isupper())
+        if address not in by_address or rank > by_address[address][0]:
+            by_address[address] = (rank, name)
+    symbols = sorted((address, entry[1]) for address, entry in by_address.items())
+    return symbols, end
+
+
+def render(symbols, end):
+    lines = [
+        "/* Generated by scripts/ksyms.py, do not edit */",
+        "",
+        "    .section .rodata",
+        "    .balign 4",
+        "    .globl ksym_table",
+        "ksym_table:",
+        "    .long %d, 0x%08x, ksym_addresses, ksym_name_offsets, ksym_names" % (len(symbols), end),
+        "ksym_addresses:",
+    ]
+    lines += ["    .long 0x%08x" % address for address, _ in symbols]
+    lines.append("ksym_name_offsets:")
+    offset = 0
+    for _, name in symbols:
+        lines.append("    .long %d" % offset)
+        offset += len(name) + 1
+    lines.append("ksym_names:")
+    lines += ['    .asciz "%s"' % name for _, name in symbols]
+    return "\n".join(lines) + "\n"
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("kernel", help="kernel image to read the symbols of")
+    parser.add_argument("output", help="assembly file holding the table")
+    parser.add_argument("--nm", default="nm", help="nm program to read symbols with")
+    parser.add_argument("--verify", action="store_true",
+                        help="check the table still matches the kernel instead of writing it")
+    args = parser.parse_args()
+
+    symbols, end = read_symbols(args.kernel, args.nm)
+    table = render(symbols, end)
+
+    if args.verify:
+        with open(args.output) as f:
+            if f.read() != table:
+                print("error: %s does not match the symbols of %s; functions moved "
+                      "between the link passes" % (args.output, args.kernel), file=sys.stderr)
+                return 1
+        return 0
+
+    with open(args.output, "w") as f:
+        f.write(table)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,133 @@
+#!/usr/bin/env python3
+"""Symbolize the samples the RedOS sampling profiler writes to the serial port.
+
+    profile.py --kernel build/bin/redos.kernel serial.log [--folded out.folded]
+
+Prints a flat profile of the functions the samples landed in and, with
+--folded, writes one "outer;...;inner count" line per distinct stack, the
+input format of flamegraph.pl and speedscope. Stacks only go deeper than
+the sampled function when the kernel was built with KERNEL_FRAME_POINTERS.
+"""
+
+import argparse
+import bisect
+import collections
+import re
+import subprocess
+import sys
+
+BEGIN_RE = re.compile(r"profile-begin hz=(\d+) samples=(\d+) dropped=(\d+) backtrace=(\d)")
+SAMPLE_RE = re.compile(r"profile-sample((?: [0-9a-f]{8})+)")
+END_RE = re.compile(r"profile-end handler_cycles=(\d+)")
+OVERHEAD_RE = re.compile(r"profiler: overhead at .*")
+SLOWDOWN_RE = re.compile(r"busy loop \d+ cycles unprofiled, \d+ profiled, [\d.]+% slower")
+
+
+class Symbols:
+    """Address to function name lookup built from nm."""
+
+    def __init__(self, kernel, nm):
+        output = subprocess.run([nm, "-n", "--defined-only", kernel], check=True,
+                                capture_output=True, text=True).stdout
+        self.addresses = []
+        self.names = []
+        for line in output.splitlines():
+            fields = line.split()
+            if len(fields) != 3 or fields[1] not in "tTwW":
+                continue
+            self.addresses.append(int(fields[0], 16))
+            self.names.append(fields[2])
+
+    def lookup(self, address):
+        index = bisect.bisect_right(self.addresses, address) - 1
+        if index < 0:
+            return "0x%08x" % address
+        return self.names[index]
+
+
+def parse_log(text):
+    """Return (header, samples, footer lines) for the last profile in text."""
+    header = None
+    samples = []
+    notes = []
+    for line in text.splitlines():
+        match = BEGIN_RE.search(line)
+        if match:
+            header = tuple(int(group) for group in match.groups())
+            samples = []
+            continue
+        match = SAMPLE_RE.search(line)
+        if match and header:
+            samples.append([int(word, 16) for word in match.group(1).split()])
+            continue
+        match = END_RE.search(line)
+        if match and header:
+            notes.append("handler: %s cycles per sample" % match.group(1))
+            continue
+        for regex in (OVERHEAD_RE, SLOWDOWN_RE):
+            match = regex.search(line)
+            if match:
+                notes.append(match.group(0))
+    return header, samples, notes
+
+
+def fold(samples, symbols):
+    """Count identical stacks, outermost frame first."""
+    stacks = collections.Counter()
+    for sample in samples:
+        # The first address was interrupted; the rest are return addresses,
+        # which point after the call, so look up the byte before them
+        frames = [symbols.lookup(sample[0])]
+        frames += [symbols.lookup(address - 1) for address in sample[1:]]
+        stacks[";".join(reversed(frames))] += 1
+    return stacks
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", help="serial log holding profile-* lines")
+    parser.add_argument("--kernel", required=True, help="the redos.kernel ELF the samples came from")
+    parser.add_argument("--folded", help="write folded stacks to this file")
+    parser.add_argument("--nm", default="nm", help="nm program to read symbols with")
+    parser.add_argument("--top", type=int, default=20, help="functions in the flat profile")
+    args = parser.parse_args()
+
+    with open(args.log, errors="replace") as f:
+        header, samples, notes = parse_log(f.read())
+    if header is None:
+        print("no profile in %s" % args.log, file=sys.stderr)
+        return 1
+
+    hz, count, dropped, backtrace = header
+    if len(samples) != count:
+        print("warning: log holds %d of %d samples" % (len(samples), count), file=sys.stderr)
+
+    symbols = Symbols(args.kernel, args.nm)
+    stacks = fold(samples, symbols)
+
+    if args.folded:
+        with open(args.folded, "w") as f:
+            for stack, hits in sorted(stacks.items()):
+                f.write("%s %d\n" % (stack, hits))
+
+    flat = collections.Counter()
+    for stack, hits in stacks.items():
+        flat[stack.rsplit(";", 1)[-1]] += hits
+
+    print("%d samples at %d Hz (%.2f s), %d dropped, backtraces %s"
+          % (len(samples), hz, len(samples) / float(hz), dropped, "on" if backtrace else "off"))
+    for note in notes:
+        print("  " + note)
+    print()
+    print("%8s %7s  %s" % ("samples", "share", "function"))
+    total = max(len(samples), 1)
+    for name, hits in flat.most_common(args.top):
+        print("%8d %6.2f%%  %s" % (hits, 100.0 * hits / total, name))
+    if args.folded:
+        print("\nfolded stacks written to %s" % args.folded)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+"""Read and print the RedOS telemetry page from a running QEMU guest.
+
+The kernel keeps a snapshot of its counters, allocator state and boot phase
+times in one page at a fixed physical address (docs/TELEMETRY.md). Reading
+it goes through QEMU, so the guest does no I/O at all:
+
+    telemetry.py --qmp build/qmp.sock          # QMP pmemsave
+    telemetry.py --gdb localhost:1234          # gdbstub memory read
+    telemetry.py --file page.bin               # page saved earlier
+
+Add --watch SECONDS to keep printing, or --json for machine-readable output.
+"""
+
+import argparse
+import json
+import os
+import socket
+import struct
+import sys
+import tempfile
+import time
+
+TELEMETRY_PHYS_ADDR = 0x7000
+TELEMETRY_SIZE = 4096
+TELEMETRY_MAGIC = 0x4C455452
+KERNEL_VIRTUAL_BASE = 0xC0000000
+
+HEADER = struct.Struct("<IHHHHIQQQQII")
+ENTRY_NAME_SIZE = 28
+ENTRY = struct.Struct("<%dsIQ" % ENTRY_NAME_SIZE)
+UNITS = {0: "count", 1: "cycles", 2: "frames", 3: "ns", 4: "%"}
+
+# Attempts at a copy the kernel was not writing to
+READ_ATTEMPTS = 10
+
+
+class QmpReader:
+    """Save guest physical memory through a QMP socket."""
+
+    def __init__(self, path):
+        self.sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.sock.connect(path)
+        self.stream = self.sock.makefile("rw")
+        self.stream.readline()  # Greeting
+        self.command("qmp_capabilities")
+
+    def command(self, name, **arguments):
+        message = {"execute": name}
+        if arguments:
+            message["arguments"] = arguments
+        self.stream.write(json.dumps(message) + "\n")
+        self.stream.flush()
+        while True:
+            reply = json.loads(self.stream.readline())
+            if "error" in reply:
+                raise RuntimeError("QMP %s: %s" % (name, reply["error"].get("desc")))
+            if "return" in reply:
+                return reply["return"]
+
+    def read(self, address, size):
+        fd, path = tempfile.mkstemp(prefix="redos-telemetry-")
+        os.close(fd)
+        try:
+            self.command("pmemsave", val=address, size=size, filename=path)
+            with open(path, "rb") as f:
+                return f.read()
+        finally:
+            os.remove(path)
+
+
+class GdbReader:
+    """Read guest memory through the QEMU gdbstub."""
+
+    def __init__(self, target):
+        host, _, port = target.rpartition(":")
+        self.sock = socket.create_connection((host or "localhost", int(port)))
+        self.buffer = b""
+        # QEMU can switch memory reads to physical addresses; without it the
+        # page is read through the kernel's higher-half mapping instead
+        self.physical = self.request("Qqemu.PhyMemMode:1") == "OK"
+
+    def send(self, payload):
+        checksum = sum(payload.encode()) & 0xFF
+        self.sock.sendall(b"$%s#%02x" % (payload.encode(), checksum))
+
+    def receive(self):
+        while True:
+            start = self.buffer.find(b"$")
+            end = self.buffer.find(b"#", start)
+            if start >= 0 and end >= 0 and len(self.buffer) >= end + 3:
+                packet = self.buffer[start + 1:end].decode()
+                self.buffer = self.buffer[end + 3:]
+                self.sock.sendall(b"+")
+                return packet
+            data = self.sock.recv(65536)
+            if not data:
+                raise RuntimeError("gdbstub closed the connection")
+            self.buffer += data
+
+    def request(self, payload):
+        self.send(payload)
+        return self.receive()
+
+    def read(self, address, size):
+        if not self.physical:
+            address += KERNEL_VIRTUAL_BASE
+        data = b""
+        while len(data) < size:
+            chunk = min(size - len(data), 1024)
+            reply = self.request("m%x,%x" % (address + len(data), chunk))
+            if reply.startswith("E") or not reply:
+                raise RuntimeError("gdbstub cannot read 0x%x: %s" % (address, reply))
+            data += bytes.fromhex(reply)
+        return data
+
+
+class FileReader:
+    """Read a page saved earlier, e.g. with pmemsave from the QEMU monitor."""
+
+    def __init__(self, path):
+        self.path = path
+
+    def read(self, address, size):
+        with open(self.path, "rb") as f:
+            data = f.read()
+        offset = address - TELEMETRY_PHYS_ADDR
+        return data[offset:offset + size]
+
+
+def read_page(reader):
+    """Return a copy of the page the kernel was not rewriting meanwhile."""
+    for _ in range(READ_ATTEMPTS):
+        page = reader.read(TELEMETRY_PHYS_ADDR, TELEMETRY_SIZE)
+        sequence = HEADER.unpack_from(page)[5]
+        if sequence % 2:
+            continue
+        again = struct.unpack("<I", reader.read(TELEMETRY_PHYS_ADDR + 12, 4))[0]
+        if again == sequence or isinstance(reader, FileReader):
+            return page
+    raise RuntimeError("no consistent copy of the telemetry page after %d reads" % READ_ATTEMPTS)
+
+
+def parse_page(page):
+    (magic, version, header_size, entry_size, entry_count, sequence, tsc_hz,
+     updated_tsc, uptime_ns, log_sequence, updates, _) = HEADER.unpack_from(page)
+    if magic != TELEMETRY_MAGIC:
+        raise RuntimeError("no telemetry page at 0x%x (magic 0x%08x)" % (TELEMETRY_PHYS_ADDR, magic))
+
+    entries = []
+    for i in range(entry_count):
+        offset = header_size + i * entry_size
+        raw_name, unit, value = ENTRY.unpack_from(page, offset)
+        entries.append({
+            "name": raw_name.rstrip(b"\0").decode(errors="replace"),
+            "unit": UNITS.get(unit, "unit%d" % unit),
+            "value": value,
+        })
+
+    return {
+        "version": version,
+        "sequence": sequence,
+        "tsc_hz": tsc_hz,
+        "updated_tsc": updated_tsc,
+        "uptime_ns": uptime_ns,
+        "log_sequence": log_sequence,
+        "updates": updates,
+        "entries": entries,
+    }
+
+
+def format_value(entry, tsc_hz):
+    value = entry["value"]
+    if entry["unit"] == "cycles" and tsc_hz:
+        return "%14d cycles %12.1f us" % (value, value * 1e6 / tsc_hz)
+    if entry["unit"] == "frames":
+        return "%14d frames %12.1f MB" % (value, value * 4096 / 1048576.0)
+    return "%14d %s" % (value, "" if entry["unit"] == "count" else entry["unit"])
+
+
+def print_snapshot(snapshot):
+    print("telemetry v%d: uptime %.3f s, %d updates, log sequence %d, TSC %s"
+          % (snapshot["version"], snapshot["uptime_ns"] / 1e9, snapshot["updates"],
+             snapshot["log_sequence"],
+             "%.1f MHz" % (snapshot["tsc_hz"] / 1e6) if snapshot["tsc_hz"] else "uncalibrated"))
+    group = None
+    for entry in snapshot["entries"]:
+        entry_group = entry["name"].split(".", 1)[0]
+        if entry_group != group:
+            print()
+            group = entry_group
+        print("  %-28s %s" % (entry["name"], format_value(entry, snapshot["tsc_hz"])))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__,
+                                     formatter_class=argparse.RawDescriptionHelpFormatter)
+    source = parser.add_mutually_exclusive_group(required=True)
+    source.add_argument("--qmp", help="QMP unix socket of the running guest")
+    source.add_argument("--gdb", help="host:port of the guest's gdbstub")
+    source.add_argument("--file", help="page saved with pmemsave")
+    parser.add_argument("--json", action="store_true", help="print JSON instead of a table")
+    parser.add_argument("--watch", type=float, metavar="SECONDS",
+                        help="keep reading at this interval")
+    args = parser.parse_args()
+
+    if args.qmp:
+        reader = QmpReader(args.qmp)
+    elif args.gdb:
+        reader = GdbReader(args.gdb)
+    else:
+        reader = FileReader(args.file)
+
+    while True:
+        try:
+            snapshot = parse_page(read_page(reader))
+        except RuntimeError as error:
+            print("error: %s" % error, file=sys.stderr)
+            return 1
+        if args.json:
+            print(json.dumps(snapshot))
+        else:
+            print_snapshot(snapshot)
+        if not args.watch:
+            return 0
+        sys.stdout.flush()
+        time.sleep(args.watch)
+        print()
+
+
+if __name__ == "__main__":
+    sys.exit(main())